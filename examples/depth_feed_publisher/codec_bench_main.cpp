@@ -0,0 +1,128 @@
+#include "depth_feed_codec.h"
+#include "book/depth.h"
+
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+
+using namespace liquibook;
+using namespace liquibook::examples;
+
+typedef book::Depth<5> Depth;
+typedef std::chrono::steady_clock Clock;
+
+// Encode and decode throughput of the depth feed codec.
+//   codec_bench [iterations]
+
+namespace {
+
+void build_depth(Depth& depth)
+{
+  for (int level = 0; level < 5; ++level) {
+    depth.add_order(1250 - level, 100 * (level + 1), true);
+    depth.add_order(1251 + level, 200 * (level + 1), false);
+    depth.add_order(1251 + level, 50, false);
+  }
+}
+
+// Touch the fields a subscriber reads, so the decode is not optimized away
+uint64_t decode(const unsigned char* data)
+{
+  codec::DepthMessageView msg(data);
+  if (!msg.valid()) {
+    throw std::runtime_error("Decoded an invalid message");
+  }
+  uint64_t sum = msg.seq_num() + msg.symbol_length();
+  for (size_t i = 0; i < msg.bid_count(); ++i) {
+    codec::LevelView level = msg.bid(i);
+    sum += level.level_num() + level.price() + level.qty() +
+           level.order_count();
+  }
+  for (size_t i = 0; i < msg.ask_count(); ++i) {
+    codec::LevelView level = msg.ask(i);
+    sum += level.level_num() + level.price() + level.qty() +
+           level.order_count();
+  }
+  return sum;
+}
+
+void report(const char* name, size_t iterations, size_t bytes,
+            Clock::duration elapsed)
+{
+  double seconds = std::chrono::duration<double>(elapsed).count();
+  std::cout << name << ": " << iterations << " messages of " << bytes
+            << " bytes in " << seconds << " sec, "
+            << (iterations / seconds) << " msgs/sec, "
+            << (seconds * 1e9 / iterations) << " nsec/msg" << std::endl;
+}
+
+} // namespace
+
+int main(int argc, const char* argv[])
+{
+  size_t iterations = 10000000;
+  if (argc > 1) {
+    iterations = size_t(atol(argv[1]));
+  }
+  try
+  {
+    Depth depth;
+    build_depth(depth);
+    unsigned char buffer[codec::MaxMessageSize<5>::value];
+
+    // Round trip check
+    size_t length = codec::Encoder::encode_depth(
+        buffer, sizeof(buffer), 1, codec::Stamps(), "AAPL", depth, true);
+    codec::DepthMessageView msg(buffer);
+    if (length != sizeof(buffer) || !msg.valid() || msg.symbol() != "AAPL" ||
+        msg.bid_count() != 5 || msg.ask_count() != 5 ||
+        msg.bid(0).price() != 1250 || msg.ask(4).price() != 1255 ||
+        msg.ask(0).qty() != 250 || msg.ask(0).order_count() != 2) {
+      std::cerr << "Round trip check failed" << std::endl;
+      return -1;
+    }
+
+    // Full messages
+    Clock::time_point start = Clock::now();
+    for (size_t i = 0; i < iterations; ++i) {
+      length = codec::Encoder::encode_depth(
+          buffer, sizeof(buffer), uint32_t(i), codec::Stamps(), "AAPL", depth, true);
+    }
+    report("encode full", iterations, length, Clock::now() - start);
+
+    uint64_t sum = 0;
+    start = Clock::now();
+    for (size_t i = 0; i < iterations; ++i) {
+      codec::Encoder::set_seq_num(buffer, uint32_t(i));
+      sum += decode(buffer);
+    }
+    report("decode full", iterations, length, Clock::now() - start);
+
+    // Incremental messages carrying one changed level per side
+    depth.published();
+    depth.add_order(1250, 10, true);
+    depth.add_order(1251, 10, false);
+    start = Clock::now();
+    for (size_t i = 0; i < iterations; ++i) {
+      length = codec::Encoder::encode_depth(
+          buffer, sizeof(buffer), uint32_t(i), codec::Stamps(), "AAPL", depth, false);
+    }
+    report("encode incr", iterations, length, Clock::now() - start);
+
+    start = Clock::now();
+    for (size_t i = 0; i < iterations; ++i) {
+      codec::Encoder::set_seq_num(buffer, uint32_t(i));
+      sum += decode(buffer);
+    }
+    report("decode incr", iterations, length, Clock::now() - start);
+
+    // Keep the sum live
+    std::cout << "checksum " << sum << std::endl;
+  }
+  catch (const std::exception & ex)
+  {
+    std::cerr << "Exception caught at main level: " << ex.what() << std::endl;
+    return -1;
+  }
+  return 0;
+}
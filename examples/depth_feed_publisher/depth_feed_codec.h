@@ -0,0 +1,570 @@
+// Copyright (c) 2017 Object Computing, Inc.
+// All rights reserved.
+// See the file license.txt for licensing information.
+#pragma once
+
+#include "book/depth.h"
+#include "book/top_of_book.h"
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+
+// Fixed layout binary messages for the depth feed.
+//
+// Every field is little endian at a fixed offset, so the publisher
+// writes a message straight from a Depth into a send buffer, and the
+// subscriber reads fields straight out of the receive buffer, with no
+// intermediate objects and no allocation.
+//
+// A message is encoded once and the same bytes go to every session.
+// Each session puts its own frame header before the message.
+//
+// Times are nanoseconds since the epoch, or 0 when not known.  Taken
+// together they trace a message from the order behind it to the
+// subscriber.
+//
+// Frame header, 16 bytes:
+//    0 uint16  length of the frame header and the message
+//    2 uint16  reserved
+//    4 uint32  session sequence number, 1 for the first frame
+//    8 uint64  send time: the session handed the frame to its transport
+//
+// Message header, 48 bytes, common to all messages:
+//    0 uint16  length of the whole message
+//    2 uint8   message type (MSG_TYPE_DEPTH, MSG_TYPE_TRADE,
+//              MSG_TYPE_SNAPSHOT_REQUEST or MSG_TYPE_SUBSCRIBE)
+//    3 uint8   flags (FLAG_FULL: depth message carries every level;
+//              FLAG_SNAPSHOT: depth message answers a snapshot request)
+//    4 uint32  feed sequence number, the same on every session
+//    8 uint64  arrival time: the first order behind the message reached
+//              its book
+//   16 uint64  event time: the publisher heard of the depth change or
+//              trade
+//   24 uint64  time stamp: the message was encoded
+//   32 uint32  change id: for depth messages, the book's last change
+//              reflected; 0 otherwise
+//   36 uint32  reserved
+//   40 char[8] symbol, null padded
+//
+// A snapshot request is just the message header, as is a subscription,
+// which a subscriber sends on the feed connection for each symbol it
+// wants.  A subscriber that sends none gets every symbol.
+//
+// Depth body:
+//   48 uint8   number of bid levels that follow
+//   49 uint8   number of ask levels that follow
+//   50 uint16  reserved
+//   52 uint32  previous change id: an incremental message applies on top
+//              of the depth message for this change of the book
+//   56 levels, bids then asks, 16 bytes each:
+//       0 uint8   level number, 0 is the best
+//       1 uint8[3] reserved
+//       4 uint32  order count
+//       8 uint32  price
+//      12 uint32  aggregate quantity
+//
+// Trade body:
+//   48 uint64  quantity
+//   56 uint64  cost
+
+namespace liquibook { namespace examples { namespace codec {
+
+const uint8_t MSG_TYPE_DEPTH = 11;
+const uint8_t MSG_TYPE_TRADE = 22;
+const uint8_t MSG_TYPE_SNAPSHOT_REQUEST = 33;
+const uint8_t MSG_TYPE_SUBSCRIBE = 44;
+const uint8_t FLAG_FULL = 1;
+const uint8_t FLAG_SNAPSHOT = 2;
+
+const size_t FRAME_HEADER_SIZE = 16;
+const size_t HEADER_SIZE = 48;
+const size_t SYMBOL_SIZE = 8;
+const size_t DEPTH_BODY_SIZE = 8;
+const size_t LEVEL_SIZE = 16;
+const size_t TRADE_SIZE = HEADER_SIZE + 16;
+const size_t MAX_LEVELS = 255;
+
+// Largest message for a depth of SIZE levels per side
+template <int SIZE>
+struct MaxMessageSize {
+  static const size_t value = HEADER_SIZE + DEPTH_BODY_SIZE +
+                              2 * SIZE * LEVEL_SIZE;
+};
+
+// Largest frame for a depth of SIZE levels per side
+template <int SIZE>
+struct MaxFrameSize {
+  static const size_t value = FRAME_HEADER_SIZE + MaxMessageSize<SIZE>::value;
+};
+
+// Little endian stores and loads, independent of the host byte order
+inline void put_u8(unsigned char* at, uint8_t value) { at[0] = value; }
+
+inline void put_u16(unsigned char* at, uint16_t value)
+{
+  at[0] = uint8_t(value);
+  at[1] = uint8_t(value >> 8);
+}
+
+inline void put_u32(unsigned char* at, uint32_t value)
+{
+  put_u16(at, uint16_t(value));
+  put_u16(at + 2, uint16_t(value >> 16));
+}
+
+inline void put_u64(unsigned char* at, uint64_t value)
+{
+  put_u32(at, uint32_t(value));
+  put_u32(at + 4, uint32_t(value >> 32));
+}
+
+inline uint8_t get_u8(const unsigned char* at) { return at[0]; }
+
+inline uint16_t get_u16(const unsigned char* at)
+{
+  return uint16_t(at[0] | (at[1] << 8));
+}
+
+inline uint32_t get_u32(const unsigned char* at)
+{
+  return uint32_t(get_u16(at)) | (uint32_t(get_u16(at + 2)) << 16);
+}
+
+inline uint64_t get_u64(const unsigned char* at)
+{
+  return uint64_t(get_u32(at)) | (uint64_t(get_u32(at + 4)) << 32);
+}
+
+// The times a message carries, nanoseconds since the epoch
+struct Stamps {
+  Stamps(uint64_t arrival_time = 0, uint64_t event_time = 0,
+         uint64_t encode_time = 0)
+  : arrival(arrival_time),
+    event(event_time),
+    encoded(encode_time)
+  {
+  }
+  uint64_t arrival;
+  uint64_t event;
+  uint64_t encoded;
+};
+
+// Writes messages into a caller's buffer
+class Encoder {
+public:
+  // Encode the depth levels of a book.  Incremental messages carry the
+  // levels changed since the depth was last published.
+  // Returns the message length, or 0 if it does not fit in capacity.
+  template <int SIZE>
+  static size_t encode_depth(unsigned char* buffer, size_t capacity,
+                             uint32_t seq_num, const Stamps& stamps,
+                             const std::string& symbol,
+                             const book::Depth<SIZE>& depth,
+                             bool full_message);
+
+  // Encode every level of a copy of a book's depth, as a snapshot.
+  // Returns the message length, or 0 if it does not fit in capacity.
+  template <int LEVELS>
+  static size_t encode_snapshot(unsigned char* buffer, size_t capacity,
+                                uint32_t seq_num, const Stamps& stamps,
+                                const std::string& symbol,
+                                const book::TopOfBook<LEVELS>& levels);
+
+  // Encode a request for a snapshot of a symbol.
+  // Returns the message length, or 0 if it does not fit in capacity.
+  static size_t encode_snapshot_request(unsigned char* buffer,
+                                        size_t capacity, uint32_t seq_num,
+                                        const Stamps& stamps,
+                                        const std::string& symbol)
+  {
+    if (capacity < HEADER_SIZE) {
+      return 0;
+    }
+    encode_header(buffer, HEADER_SIZE, MSG_TYPE_SNAPSHOT_REQUEST, 0, seq_num,
+                  stamps, symbol, 0);
+    return HEADER_SIZE;
+  }
+
+  // Encode a subscription to a symbol.
+  // Returns the message length, or 0 if it does not fit in capacity.
+  static size_t encode_subscribe(unsigned char* buffer, size_t capacity,
+                                 uint32_t seq_num, const Stamps& stamps,
+                                 const std::string& symbol)
+  {
+    if (capacity < HEADER_SIZE) {
+      return 0;
+    }
+    encode_header(buffer, HEADER_SIZE, MSG_TYPE_SUBSCRIBE, 0, seq_num,
+                  stamps, symbol, 0);
+    return HEADER_SIZE;
+  }
+
+  // Encode a trade.
+  // Returns the message length, or 0 if it does not fit in capacity.
+  static size_t encode_trade(unsigned char* buffer, size_t capacity,
+                             uint32_t seq_num, const Stamps& stamps,
+                             const std::string& symbol,
+                             book::Quantity qty, book::Cost cost)
+  {
+    if (capacity < TRADE_SIZE) {
+      return 0;
+    }
+    encode_header(buffer, TRADE_SIZE, MSG_TYPE_TRADE, 0, seq_num,
+                  stamps, symbol, 0);
+    put_u64(buffer + 48, qty);
+    put_u64(buffer + 56, cost);
+    return TRADE_SIZE;
+  }
+
+  // Overwrite the sequence number of an encoded message
+  static void set_seq_num(unsigned char* message, uint32_t seq_num)
+  {
+    put_u32(message + 4, seq_num);
+  }
+
+  // Encode the frame header a session sends before a message
+  static void encode_frame_header(unsigned char* buffer,
+                                  size_t message_length,
+                                  uint32_t session_seq_num,
+                                  uint64_t send_time)
+  {
+    put_u16(buffer, uint16_t(FRAME_HEADER_SIZE + message_length));
+    put_u16(buffer + 2, 0);
+    put_u32(buffer + 4, session_seq_num);
+    put_u64(buffer + 8, send_time);
+  }
+
+private:
+  static void encode_header(unsigned char* buffer, size_t length,
+                            uint8_t msg_type, uint8_t flags,
+                            uint32_t seq_num, const Stamps& stamps,
+                            const std::string& symbol,
+                            book::ChangeId change_id)
+  {
+    if (symbol.size() > SYMBOL_SIZE) {
+      throw std::runtime_error("Symbol too long to encode: " + symbol);
+    }
+    put_u16(buffer, uint16_t(length));
+    put_u8(buffer + 2, msg_type);
+    put_u8(buffer + 3, flags);
+    put_u32(buffer + 4, seq_num);
+    put_u64(buffer + 8, stamps.arrival);
+    put_u64(buffer + 16, stamps.event);
+    put_u64(buffer + 24, stamps.encoded);
+    put_u32(buffer + 32, change_id);
+    put_u32(buffer + 36, 0);
+    memset(buffer + 40, 0, SYMBOL_SIZE);
+    memcpy(buffer + 40, symbol.data(), symbol.size());
+  }
+
+  static unsigned char* encode_level(unsigned char* at, int level_num,
+                                     uint32_t order_count, book::Price price,
+                                     book::Quantity qty)
+  {
+    put_u32(at, 0);
+    put_u8(at, uint8_t(level_num));
+    put_u32(at + 4, order_count);
+    put_u32(at + 8, uint32_t(price));
+    put_u32(at + 12, uint32_t(qty));
+    return at + LEVEL_SIZE;
+  }
+
+  static unsigned char* encode_level(unsigned char* at,
+                                     const book::DepthLevel& level,
+                                     int level_num)
+  {
+    return encode_level(at, level_num, level.order_count(), level.price(),
+                        level.aggregate_qty());
+  }
+
+  static void encode_depth_body(unsigned char* buffer, uint8_t bid_count,
+                                uint8_t ask_count,
+                                book::ChangeId prev_change_id)
+  {
+    put_u8(buffer + 48, bid_count);
+    put_u8(buffer + 49, ask_count);
+    put_u16(buffer + 50, 0);
+    put_u32(buffer + 52, prev_change_id);
+  }
+};
+
+template <int SIZE>
+size_t
+Encoder::encode_depth(unsigned char* buffer, size_t capacity,
+                      uint32_t seq_num, const Stamps& stamps,
+                      const std::string& symbol,
+                      const book::Depth<SIZE>& depth,
+                      bool full_message)
+{
+  static_assert(SIZE <= int(MAX_LEVELS), "Too many levels to encode");
+  if (capacity < MaxMessageSize<SIZE>::value) {
+    return 0;
+  }
+  book::ChangeId last_published_change = depth.last_published_change();
+  unsigned char* level = buffer + HEADER_SIZE + DEPTH_BODY_SIZE;
+  uint8_t bid_count = 0;
+  const book::DepthLevel* bid = depth.bids();
+  for (int index = 0; index < SIZE; ++index, ++bid) {
+    if (full_message || bid->changed_since(last_published_change)) {
+      level = encode_level(level, *bid, index);
+      ++bid_count;
+    }
+  }
+  uint8_t ask_count = 0;
+  const book::DepthLevel* ask = depth.asks();
+  for (int index = 0; index < SIZE; ++index, ++ask) {
+    if (full_message || ask->changed_since(last_published_change)) {
+      level = encode_level(level, *ask, index);
+      ++ask_count;
+    }
+  }
+  size_t length = size_t(level - buffer);
+  encode_header(buffer, length, MSG_TYPE_DEPTH,
+                full_message ? FLAG_FULL : 0, seq_num, stamps, symbol,
+                depth.last_change());
+  encode_depth_body(buffer, bid_count, ask_count, last_published_change);
+  return length;
+}
+
+template <int LEVELS>
+size_t
+Encoder::encode_snapshot(unsigned char* buffer, size_t capacity,
+                         uint32_t seq_num, const Stamps& stamps,
+                         const std::string& symbol,
+                         const book::TopOfBook<LEVELS>& levels)
+{
+  static_assert(LEVELS <= int(MAX_LEVELS), "Too many levels to encode");
+  if (capacity < MaxMessageSize<LEVELS>::value) {
+    return 0;
+  }
+  unsigned char* level = buffer + HEADER_SIZE + DEPTH_BODY_SIZE;
+  for (int index = 0; index < LEVELS; ++index) {
+    const typename book::TopOfBook<LEVELS>::Level& bid = levels.bids[index];
+    level = encode_level(level, index, bid.order_count, bid.price, bid.qty);
+  }
+  for (int index = 0; index < LEVELS; ++index) {
+    const typename book::TopOfBook<LEVELS>::Level& ask = levels.asks[index];
+    level = encode_level(level, index, ask.order_count, ask.price, ask.qty);
+  }
+  size_t length = size_t(level - buffer);
+  encode_header(buffer, length, MSG_TYPE_DEPTH, FLAG_FULL | FLAG_SNAPSHOT,
+                seq_num, stamps, symbol, levels.change_id);
+  encode_depth_body(buffer, uint8_t(LEVELS), uint8_t(LEVELS), 0);
+  return length;
+}
+
+// Read only views of encoded messages.  They refer to the bytes in
+// place, so the buffer must outlive the view.
+
+// One depth level in a depth message
+class LevelView {
+public:
+  explicit LevelView(const unsigned char* data) : data_(data) {}
+  uint8_t level_num() const { return get_u8(data_); }
+  uint32_t order_count() const { return get_u32(data_ + 4); }
+  uint32_t price() const { return get_u32(data_ + 8); }
+  uint32_t qty() const { return get_u32(data_ + 12); }
+private:
+  const unsigned char* data_;
+};
+
+// A frame: a session's header and the message after it
+class FrameView {
+public:
+  explicit FrameView(const unsigned char* data) : data_(data) {}
+
+  // The length of the complete frame at the start of a buffer,
+  // or 0 if fewer bytes are available than it needs
+  static size_t complete_length(const unsigned char* data, size_t available)
+  {
+    if (available < 2) {
+      return 0;
+    }
+    size_t length = get_u16(data);
+    return length <= available ? length : 0;
+  }
+
+  // Does the frame hold exactly one valid message?
+  bool valid() const;
+
+  uint16_t length() const { return get_u16(data_); }
+  uint32_t seq_num() const { return get_u32(data_ + 4); }
+  uint64_t send_time() const { return get_u64(data_ + 8); }
+  const unsigned char* message() const { return data_ + FRAME_HEADER_SIZE; }
+
+private:
+  const unsigned char* data_;
+};
+
+// The header of any message
+class MessageView {
+public:
+  explicit MessageView(const unsigned char* data) : data_(data) {}
+
+  // Is the message long enough for its type and contents?
+  bool valid() const;
+
+  uint16_t length() const { return get_u16(data_); }
+  uint8_t msg_type() const { return get_u8(data_ + 2); }
+  uint8_t flags() const { return get_u8(data_ + 3); }
+  uint32_t seq_num() const { return get_u32(data_ + 4); }
+  uint64_t arrival_time() const { return get_u64(data_ + 8); }
+  uint64_t event_time() const { return get_u64(data_ + 16); }
+  uint64_t timestamp() const { return get_u64(data_ + 24); }
+  uint32_t change_id() const { return get_u32(data_ + 32); }
+
+  // The symbol, without its padding
+  const char* symbol_data() const
+  {
+    return reinterpret_cast<const char*>(data_ + 40);
+  }
+  size_t symbol_length() const
+  {
+    const char* symbol = symbol_data();
+    size_t length = 0;
+    while (length < SYMBOL_SIZE && symbol[length]) {
+      ++length;
+    }
+    return length;
+  }
+  std::string symbol() const
+  {
+    return std::string(symbol_data(), symbol_length());
+  }
+
+  // The encoded message, length() bytes
+  const unsigned char* data() const { return data_; }
+
+protected:
+  const unsigned char* data_;
+};
+
+// A depth message
+class DepthMessageView : public MessageView {
+public:
+  explicit DepthMessageView(const unsigned char* data) : MessageView(data) {}
+  bool full() const { return (flags() & FLAG_FULL) != 0; }
+  bool snapshot() const { return (flags() & FLAG_SNAPSHOT) != 0; }
+  uint8_t bid_count() const { return get_u8(data_ + 48); }
+  uint8_t ask_count() const { return get_u8(data_ + 49); }
+  LevelView bid(size_t index) const { return level(index); }
+  LevelView ask(size_t index) const { return level(bid_count() + index); }
+  uint32_t prev_change_id() const { return get_u32(data_ + 52); }
+private:
+  LevelView level(size_t index) const
+  {
+    return LevelView(data_ + HEADER_SIZE + DEPTH_BODY_SIZE +
+                     index * LEVEL_SIZE);
+  }
+};
+
+// A trade message
+class TradeMessageView : public MessageView {
+public:
+  explicit TradeMessageView(const unsigned char* data) : MessageView(data) {}
+  uint64_t qty() const { return get_u64(data_ + 48); }
+  uint64_t cost() const { return get_u64(data_ + 56); }
+};
+
+inline bool
+MessageView::valid() const
+{
+  size_t size = length();
+  if (size < HEADER_SIZE) {
+    return false;
+  }
+  switch (msg_type()) {
+  case MSG_TYPE_DEPTH: {
+    if (size < HEADER_SIZE + DEPTH_BODY_SIZE) {
+      return false;
+    }
+    DepthMessageView depth(data_);
+    return size == HEADER_SIZE + DEPTH_BODY_SIZE +
+        (size_t(depth.bid_count()) + depth.ask_count()) * LEVEL_SIZE;
+  }
+  case MSG_TYPE_TRADE:
+    return size == TRADE_SIZE;
+  case MSG_TYPE_SNAPSHOT_REQUEST:
+  case MSG_TYPE_SUBSCRIBE:
+    return size == HEADER_SIZE;
+  default:
+    return false;
+  }
+}
+
+// Splits a stream of bytes into frames.  Complete frames are handed on
+// in place; a frame split across reads is gathered in a buffer of its own.
+template <size_t MAX_FRAME>
+class FrameReader {
+public:
+  FrameReader() : partial_size_(0) {}
+
+  // Forget any partly read frame, as when the stream is reconnected
+  void reset() { partial_size_ = 0; }
+
+  // Call handler(frame) for each complete frame.  Returns false if the
+  // handler does, or a frame has an impossible length.
+  template <class Handler>
+  bool read(const unsigned char* data, size_t size, Handler handler);
+
+private:
+  unsigned char partial_[MAX_FRAME];
+  size_t partial_size_;
+};
+
+template <size_t MAX_FRAME>
+template <class Handler>
+bool
+FrameReader<MAX_FRAME>::read(const unsigned char* data, size_t size,
+                             Handler handler)
+{
+  // A read may hold several frames, and may end part way through one
+  size_t remaining = size;
+  while (remaining) {
+    if (!partial_size_) {
+      size_t length = FrameView::complete_length(data, remaining);
+      if (length) {
+        if (length < FRAME_HEADER_SIZE + HEADER_SIZE || length > MAX_FRAME ||
+            !handler(data)) {
+          return false;
+        }
+        data += length;
+        remaining -= length;
+        continue;
+      }
+    }
+    // Gather a frame split across reads, its length first
+    size_t wanted = 2;
+    if (partial_size_ >= 2) {
+      wanted = get_u16(partial_);
+      if (wanted < FRAME_HEADER_SIZE + HEADER_SIZE || wanted > MAX_FRAME) {
+        return false;
+      }
+    }
+    size_t taken = std::min(wanted - partial_size_, remaining);
+    memcpy(partial_ + partial_size_, data, taken);
+    partial_size_ += taken;
+    data += taken;
+    remaining -= taken;
+    if (partial_size_ > 2 && partial_size_ == wanted) {
+      partial_size_ = 0;
+      if (!handler(partial_)) {
+        return false;
+      }
+    }
+  }
+  return true;
+}
+
+inline bool
+FrameView::valid() const
+{
+  if (length() < FRAME_HEADER_SIZE + HEADER_SIZE) {
+    return false;
+  }
+  MessageView msg(message());
+  return msg.length() == length() - FRAME_HEADER_SIZE && msg.valid();
+}
+
+} } } // End namespace
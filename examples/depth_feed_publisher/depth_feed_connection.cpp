@@ -1,132 +1,218 @@
 #include "depth_feed_connection.h"
+#include "book/timestamp.h"
 #include <iomanip>
 #include <boost/bind.hpp>
-#include "template_consumer.h"
-#include <Codecs/DataDestination.h>
-#include <Messages/FieldSet.h>
-#include <Messages/FieldUInt32.h>
+#include <cstring>
 
 using namespace boost::asio::ip;
 
 namespace liquibook { namespace examples {
 
-QuickFAST::template_id_t DepthFeedSession::TID_TRADE_MESSAGE(1);
-QuickFAST::template_id_t DepthFeedSession::TID_DEPTH_MESSAGE(2);
-
 DepthFeedSession::DepthFeedSession(
     boost::asio::io_service& ios,
     DepthFeedConnection* connection,
-    QuickFAST::Codecs::TemplateRegistryPtr& templates)
+    SlowConsumerPolicy policy,
+    size_t queue_limit)
 : connected_(false),
   seq_num_(0),
+  policy_(policy),
+  queue_limit_(queue_limit),
+  all_symbols_(true),
   ios_(ios),
   socket_(ios),
   connection_(connection),
-  encoder_(templates)
+  batch_size_(0)
 {
 }
 
 void
-DepthFeedSession::send_trade(QuickFAST::Messages::FieldSet& message)
+DepthFeedSession::start_read()
 {
-  // Add or update sequence number in message
-  set_sequence_num(message);
-                            
-  std::cout << "sending trade message with " << message.size() << " fields" << std::endl;
-
-  QuickFAST::Codecs::DataDestination dest;
-  encoder_.encodeMessage(dest, TID_TRADE_MESSAGE, message);
-  WorkingBufferPtr wb = connection_->reserve_send_buffer();
-  dest.toWorkingBuffer(*wb);
+  socket_.async_read_some(
+      boost::asio::buffer(recv_buffer_),
+      boost::bind(&DepthFeedSession::on_receive, shared_from_this(), _1, _2));
+}
 
-  // Perform the send
-  SendHandler send_handler = boost::bind(&DepthFeedSession::on_send,
-                                         this, wb, _1, _2);
-  boost::asio::const_buffers_1 buffer(
-      boost::asio::buffer(wb->begin(), wb->size()));
-  socket_.async_send(buffer, 0, send_handler);
+void
+DepthFeedSession::subscribe(book::SymbolId symbol_id)
+{
+  // The first subscription narrows the session from every symbol
+  if (all_symbols_) {
+    all_symbols_ = false;
+    subscriptions_.clear();
+  }
+  subscriptions_.insert(symbol_id);
 }
 
-bool
-DepthFeedSession::send_incr_update(const std::string& symbol,
-                                   QuickFAST::Messages::FieldSet& message)
-{
-  bool sent = false;
-  // If the session has been started for this symbol
-  if (sent_symbols_.find(symbol) != sent_symbols_.end()) {
-    QuickFAST::Codecs::DataDestination dest;
-    // Add or update sequence number in message
-    set_sequence_num(message);
-    encoder_.encodeMessage(dest, TID_DEPTH_MESSAGE, message);
-    WorkingBufferPtr wb = connection_->reserve_send_buffer();
-    dest.toWorkingBuffer(*wb);
-    SendHandler send_handler = boost::bind(&DepthFeedSession::on_send,
-                                           this, wb, _1, _2);
-    boost::asio::const_buffers_1 buffer(
-        boost::asio::buffer(wb->begin(), wb->size()));
-    socket_.async_send(buffer, 0, send_handler);
-    sent = true;
-  }
-  return sent;
+void
+DepthFeedSession::send_trade(book::SymbolId symbol_id,
+                             const MessagePtr& message)
+{
+  if (subscribed(symbol_id)) {
+    send(symbol_id, message);
+  }
 }
 
 void
-DepthFeedSession::send_full_update(const std::string& symbol,
-                                   QuickFAST::Messages::FieldSet& message)
+DepthFeedSession::send_depth_update(book::SymbolId symbol_id,
+                                    const MessagePtr& message)
 {
-  // Mark this symbols as sent
-  std::pair<StringSet::iterator, bool> result = sent_symbols_.insert(symbol);
+  if (!subscribed(symbol_id)) {
+    return;
+  }
+  if (policy_ == sc_conflate && queued_.size() >= queue_limit_) {
+    // Behind: the latest update replaces what is queued for the symbol.
+    // The subscriber sees the gap and fetches a snapshot.
+    std::cout << "Conflating " << codec::MessageView(message->data).symbol()
+              << " for slow subscriber with " << queued_.size()
+              << " messages queued" << std::endl;
+    conflate(symbol_id);
+  }
+  send(symbol_id, message);
+}
 
-  // If this symbol is new for the session
-  if (result.second) {
-    QuickFAST::Codecs::DataDestination dest;
-    // Add or update sequence number in message
-    set_sequence_num(message);
-    encoder_.encodeMessage(dest, TID_DEPTH_MESSAGE, message);
-    WorkingBufferPtr wb = connection_->reserve_send_buffer();
-    dest.toWorkingBuffer(*wb);
+void
+DepthFeedSession::send(book::SymbolId symbol_id, const MessagePtr& message)
+{
+  if (!connected_) {
+    return;
+  }
+  // Never wait for a slow subscriber; drop it instead
+  size_t limit = policy_ == sc_conflate ? 2 * queue_limit_ : queue_limit_;
+  if (queued_.size() >= limit) {
+    std::cout << "Disconnecting slow subscriber with " << queued_.size()
+              << " messages queued" << std::endl;
+    disconnect();
+    return;
+  }
+  // The message bytes are shared; only the header belongs to this session
+  QueuedMessage queued = { message, symbol_id };
+  queued_.push_back(queued);
+  if (!batch_size_) {
+    write_next();
+  }
+}
 
-    // Perform the send
-    SendHandler send_handler = boost::bind(&DepthFeedSession::on_send,
-                                           this, wb, _1, _2);
-    boost::asio::const_buffers_1 buffer(
-        boost::asio::buffer(wb->begin(), wb->size()));
-    socket_.async_send(buffer, 0, send_handler);
+void
+DepthFeedSession::write_next()
+{
+  // Everything queued while the last batch was written goes out in one
+  // gather write, up to the batch limits
+  size_t bytes = 0;
+  uint64_t send_time = book::timestamp_now();
+  while (!queued_.empty() && batch_size_ < MAX_BATCH_FRAMES) {
+    const MessagePtr& message = queued_.front().message;
+    size_t frame_bytes = codec::FRAME_HEADER_SIZE + message->size;
+    if (batch_size_ && bytes + frame_bytes > MAX_BATCH_BYTES) {
+      break;
+    }
+    Frame& frame = batch_[batch_size_];
+    codec::Encoder::encode_frame_header(frame.header, message->size,
+                                        ++seq_num_, send_time);
+    frame.message = message;
+    gather_[2 * batch_size_] =
+        boost::asio::buffer(frame.header, sizeof(frame.header));
+    gather_[2 * batch_size_ + 1] =
+        boost::asio::buffer(message->data, message->size);
+    bytes += frame_bytes;
+    ++batch_size_;
+    queued_.pop_front();
   }
+  GatherBuffers buffers = { gather_, gather_ + 2 * batch_size_ };
+  SendHandler send_handler = boost::bind(&DepthFeedSession::on_send,
+                                         shared_from_this(), _1, _2);
+  boost::asio::async_write(socket_, buffers, send_handler);
 }
 
 void
-DepthFeedSession::set_sequence_num(QuickFAST::Messages::FieldSet& message)
+DepthFeedSession::conflate(book::SymbolId symbol_id)
 {
-  // Create the field
-  QuickFAST::Messages::FieldCPtr value = 
-      QuickFAST::Messages::FieldUInt32::create(++seq_num_);
-  // Update the sequence number
-  if (!message.replaceField(TemplateConsumer::id_seq_num_, value)) {
-    // Not found, add the sequence number
-    message.addField(TemplateConsumer::id_seq_num_, value);
+  Messages::iterator message = queued_.begin();
+  while (message != queued_.end()) {
+    if (message->symbol_id == symbol_id &&
+        codec::MessageView(message->message->data).msg_type() ==
+            codec::MSG_TYPE_DEPTH) {
+      message = queued_.erase(message);
+    } else {
+      ++message;
+    }
   }
 }
 
 void
-DepthFeedSession::on_send(WorkingBufferPtr wb,
-                          const boost::system::error_code& error,
+DepthFeedSession::disconnect()
+{
+  connected_ = false;
+  queued_.clear();
+  // Close from the IO thread, which owns the socket's pending write
+  ios_.post(boost::bind(&DepthFeedSession::close, shared_from_this()));
+}
+
+void
+DepthFeedSession::close()
+{
+  std::lock_guard<std::mutex> lock(connection_->send_mutex());
+  boost::system::error_code ec;
+  socket_.close(ec);
+}
+
+void
+DepthFeedSession::on_send(const boost::system::error_code& error,
                           std::size_t bytes_transferred)
 {
+  std::lock_guard<std::mutex> lock(connection_->send_mutex());
+  // Release this session's hold on the messages
+  for (size_t index = 0; index < batch_size_; ++index) {
+    batch_[index].message.reset();
+  }
+  batch_size_ = 0;
   if (error) {
-    std::cout << "Error " << error << " sending message" << std::endl;
+    if (connected_) {
+      std::cout << "Error " << error << " sending message" << std::endl;
+    }
     connected_ = false;
+    queued_.clear();
+  } else if (!queued_.empty()) {
+    write_next();
+  }
+}
+
+void
+DepthFeedSession::on_receive(const boost::system::error_code& error,
+                             std::size_t bytes_transferred)
+{
+  // A closed connection is noticed, and the session dropped, when sending
+  if (error) {
+    return;
   }
+  if (!reader_.read(recv_buffer_.data(), bytes_transferred,
+                    boost::bind(&DepthFeedSession::handle_request, this, _1))) {
+    std::cout << "Bad request from subscriber" << std::endl;
+    return;
+  }
+  // The publishing thread starts writes on the socket under the lock
+  std::lock_guard<std::mutex> lock(connection_->send_mutex());
+  start_read();
+}
 
-  // Keep buffer for later
-  connection_->on_send(wb, error, bytes_transferred);
+bool
+DepthFeedSession::handle_request(const unsigned char* data)
+{
+  codec::FrameView frame(data);
+  codec::MessageView msg(frame.message());
+  if (!frame.valid() || msg.msg_type() != codec::MSG_TYPE_SUBSCRIBE) {
+    return false;
+  }
+  connection_->on_subscribe(shared_from_this(), msg.symbol());
+  return true;
 }
 
 DepthFeedConnection::DepthFeedConnection(int argc, const char* argv[])
-: template_filename_(template_file_from_args(argc, argv)),
-  host_(host_from_args(argc, argv)),
+: host_(host_from_args(argc, argv)),
   port_(port_from_args(argc, argv)),
-  templates_(TemplateConsumer::parse_templates(template_filename_)),
+  policy_(policy_from_args(argc, argv)),
+  queue_limit_(queue_limit_from_args(argc, argv)),
+  all_wanted_(false),
   socket_(ios_)
 {
 }
@@ -152,7 +238,7 @@ DepthFeedConnection::accept()
     acceptor_->bind(endpoint);
     acceptor_->listen();
   }
-  SessionPtr session(new DepthFeedSession(ios_, this, templates_));
+  SessionPtr session(new DepthFeedSession(ios_, this, policy_, queue_limit_));
   acceptor_->async_accept(
       session->socket(), 
       boost::bind(&DepthFeedConnection::on_accept, this, session, _1));
@@ -179,6 +265,18 @@ DepthFeedConnection::set_reset_handler(ResetHandler handler)
   reset_handler_ = handler;
 }
 
+void
+DepthFeedConnection::set_symbol_resolver(SymbolResolver resolver)
+{
+  symbol_resolver_ = resolver;
+}
+
+void
+DepthFeedConnection::set_subscriptions(const std::vector<std::string>& symbols)
+{
+  subscriptions_ = symbols;
+}
+
 BufferPtr
 DepthFeedConnection::reserve_recv_buffer()
 {
@@ -191,74 +289,85 @@ DepthFeedConnection::reserve_recv_buffer()
   }
 }
 
-WorkingBufferPtr
+SendBufferPtr
 DepthFeedConnection::reserve_send_buffer()
 {
-  if (unused_send_buffers_.empty()) {
-    return WorkingBufferPtr(new QuickFAST::WorkingBuffer());
+  // Buffers go to the back as they are handed out, so the front one is
+  // the oldest.  Reuse it once no session still holds it.
+  std::lock_guard<std::mutex> lock(send_mutex_);
+  SendBufferPtr sb;
+  if (!send_buffers_.empty() && send_buffers_.front().unique()) {
+    sb = send_buffers_.front();
+    send_buffers_.pop_front();
   } else {
-    WorkingBufferPtr wb = unused_send_buffers_.front();
-    unused_send_buffers_.pop_front();
-    return wb;
+    sb.reset(new SendBuffer());
   }
+  send_buffers_.push_back(sb);
+  return sb;
+}
+
+bool
+DepthFeedConnection::wants(book::SymbolId symbol_id) const
+{
+  std::lock_guard<std::mutex> lock(send_mutex_);
+  return all_wanted_ || wanted_.contains(symbol_id);
 }
 
 void
-DepthFeedConnection::send_trade(QuickFAST::Messages::FieldSet& message)
+DepthFeedConnection::send_trade(book::SymbolId symbol_id,
+                                const MessagePtr& message)
 {
-  // For each session
+  std::lock_guard<std::mutex> lock(send_mutex_);
+  remove_closed_sessions();
+  // Each session checks its subscription
   Sessions::iterator session;
-  for (session = sessions_.begin(); session != sessions_.end(); ) {
-    // If the session is connected
-    if ((*session)->connected()) {
-      // conditionally send on that session
-      (*session)->send_trade(message);
-      ++session;
-    } else {
-      // Remove the session
-      session = sessions_.erase(session);
-    }
+  for (session = sessions_.begin(); session != sessions_.end(); ++session) {
+    (*session)->send_trade(symbol_id, message);
   }
 }
 
-bool
-DepthFeedConnection::send_incr_update(const std::string& symbol,
-                                      QuickFAST::Messages::FieldSet& message)
+void
+DepthFeedConnection::send_depth_update(book::SymbolId symbol_id,
+                                       const MessagePtr& message)
 {
-  bool none_new = true;
-  // For each session
+  std::lock_guard<std::mutex> lock(send_mutex_);
+  remove_closed_sessions();
+  // Each session checks its subscription
   Sessions::iterator session;
-  for (session = sessions_.begin(); session != sessions_.end(); ) {
-    // If the session is connected
+  for (session = sessions_.begin(); session != sessions_.end(); ++session) {
+    (*session)->send_depth_update(symbol_id, message);
+  }
+}
+
+void
+DepthFeedConnection::remove_closed_sessions()
+{
+  Sessions::iterator session = sessions_.begin();
+  bool removed = false;
+  while (session != sessions_.end()) {
     if ((*session)->connected()) {
-      // send on that session
-      if (!(*session)->send_incr_update(symbol, message)) {
-        none_new = false;
-      }
       ++session;
     } else {
-      // Remove the session
       session = sessions_.erase(session);
+      removed = true;
     }
   }
-  return none_new;
+  if (removed) {
+    update_wanted();
+  }
 }
 
 void
-DepthFeedConnection::send_full_update(const std::string& symbol,
-                                      QuickFAST::Messages::FieldSet& message)
+DepthFeedConnection::update_wanted()
 {
-  // For each session
-  Sessions::iterator session;
-  for (session = sessions_.begin(); session != sessions_.end(); ) {
-    // If the session is connected
-    if ((*session)->connected()) {
-      // conditionally send on that session
-      (*session)->send_full_update(symbol, message);
-      ++session;
+  wanted_.clear();
+  all_wanted_ = false;
+  Sessions::const_iterator session;
+  for (session = sessions_.begin(); session != sessions_.end(); ++session) {
+    if ((*session)->all_symbols()) {
+      all_wanted_ = true;
     } else {
-      // Remove the session
-      session = sessions_.erase(session);
+      wanted_.insert((*session)->subscriptions());
     }
   }
 }
@@ -269,6 +378,7 @@ DepthFeedConnection::on_connect(const boost::system::error_code& error)
   if (!error) {
     std::cout << "connected to feed" << std::endl;
     reset_handler_();
+    send_subscriptions();
     issue_read();
   } else {
     std::cout << "on_connect, error=" << error << std::endl;
@@ -285,8 +395,12 @@ DepthFeedConnection::on_accept(SessionPtr session,
 {
   if (!error) {
     std::cout << "accepted client connection" << std::endl;
+    std::lock_guard<std::mutex> lock(send_mutex_);
     sessions_.push_back(session);
     session->set_connected();
+    // Every symbol, until it subscribes
+    all_wanted_ = true;
+    session->start_read();
   } else {
     std::cout << "on_accept, error=" << error << std::endl;
     session.reset();
@@ -296,6 +410,22 @@ DepthFeedConnection::on_accept(SessionPtr session,
   accept();
 }
 
+void
+DepthFeedConnection::on_subscribe(SessionPtr session,
+                                  const std::string& symbol)
+{
+  book::SymbolId symbol_id = symbol_resolver_ ?
+      symbol_resolver_(symbol) : book::INVALID_SYMBOL_ID;
+  if (symbol_id == book::INVALID_SYMBOL_ID) {
+    std::cout << "Subscription to unknown symbol " << symbol << std::endl;
+    return;
+  }
+  std::cout << "Subscriber subscribed to " << symbol << std::endl;
+  std::lock_guard<std::mutex> lock(send_mutex_);
+  session->subscribe(symbol_id);
+  update_wanted();
+}
+
 void
 DepthFeedConnection::on_receive(BufferPtr bp,
                                 const boost::system::error_code& error,
@@ -320,12 +450,38 @@ DepthFeedConnection::on_receive(BufferPtr bp,
 }
 
 void
-DepthFeedConnection::on_send(WorkingBufferPtr wb,
-                             const boost::system::error_code& error,
-                             std::size_t bytes_transferred)
+DepthFeedConnection::send_subscriptions()
+{
+  if (subscriptions_.empty()) {
+    return;
+  }
+  // One request per symbol, all in one write
+  subscribe_frames_.resize(
+      subscriptions_.size() * (codec::FRAME_HEADER_SIZE + codec::HEADER_SIZE));
+  unsigned char* frame = &subscribe_frames_[0];
+  for (size_t index = 0; index < subscriptions_.size(); ++index) {
+    uint32_t seq_num = uint32_t(index + 1);
+    size_t size = codec::Encoder::encode_subscribe(
+        frame + codec::FRAME_HEADER_SIZE, codec::HEADER_SIZE, seq_num,
+        codec::Stamps(0, 0, book::timestamp_now()), subscriptions_[index]);
+    codec::Encoder::encode_frame_header(frame, size, seq_num,
+                                        book::timestamp_now());
+    frame += codec::FRAME_HEADER_SIZE + size;
+  }
+  boost::asio::async_write(
+      socket_, boost::asio::buffer(subscribe_frames_),
+      boost::bind(&DepthFeedConnection::on_subscriptions_sent, this, _1, _2));
+}
+
+void
+DepthFeedConnection::on_subscriptions_sent(
+    const boost::system::error_code& error,
+    std::size_t bytes_transferred)
 {
-  // Keep buffer for later
-  unused_send_buffers_.push_back(wb);
+  // A failed connection is noticed, and made again, when reading
+  if (error) {
+    std::cout << "Error " << error << " subscribing" << std::endl;
+  }
 }
 
 void
@@ -339,20 +495,6 @@ DepthFeedConnection::issue_read()
   socket_.async_receive(buffer, 0, recv_handler);
 }
 
-const char*
-DepthFeedConnection::template_file_from_args(int argc, const char* argv[])
-{
-  bool next_is_name = false;
-  for (int i = 0; i < argc; ++i) {
-    if (next_is_name) {
-      return argv[i];
-    } else if (strcmp(argv[i], "-t") == 0) {
-      next_is_name = true;
-    }
-  }
-  return "./templates/depth.xml";
-}
-
 const char*
 DepthFeedConnection::host_from_args(int argc, const char* argv[])
 {
@@ -381,4 +523,75 @@ DepthFeedConnection::port_from_args(int argc, const char* argv[])
   return 10003;
 }
 
+int
+DepthFeedConnection::snapshot_port_from_args(int argc, const char* argv[])
+{
+  bool next_is_port = false;
+  for (int i = 0; i < argc; ++i) {
+    if (next_is_port) {
+      return atoi(argv[i]);
+    } else if (strcmp(argv[i], "-r") == 0) {
+      next_is_port = true;
+    }
+  }
+  // Beside the feed port
+  return port_from_args(argc, argv) + 1;
+}
+
+SlowConsumerPolicy
+DepthFeedConnection::policy_from_args(int argc, const char* argv[])
+{
+  bool next_is_policy = false;
+  for (int i = 0; i < argc; ++i) {
+    if (next_is_policy) {
+      return strcmp(argv[i], "disconnect") == 0 ? sc_disconnect : sc_conflate;
+    } else if (strcmp(argv[i], "-s") == 0) {
+      next_is_policy = true;
+    }
+  }
+  return sc_conflate;
+}
+
+size_t
+DepthFeedConnection::queue_limit_from_args(int argc, const char* argv[])
+{
+  bool next_is_limit = false;
+  for (int i = 0; i < argc; ++i) {
+    if (next_is_limit) {
+      return size_t(atoi(argv[i]));
+    } else if (strcmp(argv[i], "-q") == 0) {
+      next_is_limit = true;
+    }
+  }
+  return 1024;
+}
+
+std::vector<std::string>
+DepthFeedConnection::subscriptions_from_args(int argc, const char* argv[])
+{
+  // A comma separated list
+  std::vector<std::string> symbols;
+  bool next_is_list = false;
+  for (int i = 0; i < argc; ++i) {
+    if (next_is_list) {
+      std::string list(argv[i]);
+      size_t start = 0;
+      while (start < list.size()) {
+        size_t end = list.find(',', start);
+        if (end == std::string::npos) {
+          end = list.size();
+        }
+        if (end > start) {
+          symbols.push_back(list.substr(start, end - start));
+        }
+        start = end + 1;
+      }
+      break;
+    } else if (strcmp(argv[i], "-u") == 0) {
+      next_is_list = true;
+    }
+  }
+  return symbols;
+}
+
 } } // End namespace
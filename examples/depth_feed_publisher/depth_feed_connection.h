@@ -2,37 +2,69 @@
 
 #include "asio_safe_include.h"
 #include "sleep.h"
+#include "depth_feed_codec.h"
+#include "book/symbol_set.h"
+#include <boost/array.hpp>
+#include <boost/enable_shared_from_this.hpp>
 #include <boost/function.hpp>
 #include <boost/noncopyable.hpp>
-#include <boost/scoped_array.hpp>
 #include <boost/shared_ptr.hpp>
-#include <Application/QuickFAST.h>
-#include <Common/WorkingBuffer.h>
 #include <deque>
-#include <set>
-#include <Codecs/Encoder.h>
-#include <Codecs/TemplateRegistry_fwd.h>
+#include <iostream>
+#include <mutex>
+#include <string>
+#include <vector>
 
 namespace liquibook { namespace examples {
-  typedef boost::shared_ptr<QuickFAST::WorkingBuffer> WorkingBufferPtr;
-  typedef std::deque<WorkingBufferPtr> WorkingBuffers;
-  typedef boost::array<unsigned char, 128> Buffer;
+  // Room for the largest message the example publishes
+  const size_t MAX_MESSAGE_SIZE = codec::MaxMessageSize<5>::value;
+  const size_t MAX_FRAME_SIZE = codec::MaxFrameSize<5>::value;
+
+  // An encoded message.  Encoded once, then shared read only by every
+  // session sending it.
+  struct SendBuffer {
+    unsigned char data[MAX_MESSAGE_SIZE];
+    size_t size;
+  };
+  typedef boost::shared_ptr<SendBuffer> SendBufferPtr;
+  typedef boost::shared_ptr<const SendBuffer> MessagePtr;
+  typedef std::deque<SendBufferPtr> SendBuffers;
+  typedef boost::array<unsigned char, 1024> Buffer;
   typedef boost::shared_ptr<Buffer> BufferPtr;
   typedef boost::function<bool (BufferPtr, size_t)> MessageHandler;
   typedef boost::function<void ()> ResetHandler;
+  typedef boost::function<book::SymbolId (const std::string&)>
+      SymbolResolver;
   typedef boost::function<void (const boost::system::error_code& error,
                                 std::size_t bytes_transferred)> SendHandler;
   typedef boost::function<void (const boost::system::error_code& error,
                                 std::size_t bytes_transferred)> RecvHandler;
 
+  // Most frames gathered into one write
+  const size_t MAX_BATCH_FRAMES = 64;
+  // Most bytes gathered into one write
+  const size_t MAX_BATCH_BYTES = 64 * 1024;
+
+  // What to do with a subscriber that falls queue_limit frames behind
+  enum SlowConsumerPolicy {
+    // Replace its queued depth updates for a symbol with the latest,
+    // leaving a gap it fills from a snapshot, and disconnect it only if
+    // it falls twice as far behind
+    sc_conflate,
+    // Disconnect it
+    sc_disconnect
+  };
+
   class DepthFeedConnection;
 
   // Session between a publisher and one subscriber
-  class DepthFeedSession : boost::noncopyable {
+  class DepthFeedSession : boost::noncopyable,
+      public boost::enable_shared_from_this<DepthFeedSession> {
   public:
     DepthFeedSession(boost::asio::io_service& ios,
                      DepthFeedConnection* connection,
-                     QuickFAST::Codecs::TemplateRegistryPtr& templates);
+                     SlowConsumerPolicy policy,
+                     size_t queue_limit);
 
     // Is this session connected?
     bool connected() const { return connected_; }
@@ -43,48 +75,121 @@ namespace liquibook { namespace examples {
     // Get the socket for this session
     boost::asio::ip::tcp::socket& socket() { return socket_; }
 
-    // Send a trade messsage to all clients
-    void send_trade(QuickFAST::Messages::FieldSet& message);
+    // Read the client's subscriptions
+    void start_read();
+
+    // Does the client want messages for a symbol?
+    bool subscribed(book::SymbolId symbol_id) const
+    {
+      return all_symbols_ || subscriptions_.contains(symbol_id);
+    }
+
+    // Does the client want every symbol, as it does until it subscribes?
+    bool all_symbols() const { return all_symbols_; }
+
+    // The symbols the client subscribed to
+    const book::SymbolSet& subscriptions() const { return subscriptions_; }
+
+    // Add a symbol to the client's subscriptions
+    void subscribe(book::SymbolId symbol_id);
 
-    // Send an incremental update - if this client has handled this symbol
-    //   return true if handled
-    bool send_incr_update(const std::string& symbol,
-                          QuickFAST::Messages::FieldSet& message);
+    // Send a trade messsage to the client, if subscribed to the symbol
+    void send_trade(book::SymbolId symbol_id, const MessagePtr& message);
 
-    // Send a full update - if the client has not yet received for this symbol
-    void send_full_update(const std::string& symbol,
-                          QuickFAST::Messages::FieldSet& message);
+    // Send an incremental depth update, if the client is subscribed to
+    //   the symbol.  A conflating session that is behind first drops its
+    //   queued updates for the symbol.
+    void send_depth_update(book::SymbolId symbol_id,
+                           const MessagePtr& message);
   private:       
+    // A message being written, behind the session's own header
+    struct Frame {
+      unsigned char header[codec::FRAME_HEADER_SIZE];
+      MessagePtr message;
+    };
+    // A message waiting to be written, with its symbol for conflation
+    struct QueuedMessage {
+      MessagePtr message;
+      book::SymbolId symbol_id;
+    };
+    typedef std::deque<QueuedMessage> Messages;
+
+    // The frames of a batch as an asio buffer sequence.  Copies refer
+    // to the same buffers, so asio's copy does not allocate.
+    struct GatherBuffers {
+      typedef boost::asio::const_buffer value_type;
+      typedef const value_type* const_iterator;
+      const_iterator begin() const { return begin_; }
+      const_iterator end() const { return end_; }
+      const_iterator begin_;
+      const_iterator end_;
+    };
+
     bool connected_;
     uint32_t seq_num_;
+    SlowConsumerPolicy policy_;
+    size_t queue_limit_;
+    bool all_symbols_;
+    book::SymbolSet subscriptions_;
 
     boost::asio::io_service& ios_;
     boost::asio::ip::tcp::socket socket_;
     DepthFeedConnection* connection_;
-    QuickFAST::Codecs::Encoder encoder_;
 
-    typedef std::set<std::string> StringSet;
-    StringSet sent_symbols_;
+    // Messages waiting for the batch being written to finish
+    Messages queued_;
+    Frame batch_[MAX_BATCH_FRAMES];
+    size_t batch_size_;
+    boost::asio::const_buffer gather_[2 * MAX_BATCH_FRAMES];
+
+    // The client's requests
+    Buffer recv_buffer_;
+    codec::FrameReader<MAX_FRAME_SIZE> reader_;
+
+    // Queue a message, unless the session is too far behind
+    void send(book::SymbolId symbol_id, const MessagePtr& message);
 
-    static QuickFAST::template_id_t TID_TRADE_MESSAGE;
-    static QuickFAST::template_id_t TID_DEPTH_MESSAGE;
+    // Number the queued messages and write as many as a batch allows
+    void write_next();
 
-    void set_sequence_num(QuickFAST::Messages::FieldSet& message);
+    // Drop the queued, unwritten depth updates for a symbol
+    void conflate(book::SymbolId symbol_id);
 
-    void on_send(WorkingBufferPtr wb,
-                 const boost::system::error_code& error,
+    // Drop the queued frames and close the socket
+    void disconnect();
+    void close();
+
+    void on_send(const boost::system::error_code& error,
                  std::size_t bytes_transferred);
+    void on_receive(const boost::system::error_code& error,
+                    std::size_t bytes_transferred);
+    bool handle_request(const unsigned char* data);
   };
 
   typedef boost::shared_ptr<DepthFeedSession> SessionPtr;
 
-  class DepthFeedConnection : boost::noncopyable {
+  // Where the publisher sends its encoded messages
+  class FeedTransport {
   public:
-    DepthFeedConnection(int argc, const char* argv[]);
+    virtual ~FeedTransport() {}
 
-    // Get the template registry
-    const QuickFAST::Codecs::TemplateRegistryPtr&
-          get_templates() { return templates_; }
+    // Does any subscriber want messages for a symbol?  If none does,
+    //   the publisher need not encode them.
+    virtual bool wants(book::SymbolId symbol_id) const = 0;
+
+    // Send a trade messsage to all subscribers to the symbol
+    virtual void send_trade(book::SymbolId symbol_id,
+                            const MessagePtr& message) = 0;
+
+    // Send an incremental depth update to all subscribers to the symbol
+    virtual void send_depth_update(book::SymbolId symbol_id,
+                                   const MessagePtr& message) = 0;
+  };
+
+  // TCP transport, for subscribers anywhere
+  class DepthFeedConnection : public FeedTransport, boost::noncopyable {
+  public:
+    DepthFeedConnection(int argc, const char* argv[]);
 
     // Connect to publisher
     void connect();
@@ -101,23 +206,39 @@ namespace liquibook { namespace examples {
     // Set a callback to handle a reset connection
     void set_reset_handler(ResetHandler reset_handler);
 
+    // Set a callback to find the id of a symbol a client subscribes to
+    void set_symbol_resolver(SymbolResolver resolver);
+
+    // Subscribe to these symbols, rather than all, each time the
+    //   connection to the publisher is made
+    void set_subscriptions(const std::vector<std::string>& symbols);
+
     // Reserve a buffer for receiving a message
     BufferPtr reserve_recv_buffer();
 
-    // Reserve a buffer for sending a message
-    WorkingBufferPtr reserve_send_buffer();
+    // Reserve a buffer to encode a message into.  Buffers are reused
+    //   once no session holds them.
+    SendBufferPtr reserve_send_buffer();
+
+    // Is any client subscribed to a symbol?
+    virtual bool wants(book::SymbolId symbol_id) const;
+
+    // Send a trade messsage to the clients subscribed to the symbol
+    virtual void send_trade(book::SymbolId symbol_id,
+                            const MessagePtr& message);
 
-    // Send a trade messsage to all clients
-    void send_trade(QuickFAST::Messages::FieldSet& message);
+    // Send an incremental depth update to the clients subscribed to the
+    //   symbol.  Clients that join late or miss updates recover from a
+    //   snapshot.
+    virtual void send_depth_update(book::SymbolId symbol_id,
+                                   const MessagePtr& message);
 
-    // Send an incremental update
-    //   return true if all sessions could handle an incremental update
-    bool send_incr_update(const std::string& symbol, 
-                          QuickFAST::Messages::FieldSet& message);
+    // The IO service the connection runs
+    boost::asio::io_service& io_service() { return ios_; }
 
-    // Send a full update to those which have not yet received for this symbol
-    void send_full_update(const std::string& symbol, 
-                          QuickFAST::Messages::FieldSet& message);
+    // Guards the sessions and their queues, which both the publishing
+    //   thread and the IO service thread use
+    std::mutex& send_mutex() { return send_mutex_; }
 
     // Handle a connection
     void on_connect(const boost::system::error_code& error);
@@ -126,37 +247,55 @@ namespace liquibook { namespace examples {
     void on_accept(SessionPtr session,
                    const boost::system::error_code& error);
 
+    // Handle a client's subscription to a symbol
+    void on_subscribe(SessionPtr session, const std::string& symbol);
+
     // Handle a received message
     void on_receive(BufferPtr bp,
                     const boost::system::error_code& error,
                     std::size_t bytes_transferred);
-    // Handle a sent message
-    void on_send(WorkingBufferPtr wb,
-                 const boost::system::error_code& error,
-                 std::size_t bytes_transferred);
 
   private:
     typedef std::deque<BufferPtr> Buffers;
     typedef std::vector<SessionPtr> Sessions;
-    const char* template_filename_;
     const char* host_;
     int port_;
+    SlowConsumerPolicy policy_;
+    size_t queue_limit_;
     MessageHandler msg_handler_;
     ResetHandler reset_handler_;
-    QuickFAST::Codecs::TemplateRegistryPtr templates_;
-
-    Buffers        unused_recv_buffers_;
-    WorkingBuffers unused_send_buffers_;
+    SymbolResolver symbol_resolver_;
+    // The symbols any client wants, so the publisher encodes no others
+    book::SymbolSet wanted_;
+    bool all_wanted_;
+    // The symbols to subscribe to, and their requests as sent
+    std::vector<std::string> subscriptions_;
+    std::vector<unsigned char> subscribe_frames_;
+
+    Buffers     unused_recv_buffers_;
+    SendBuffers send_buffers_;
     Sessions sessions_;
+    mutable std::mutex send_mutex_;
     boost::shared_ptr<boost::asio::ip::tcp::acceptor> acceptor_;
     boost::asio::io_service ios_;
     boost::asio::ip::tcp::socket socket_;
     boost::shared_ptr<boost::asio::io_service::work> work_ptr_;
 
     void issue_read();
+    // Remove the sessions no longer connected.  With the send mutex held.
+    void remove_closed_sessions();
+    // Gather the sessions' subscriptions.  With the send mutex held.
+    void update_wanted();
+    void send_subscriptions();
+    void on_subscriptions_sent(const boost::system::error_code& error,
+                               std::size_t bytes_transferred);
   public:
-    static const char* template_file_from_args(int argc, const char* argv[]);
     static const char* host_from_args(int argc, const char* argv[]);
     static int port_from_args(int argc, const char* argv[]);
+    static int snapshot_port_from_args(int argc, const char* argv[]);
+    static SlowConsumerPolicy policy_from_args(int argc, const char* argv[]);
+    static size_t queue_limit_from_args(int argc, const char* argv[]);
+    static std::vector<std::string> subscriptions_from_args(
+        int argc, const char* argv[]);
   };
 } } // End namespace
@@ -1,22 +1,13 @@
 #include <iomanip>
 #include <fstream>
 #include "depth_feed_publisher.h"
-#include <Codecs/DataDestination.h>
-#include <Codecs/XMLTemplateParser.h>
-#include <Messages/FieldIdentity.h>
-#include <Messages/FieldSet.h>
-#include <Messages/FieldSequence.h>
-#include <Messages/FieldString.h>
-#include <Messages/FieldUInt8.h>
-#include <Messages/FieldUInt32.h>
-#include <Messages/Sequence.h>
+#include "book/timestamp.h"
 
 namespace liquibook { namespace examples { 
 
-using namespace QuickFAST::Messages;
-
 DepthFeedPublisher::DepthFeedPublisher()
-: connection_(NULL)
+: connection_(NULL),
+  seq_num_(0)
 {
 }
 
@@ -24,6 +15,13 @@ void
 DepthFeedPublisher::set_connection(DepthFeedConnection* connection)
 {
   connection_ = connection;
+  transports_.push_back(connection);
+}
+
+void
+DepthFeedPublisher::add_transport(FeedTransport* transport)
+{
+  transports_.push_back(transport);
 }
 
 void
@@ -33,14 +31,22 @@ DepthFeedPublisher::on_trade(
     book::Cost cost)
 {
   // Publish trade
-  QuickFAST::Messages::FieldSet message(20);
+  codec::Stamps stamps(order_book->arrival_time(), book::timestamp_now());
   const ExampleOrderBook* exob = 
           dynamic_cast<const ExampleOrderBook*>(order_book);
   std::cout << "Got trade for " << exob->symbol() 
             << " qty " << qty
             << " cost " << cost << std::endl;
-  build_trade_message(message, exob->symbol(), qty, cost);
-  connection_->send_trade(message);
+  // Encode nothing no subscriber wants
+  if (!wanted(exob->symbol_id())) {
+    return;
+  }
+  SendBufferPtr buffer = connection_->reserve_send_buffer();
+  stamps.encoded = book::timestamp_now();
+  buffer->size = codec::Encoder::encode_trade(
+      buffer->data, sizeof(buffer->data), ++seq_num_, stamps,
+      exob->symbol(), qty, cost);
+  send_trade(exob->symbol_id(), buffer);
 }
 
 void
@@ -49,116 +55,64 @@ DepthFeedPublisher::on_depth_change(
     const book::DepthOrderBook<OrderPtr>::DepthTracker* tracker)
 {
   // Publish changed levels of order book
-  QuickFAST::Messages::FieldSet message(20);
+  codec::Stamps stamps(order_book->depth_arrival_time(),
+                       book::timestamp_now());
   const ExampleOrderBook* exob = 
           dynamic_cast<const ExampleOrderBook*>(order_book);
-  build_depth_message(message, exob->symbol(), tracker, false);
-  if (!connection_->send_incr_update(exob->symbol(), message)) {
-    // Publish all levels of order book
-    QuickFAST::Messages::FieldSet full_message(20);
-    build_depth_message(full_message, exob->symbol(), tracker, true);
-    connection_->send_full_update(exob->symbol(), full_message);
+  if (!wanted(exob->symbol_id())) {
+    return;
   }
-}
- 
-void
-DepthFeedPublisher::build_trade_message(
-    QuickFAST::Messages::FieldSet& message,
-    const std::string& symbol,
-    book::Quantity qty,
-    book::Cost cost)
-{
-  message.addField(id_timestamp_, FieldUInt32::create(time_stamp()));
-  message.addField(id_symbol_, FieldString::create(symbol));
-  message.addField(id_qty_, FieldUInt32::create(qty));
-  message.addField(id_cost_, FieldUInt32::create(cost));
+  // Only the changed levels: subscribers fetch the rest from a snapshot
+  MessagePtr message = encode_depth_message(exob->symbol(), tracker, stamps);
+  send_depth_update(exob->symbol_id(), message);
 }
 
-void
-DepthFeedPublisher::build_depth_message(
-    QuickFAST::Messages::FieldSet& message,
+MessagePtr
+DepthFeedPublisher::encode_depth_message(
     const std::string& symbol,
     const book::DepthOrderBook<OrderPtr>::DepthTracker* tracker,
-    bool full_message)
+    const codec::Stamps& stamps)
 {
-  size_t bid_count(0), ask_count(0);
-
-  message.addField(id_timestamp_, FieldUInt32::create(time_stamp()));
-  message.addField(id_symbol_, FieldString::create(symbol));
-
-  // Build the changed levels
-  book::ChangeId last_published_change = tracker->last_published_change();
-  
-  // Build changed bids
-  {
-    SequencePtr bids(new Sequence(id_bids_length_, 1));
-    int index = 0;
-    const book::DepthLevel* bid = tracker->bids();
-    // Create sequence of bids
-    while (true) {
-      if (full_message || bid->changed_since(last_published_change)) {
-        build_depth_level(bids, bid, index);
-        ++bid_count;
-      }
-      ++index;
-      if (bid == tracker->last_bid_level()) {
-        break;
-      } else {
-        ++bid;
-      }
-    }
-    message.addField(id_bids_, FieldSequence::create(bids));
-  }
+  SendBufferPtr buffer = connection_->reserve_send_buffer();
+  codec::Stamps encoded(stamps);
+  encoded.encoded = book::timestamp_now();
+  buffer->size = codec::Encoder::encode_depth(
+      buffer->data, sizeof(buffer->data), ++seq_num_, encoded, symbol,
+      *tracker, false);
+  codec::DepthMessageView message(buffer->data);
+  std::cout << "Encoding depth message for symbol " << symbol 
+            << " with " << int(message.bid_count()) << " bids, "
+            << int(message.ask_count()) << " asks" << std::endl;
+  return buffer;
+}
 
-  // Build changed asks
-  {
-    SequencePtr asks(new Sequence(id_asks_length_, 1));
-    int index = 0;
-    const book::DepthLevel* ask = tracker->asks();
-    // Create sequence of asks
-    while (true) {
-      if (full_message || ask->changed_since(last_published_change)) {
-        build_depth_level(asks, ask, index);
-        ++ask_count;
-      }
-      ++index;
-      if (ask == tracker->last_ask_level()) {
-        break;
-      } else {
-        ++ask;
-      }
+bool
+DepthFeedPublisher::wanted(book::SymbolId symbol_id) const
+{
+  for (size_t index = 0; index < transports_.size(); ++index) {
+    if (transports_[index]->wants(symbol_id)) {
+      return true;
     }
-    message.addField(id_asks_, FieldSequence::create(asks));
   }
-  std::cout << "Encoding " << (full_message ? "full" : "incr")
-            << " depth message for symbol " << symbol 
-            << " with " << bid_count << " bids, "
-            << ask_count << " asks" << std::endl;
+  return false;
 }
 
 void
-DepthFeedPublisher::build_depth_level(
-    QuickFAST::Messages::SequencePtr& level_seq,
-    const book::DepthLevel* level,
-    int level_index)
+DepthFeedPublisher::send_trade(book::SymbolId symbol_id,
+                               const MessagePtr& message)
 {
-  FieldSetPtr level_fields(new FieldSet(4));
-  level_fields->addField(id_level_num_, FieldUInt8::create(level_index));
-  level_fields->addField(id_order_count_, 
-                         FieldUInt32::create(level->order_count()));
-  level_fields->addField(id_price_,
-                         FieldUInt32::create(level->price()));
-  level_fields->addField(id_size_,
-                         FieldUInt32::create(level->aggregate_qty()));
-  level_seq->addEntry(level_fields);
+  for (size_t index = 0; index < transports_.size(); ++index) {
+    transports_[index]->send_trade(symbol_id, message);
+  }
 }
 
-uint32_t
-DepthFeedPublisher::time_stamp()
+void
+DepthFeedPublisher::send_depth_update(book::SymbolId symbol_id,
+                                      const MessagePtr& message)
 {
-  time_t now;
-  time(&now);
-  return (uint32_t) now;
+  for (size_t index = 0; index < transports_.size(); ++index) {
+    transports_[index]->send_depth_update(symbol_id, message);
+  }
 }
 
 } } // End namespace
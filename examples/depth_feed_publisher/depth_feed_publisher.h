@@ -10,22 +10,23 @@
 #include <sstream>
 #include <vector>
 
-#include <Application/QuickFAST.h>
-#include <Codecs/TemplateRegistry_fwd.h>
 #include "example_order_book.h"
 #include "book/types.h"
 #include "depth_feed_connection.h"
-#include "template_consumer.h"
 
 namespace liquibook { namespace examples {
 
 class DepthFeedPublisher : public ExampleOrderBook::TypedDepthListener,
-                           public ExampleOrderBook::TypedTradeListener,
-                           public TemplateConsumer {
+                           public ExampleOrderBook::TypedTradeListener {
 public:
   DepthFeedPublisher();
+
+  // Encode into the connection's buffers, and send on it
   void set_connection(DepthFeedConnection* connection);
 
+  // Send on another transport as well
+  void add_transport(FeedTransport* transport);
+
   virtual void on_trade(
       const book::OrderBook<OrderPtr>* order_book,
       book::Quantity qty,
@@ -36,25 +37,21 @@ public:
       const book::DepthOrderBook<OrderPtr>::DepthTracker* tracker);
 private:
   DepthFeedConnection* connection_;
+  std::vector<FeedTransport*> transports_;
 
-  // Build an trade message
-  void build_trade_message(
-      QuickFAST::Messages::FieldSet& message,
-      const std::string& symbol,
-      book::Quantity qty,
-      book::Cost cost);
+  // Numbers every message published, on all sessions
+  uint32_t seq_num_;
 
-  // Build an incremental depth message
-  void build_depth_message(
-      QuickFAST::Messages::FieldSet& message,
+  // Encode a depth message once, for every session to send
+  MessagePtr encode_depth_message(
       const std::string& symbol,
       const book::DepthOrderBook<OrderPtr>::DepthTracker* tracker,
-      bool full_message);
-  void build_depth_level(
-      QuickFAST::Messages::SequencePtr& level_seq,
-      const book::DepthLevel* level,
-      int level_index);
-  uint32_t time_stamp();
+      const codec::Stamps& stamps);
+  // Does any transport want messages for the symbol?
+  bool wanted(book::SymbolId symbol_id) const;
+  void send_trade(book::SymbolId symbol_id, const MessagePtr& message);
+  void send_depth_update(book::SymbolId symbol_id,
+                         const MessagePtr& message);
 };
 
 } } // End namespace
@@ -1,85 +1,132 @@
 
 #include "order.h"
+#include <algorithm>
+#include <chrono>
+#include <thread>
+#include <boost/bind.hpp>
 #include <boost/scoped_ptr.hpp>
 #include "depth_feed_subscriber.h"
-#include <Codecs/DataSourceBuffer.h>
-#include <Codecs/GenericMessageBuilder.h>
-#include <Codecs/SingleMessageConsumer.h>
-#include <Messages/MessageAccessor.h>
+#include "book/timestamp.h"
 
 namespace liquibook { namespace examples {
 
-const uint64_t DepthFeedSubscriber::MSG_TYPE_DEPTH(11);
-const uint64_t DepthFeedSubscriber::MSG_TYPE_TRADE(22);
-
-using QuickFAST::ValueType;
-
-DepthFeedSubscriber::DepthFeedSubscriber(
-        const QuickFAST::Codecs::TemplateRegistryPtr& templates)
-: decoder_(templates),
-  expected_seq_(1)
+DepthFeedSubscriber::DepthFeedSubscriber()
+: expected_seq_(0),
+  read_pause_msec_(0),
+  snapshots_(NULL),
+  latency_report_at_(0)
 {
 }
 
 void
 DepthFeedSubscriber::handle_reset()
 {
-  expected_seq_ = 1;
+  expected_seq_ = 0;
+  reader_.reset();
+  // The publisher may have restarted, and its change ids with it
+  depth_map_.clear();
+}
+
+bool
+DepthFeedSubscriber::handle_message(const BufferPtr& bp,
+                                    size_t bytes_transferred)
+{
+  if (read_pause_msec_) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(read_pause_msec_));
+  }
+
+  // Decode in place from the receive buffer, except for frames split
+  // across reads
+  return reader_.read(bp->data(), bytes_transferred,
+      boost::bind(&DepthFeedSubscriber::handle_frame, this, _1));
 }
 
 bool
-DepthFeedSubscriber::handle_message(BufferPtr& bp, size_t bytes_transferred)
+DepthFeedSubscriber::handle_frame(const unsigned char* data)
 {
-  // Decode the message
-  QuickFAST::Codecs::DataSourceBuffer source(bp->c_array(), bytes_transferred);
-  QuickFAST::Codecs::SingleMessageConsumer consumer;
-  QuickFAST::Codecs::GenericMessageBuilder builder(consumer);
-  decoder_.decodeMessage(source, builder);
-  QuickFAST::Messages::Message& msg(consumer.message());
-
-  // Examine message contents
-  uint64_t seq_num, msg_type, timestamp;
-  const QuickFAST::StringBuffer* string_buffer;
-  std::string symbol;
-  if (!msg.getUnsignedInteger(id_seq_num_, ValueType::UINT32, seq_num)) {
-    std::cout << "Could not get seq num from msg" << std::endl;
+  uint64_t receive_time = book::timestamp_now();
+  // Examine frame and message contents
+  codec::FrameView frame(data);
+  if (!frame.valid()) {
+    std::cout << "ERROR: Malformed frame of length " << frame.length()
+              << std::endl;
     return false;
   }
-  if (seq_num != expected_seq_) {
+  codec::MessageView msg(frame.message());
+  uint32_t seq_num = frame.seq_num();
+  if (expected_seq_ && seq_num != expected_seq_) {
     std::cout << "ERROR: Got Seq num " << seq_num << ", expected " 
               << expected_seq_ << std::endl;
     return false;
   }
-  if (!msg.getUnsignedInteger(id_msg_type_, ValueType::UINT32, msg_type)) {
-    std::cout << "Could not get msg type from msg" << std::endl;
-    return false;
-  }
-  if (!msg.getString(id_symbol_, ValueType::ASCII, string_buffer)) {
-    std::cout << "Could not get symbol from msg" << std::endl;
-    return false;
-  }
-  if (!msg.getUnsignedInteger(id_timestamp_, ValueType::UINT32, timestamp)) {
-    std::cout << "Could not get timestamp from msg" << std::endl;
-    return false;
-  }
+  trace_latency(frame, msg, receive_time);
   bool result = false;
-  symbol = (std::string)*string_buffer;
-  switch (msg_type) {
-  case MSG_TYPE_DEPTH:
-    result = handle_depth_message(symbol, seq_num, timestamp, msg);
+  switch (msg.msg_type()) {
+  case codec::MSG_TYPE_DEPTH:
+    result = handle_depth_message(codec::DepthMessageView(frame.message()));
     break;
-  case MSG_TYPE_TRADE:
-    result = handle_trade_message(symbol, seq_num, timestamp, msg);
+  case codec::MSG_TYPE_TRADE:
+    result = handle_trade_message(codec::TradeMessageView(frame.message()));
     break;
   default:
-    std::cout << "ERROR: Unknown message type " << msg_type 
+    std::cout << "ERROR: Unknown message type " << int(msg.msg_type())
               << " seq num " << seq_num << std::endl;
     return false;
   }
-  ++expected_seq_;
+  expected_seq_ = seq_num + 1;
   return result;
 }
 
+void
+DepthFeedSubscriber::trace_latency(const codec::FrameView& frame,
+                                   const codec::MessageView& msg,
+                                   uint64_t receive_time)
+{
+  record_latency(STAGE_BOOK, msg.arrival_time(), msg.event_time());
+  record_latency(STAGE_ENCODE, msg.event_time(), msg.timestamp());
+  record_latency(STAGE_QUEUE, msg.timestamp(), frame.send_time());
+  record_latency(STAGE_TRANSPORT, frame.send_time(), receive_time);
+  record_latency(STAGE_TOTAL, msg.arrival_time(), receive_time);
+  if (!latency_report_at_) {
+    latency_report_at_ = receive_time + LATENCY_REPORT_NSEC;
+  } else if (receive_time >= latency_report_at_) {
+    report_latency();
+    latency_report_at_ = receive_time + LATENCY_REPORT_NSEC;
+  }
+}
+
+void
+DepthFeedSubscriber::record_latency(LatencyStage stage, uint64_t from,
+                                    uint64_t to)
+{
+  // A time of 0 was not taken.  The clocks of two hosts may disagree
+  //   enough to put a later time first.
+  if (from && to) {
+    latency_[stage].record(to > from ? to - from : 0);
+  }
+}
+
+void
+DepthFeedSubscriber::report_latency()
+{
+  static const char* names[STAGE_COUNT] = {
+    "book", "encode", "queue", "transport", "total"
+  };
+  for (int stage = 0; stage < STAGE_COUNT; ++stage) {
+    LatencyHistogram& histogram = latency_[stage];
+    if (!histogram.count()) {
+      continue;
+    }
+    std::cout << "Latency nsec " << names[stage]
+              << ": count " << histogram.count()
+              << " p50 " << histogram.percentile(0.5)
+              << " p99 " << histogram.percentile(0.99)
+              << " p99.9 " << histogram.percentile(0.999)
+              << " max " << histogram.max() << std::endl;
+    histogram.reset();
+  }
+}
+
 void
 DepthFeedSubscriber::log_depth(book::Depth<5>& depth)
 {
@@ -120,120 +167,129 @@ DepthFeedSubscriber::log_depth(book::Depth<5>& depth)
 }
 
 bool
-DepthFeedSubscriber::handle_depth_message(
-  const std::string& symbol,
-  uint64_t& seq_num,
-  uint64_t& timestamp,
-  QuickFAST::Messages::Message& msg)
+DepthFeedSubscriber::handle_depth_message(const codec::DepthMessageView& msg)
 {
-  size_t bids_length, asks_length;
-  std::cout << timestamp
-            << " Got depth msg " << seq_num 
+  std::string symbol = msg.symbol();
+  std::cout << msg.timestamp()
+            << " Got depth msg " << msg.seq_num() 
             << " for symbol " << symbol << std::endl;
 
-  // Create or find depth
-  std::pair<DepthMap::iterator, bool> results = depth_map_.insert(
-      std::make_pair(symbol, book::Depth<5>()));
-  book::Depth<5>& depth = results.first->second;
-
-  if (msg.getSequenceLength(id_bids_, bids_length)) {
-    for (size_t i = 0; i < bids_length; ++i) {
-      const QuickFAST::Messages::MessageAccessor* accessor;
-      if (msg.getSequenceEntry(id_bids_, i, accessor)) {
-        uint64_t level_num, price, order_count, aggregate_qty;
-        if (!accessor->getUnsignedInteger(id_level_num_, ValueType::UINT8,
-                                         level_num)) {
-          std::cout << "Could not get Bid level from depth msg" << std::endl;
-          return false;
-        }
-        if (!accessor->getUnsignedInteger(id_price_, ValueType::UINT32,
-                                         price)) {
-          std::cout << "Could not get Bid price from depth msg" << std::endl;
-          return false;
-        }
-        if (!accessor->getUnsignedInteger(id_order_count_, ValueType::UINT32,
-                                         order_count)) {
-          std::cout << "Could not get Bid count from depth msg" << std::endl;
-          return false;
-        }
-        if (!accessor->getUnsignedInteger(id_size_, ValueType::UINT32,
-                                         aggregate_qty)) {
-          std::cout << "Could not get Bid agg qty  from depth msg" << std::endl;
-          return false;
-        }
-
-        book::DepthLevel& level = depth.bids()[level_num];
-        level.set(book::Price(price), book::Quantity(aggregate_qty), uint32_t(order_count));
+  // A symbol seen for the first time starts out empty at change 0, as
+  // its book did
+  return handle_update(symbol, depth_map_[symbol], msg);
+}
 
-      } else {
-        std::cout << "Failed to get bid " << i << std::endl;
-        return false;
-      }
-      msg.endSequenceEntry(id_bids_, i, accessor);
+bool
+DepthFeedSubscriber::handle_snapshot(const codec::DepthMessageView& msg)
+{
+  std::string symbol = msg.symbol();
+  SymbolState& state = depth_map_[symbol];
+  if (!state.recovering && msg.change_id() <= state.last_change) {
+    // Caught up without it
+    return true;
+  }
+  std::cout << msg.timestamp()
+            << " Got snapshot for symbol " << symbol << " at change "
+            << msg.change_id() << " with " << state.buffered.size()
+            << " updates buffered" << std::endl;
+  if (!apply_levels(state, msg)) {
+    return false;
+  }
+  state.recovering = false;
+
+  // Splice the buffered updates on
+  std::deque<MessageBytes> buffered;
+  buffered.swap(state.buffered);
+  for (std::deque<MessageBytes>::const_iterator update = buffered.begin();
+       update != buffered.end(); ++update) {
+    if (!handle_update(symbol, state,
+                       codec::DepthMessageView(update->data()))) {
+      return false;
     }
   }
-  if (msg.getSequenceLength(id_asks_, asks_length)) {
-    for (size_t i = 0; i < asks_length; ++i) {
-      const QuickFAST::Messages::MessageAccessor* accessor;
-      if (msg.getSequenceEntry(id_asks_, i, accessor)) {
-        uint64_t level_num, price, order_count, aggregate_qty;
-        if (!accessor->getUnsignedInteger(id_level_num_, ValueType::UINT8,
-                                         level_num)) {
-          std::cout << "Could not get Ask level from depth msg " << std::endl;
-          return false;
-        }
-        if (!accessor->getUnsignedInteger(id_price_, ValueType::UINT32,
-                                         price)) {
-          std::cout << "Could not get Ask price  from depth msg" << std::endl;
-          return false;
-        }
-        if (!accessor->getUnsignedInteger(id_order_count_, ValueType::UINT32,
-                                         order_count)) {
-          std::cout << "Could not get Ask count from depth msg " << std::endl;
-          return false;
-        }
-        if (!accessor->getUnsignedInteger(id_size_, ValueType::UINT32,
-                                         aggregate_qty)) {
-          std::cout << "Could not get Ask agg qty from depth msg " << std::endl;
-          return false;
-        }
-
-        book::DepthLevel& level = depth.asks()[level_num];
-        level.set(book::Price(price), book::Quantity(aggregate_qty), uint32_t(order_count));
+  log_depth(state.depth);
+  return true;
+}
 
-      } else {
-        std::cout << "Failed to get ask " << i << std::endl;
+bool
+DepthFeedSubscriber::handle_update(const std::string& symbol,
+                                   SymbolState& state,
+                                   const codec::DepthMessageView& msg)
+{
+  if (!state.recovering) {
+    if (msg.change_id() <= state.last_change) {
+      // Already in the snapshot
+      return true;
+    }
+    if (msg.prev_change_id() == state.last_change) {
+      if (!apply_levels(state, msg)) {
         return false;
       }
-      msg.endSequenceEntry(id_asks_, i, accessor);
+      log_depth(state.depth);
+      return true;
+    }
+    // Joined late, or updates were dropped while this subscriber was slow
+    if (!snapshots_) {
+      std::cout << "ERROR: Gap in " << symbol << " after change "
+                << state.last_change << std::endl;
+      return false;
     }
+    std::cout << "Gap in " << symbol << ": change " << msg.prev_change_id()
+              << " follows " << state.last_change
+              << ", requesting snapshot" << std::endl;
+    state.recovering = true;
+    snapshots_->request(symbol);
   }
-  log_depth(depth);
+  // Keep the update until the snapshot arrives
+  if (state.buffered.size() == MAX_BUFFERED_UPDATES) {
+    state.buffered.pop_front();
+  }
+  state.buffered.push_back(
+      MessageBytes(msg.data(), msg.data() + msg.length()));
   return true;
 }
 
 bool
-DepthFeedSubscriber::handle_trade_message(
-  const std::string& symbol,
-  uint64_t& seq_num,
-  uint64_t& timestamp,
-  QuickFAST::Messages::Message& msg)
+DepthFeedSubscriber::apply_levels(SymbolState& state,
+                                  const codec::DepthMessageView& msg)
 {
-  uint64_t qty, cost;
-  // Get trade fields
-  if (!msg.getUnsignedInteger(id_qty_, ValueType::UINT32, qty)) {
-    std::cout << "Could not qty from trade msg" << std::endl;
-    return false;
+  book::Depth<5>& depth = state.depth;
+  for (size_t i = 0; i < msg.bid_count(); ++i) {
+    codec::LevelView bid = msg.bid(i);
+    if (bid.level_num() >= 5) {
+      std::cout << "Bad Bid level " << int(bid.level_num())
+                << " in depth msg" << std::endl;
+      return false;
+    }
+    book::DepthLevel& level = depth.bids()[bid.level_num()];
+    level.set(book::Price(bid.price()), book::Quantity(bid.qty()),
+              bid.order_count());
   }
-  if (!msg.getUnsignedInteger(id_cost_, ValueType::UINT32, cost)) {
-    std::cout << "Could not get cost from trade msg" << std::endl;
-    return false;
+  for (size_t i = 0; i < msg.ask_count(); ++i) {
+    codec::LevelView ask = msg.ask(i);
+    if (ask.level_num() >= 5) {
+      std::cout << "Bad Ask level " << int(ask.level_num())
+                << " in depth msg" << std::endl;
+      return false;
+    }
+    book::DepthLevel& level = depth.asks()[ask.level_num()];
+    level.set(book::Price(ask.price()), book::Quantity(ask.qty()),
+              ask.order_count());
   }
+  state.last_change = msg.change_id();
+  return true;
+}
+
+bool
+DepthFeedSubscriber::handle_trade_message(const codec::TradeMessageView& msg)
+{
+  uint64_t qty = msg.qty();
+  uint64_t cost = msg.cost();
 
   double price = (double) cost / (qty * Order::precision_);
-  std::cout << timestamp
-            << " Got trade msg " << seq_num 
-            << " for symbol " << symbol 
+  std::cout << msg.timestamp()
+            << " Got trade msg " << msg.seq_num() 
+            << " for symbol " << msg.symbol() 
             << ": " << qty << "@" << price
             << std::endl;
 
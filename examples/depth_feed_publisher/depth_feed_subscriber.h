@@ -4,50 +4,101 @@
 #include <boost/shared_ptr.hpp>
 #include <stdexcept>
 #include <cstring>
+#include <deque>
+#include <map>
 #include <sstream>
 #include <vector>
-#include <Application/QuickFAST.h>
-#include <Codecs/Decoder.h>
 
-#include "template_consumer.h"
+#include "depth_feed_codec.h"
 #include "depth_feed_connection.h"
+#include "snapshot_client.h"
+#include "latency_histogram.h"
 #include "book/depth.h"
 
-namespace QuickFAST { namespace Messages {
-  class Message;
-} }
-
 namespace liquibook { namespace examples {
 
-  class DepthFeedSubscriber : public TemplateConsumer {
+  class DepthFeedSubscriber {
   public:
-    DepthFeedSubscriber(
-        const QuickFAST::Codecs::TemplateRegistryPtr& templates);
+    DepthFeedSubscriber();
 
     // Handle a reset of the connection
     void handle_reset();
 
-    // Handle a message
+    // Pause before handling each read, to act as a slow subscriber
+    void set_read_pause(int msec) { read_pause_msec_ = msec; }
+
+    // Fetch snapshots from this client, to fill a gap in the updates
+    //   of a symbol
+    void set_snapshot_client(SnapshotClient* client) { snapshots_ = client; }
+
+    // Handle the messages in a received buffer
+    // return false if failure
+    bool handle_message(const BufferPtr& bp, size_t bytes_transferred);
+
+    // Handle one complete frame
     // return false if failure
-    bool handle_message(BufferPtr& bp, size_t bytes_transferred);
+    bool handle_frame(const unsigned char* data);
+
+    // Handle a snapshot, then the updates buffered while waiting for it
+    // return false if failure
+    bool handle_snapshot(const codec::DepthMessageView& msg);
 
   private:
-    QuickFAST::Codecs::Decoder decoder_;
-    typedef std::map<std::string, book::Depth<5> > DepthMap;
+    // Most updates buffered for a symbol while waiting for a snapshot.
+    //   Beyond that the oldest are dropped, and if the snapshot turns
+    //   out to be older than what remains, another is fetched.
+    static const size_t MAX_BUFFERED_UPDATES = 1024;
+
+    typedef std::vector<unsigned char> MessageBytes;
+    struct SymbolState {
+      SymbolState() : last_change(0), recovering(false) {}
+      book::Depth<5> depth;
+      // The book change the depth reflects
+      book::ChangeId last_change;
+      // Waiting for a snapshot
+      bool recovering;
+      std::deque<MessageBytes> buffered;
+    };
+    typedef std::map<std::string, SymbolState> DepthMap;
     DepthMap depth_map_;
+    // The next frame's sequence number, or 0 for a new stream
     uint64_t expected_seq_;
+    int read_pause_msec_;
+    SnapshotClient* snapshots_;
+    codec::FrameReader<MAX_FRAME_SIZE> reader_;
 
-    static const uint64_t MSG_TYPE_DEPTH;
-    static const uint64_t MSG_TYPE_TRADE;
+    // Stages of a message's trip, from its order's arrival at the book
+    enum LatencyStage {
+      STAGE_BOOK,        // arrival to the publisher hearing of the event
+      STAGE_ENCODE,      // event to encoded
+      STAGE_QUEUE,       // encoded to sent
+      STAGE_TRANSPORT,   // sent to received
+      STAGE_TOTAL,       // arrival to received
+      STAGE_COUNT
+    };
+    // How often the latencies are reported, by receive time
+    static const uint64_t LATENCY_REPORT_NSEC = 5000000000ull;
+
+    LatencyHistogram latency_[STAGE_COUNT];
+    uint64_t latency_report_at_;
+
+    // Record the latencies a feed message's times show, and report them
+    //   now and again
+    void trace_latency(const codec::FrameView& frame,
+                       const codec::MessageView& msg,
+                       uint64_t receive_time);
+    void record_latency(LatencyStage stage, uint64_t from, uint64_t to);
+    void report_latency();
 
     void log_depth(book::Depth<5>& depth);
-    bool handle_trade_message(const std::string& symbol,
-                              uint64_t& seq_num,
-                              uint64_t& timestamp,
-                              QuickFAST::Messages::Message& msg);
-    bool handle_depth_message(const std::string& symbol,
-                              uint64_t& seq_num,
-                              uint64_t& timestamp,
-                              QuickFAST::Messages::Message& msg);
+    bool handle_trade_message(const codec::TradeMessageView& msg);
+    bool handle_depth_message(const codec::DepthMessageView& msg);
+    // Apply an update that follows the depth, ignore one the depth
+    //   already reflects, or else buffer it until a snapshot arrives
+    bool handle_update(const std::string& symbol, SymbolState& state,
+                       const codec::DepthMessageView& msg);
+    bool apply_levels(SymbolState& state,
+                      const codec::DepthMessageView& msg);
   };
 } }
+
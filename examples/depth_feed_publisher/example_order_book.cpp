@@ -3,8 +3,13 @@
 namespace liquibook { namespace examples {
 
 ExampleOrderBook::ExampleOrderBook(const std::string& symbol)
-: symbol_(symbol)
+: symbol_(symbol),
+  symbol_id_(book::INVALID_SYMBOL_ID)
 {
+  // Nothing here handles rejects or stop orders, so only build the
+  // callbacks the depth needs, plus the fills behind the trade feed.
+  set_callback_interest(depth_callback_interest() |
+                        TypedCallback::ci_order_fill);
 }
 
 const std::string&
@@ -13,5 +18,17 @@ ExampleOrderBook::symbol() const
   return symbol_;
 }
 
+book::SymbolId
+ExampleOrderBook::symbol_id() const
+{
+  return symbol_id_;
+}
+
+void
+ExampleOrderBook::set_symbol_id(book::SymbolId symbol_id)
+{
+  symbol_id_ = symbol_id;
+}
+
 } } // End namespace
 
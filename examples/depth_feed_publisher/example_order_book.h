@@ -3,6 +3,7 @@
 
 #include "order.h"
 #include "book/depth_order_book.h"
+#include "book/symbol_directory.h"
 #include <boost/shared_ptr.hpp>
 
 namespace liquibook { namespace examples {
@@ -14,8 +15,13 @@ public:
   ExampleOrderBook(const std::string& symbol);
   const std::string& symbol() const;
 
+  // The symbol's id in the exchange
+  book::SymbolId symbol_id() const;
+  void set_symbol_id(book::SymbolId symbol_id);
+
 private:
   std::string symbol_;
+  book::SymbolId symbol_id_;
 };
 
 } } // End namespace
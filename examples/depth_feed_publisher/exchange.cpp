@@ -5,27 +5,81 @@ namespace liquibook { namespace examples {
 Exchange::Exchange(ExampleOrderBook::TypedDepthListener* depth_listener,
                    ExampleOrderBook::TypedTradeListener* trade_listener)
 : depth_listener_(depth_listener),
-  trade_listener_(trade_listener)
+  trade_listener_(trade_listener),
+  depth_mirror_(nullptr),
+  depth_conflator_(nullptr)
 {
 }
 
 void
+Exchange::set_depth_mirror(DepthMirror* mirror)
+{
+  depth_mirror_ = mirror;
+}
+
+void
+Exchange::set_depth_conflator(book::DepthConflator* conflator)
+{
+  depth_conflator_ = conflator;
+}
+
+book::SymbolId
 Exchange::add_order_book(const std::string& sym)
 {
-  std::pair<OrderBookMap::iterator, bool> result;
-  result = order_books_.insert(std::make_pair(sym, ExampleOrderBook(sym)));
-  result.first->second.set_depth_listener(depth_listener_);
-  result.first->second.set_trade_listener(trade_listener_);
+  // Adding a book may move the others, so let none be waiting in the
+  // conflator
+  if (depth_conflator_) {
+    depth_conflator_->flush();
+  }
+  book::SymbolId id = order_books_.add(sym, ExampleOrderBook(sym));
+  if (id == book::INVALID_SYMBOL_ID) {
+    return order_books_.find(sym);
+  }
+  ExampleOrderBook& order_book = order_books_.book(id);
+  order_book.set_symbol_id(id);
+  order_book.set_depth_listener(depth_listener_);
+  order_book.set_trade_listener(trade_listener_);
+  // Feed messages carry when their orders arrived
+  order_book.set_arrival_stamps(true);
+  DepthSlot* slot;
+  if (depth_mirror_) {
+    slot = depth_mirror_->add_book(sym);
+  } else {
+    own_depth_slots_.emplace_back();
+    slot = &own_depth_slots_.back();
+  }
+  order_book.set_depth_slot(slot);
+  depth_slots_.push_back(slot);
+  if (depth_conflator_) {
+    order_book.set_depth_conflator(depth_conflator_);
+  }
+  return id;
 }
 
 void
-Exchange::add_order(const std::string& symbol, OrderPtr& order)
+Exchange::add_order(book::SymbolId symbol_id, OrderPtr& order)
+{
+  if (order_books_.contains(symbol_id)) {
+    ExampleOrderBook& order_book = order_books_.book(symbol_id);
+    order_book.add(order);
+    order_book.perform_callbacks();
+  }
+}
+
+book::SymbolId
+Exchange::find_symbol(const std::string& sym) const
+{
+  return order_books_.find(sym);
+}
+
+const Exchange::DepthSlot*
+Exchange::depth_slot(const std::string& sym) const
 {
-  OrderBookMap::iterator order_book = order_books_.find(symbol);
-  if (order_book != order_books_.end()) {
-    order_book->second.add(order);
-    order_book->second.perform_callbacks();
+  book::SymbolId id = order_books_.find(sym);
+  if (id == book::INVALID_SYMBOL_ID) {
+    return nullptr;
   }
+  return depth_slots_[id];
 }
 
 } } // End namespace
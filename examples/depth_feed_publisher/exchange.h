@@ -3,28 +3,59 @@
 
 #include "order.h"
 #include "example_order_book.h"
+#include "book/symbol_directory.h"
+#include "book/shm_depth_mirror.h"
+#include "book/depth_conflator.h"
 
+#include <deque>
 #include <string>
-#include <map>
+#include <vector>
 #include <boost/shared_ptr.hpp>
 
 namespace liquibook { namespace examples {
 
 class Exchange {
 public:
+  typedef book::ShmDepthMirror<> DepthMirror;
+  typedef ExampleOrderBook::DepthSlot DepthSlot;
+
   Exchange(ExampleOrderBook::TypedDepthListener* depth_listener,
            ExampleOrderBook::TypedTradeListener* trade_listener);
 
-  // Permanently add an order book to the exchange
-  void add_order_book(const std::string& symbol);
+  // Mirror the depth of order books added from now on into shared
+  // memory, for readers in other processes
+  void set_depth_mirror(DepthMirror* mirror);
+
+  // Hold the depth changes of order books added from now on until the
+  // conflator flushes
+  void set_depth_conflator(book::DepthConflator* conflator);
+
+  // Permanently add an order book to the exchange.  Returns the symbol's
+  // id, by which orders are routed to the book.
+  book::SymbolId add_order_book(const std::string& symbol);
+
+  // The id of a symbol, or INVALID_SYMBOL_ID for an unknown symbol.
+  //   Safe to call from any thread once the books are added.
+  book::SymbolId find_symbol(const std::string& symbol) const;
 
   // Handle an incoming order
-  void add_order(const std::string& symbol, OrderPtr& order);
+  void add_order(book::SymbolId symbol_id, OrderPtr& order);
+
+  // The depth of a symbol's book, copied after each published change,
+  //   or nullptr for an unknown symbol.  Safe to read from any thread
+  //   once the books are added.
+  const DepthSlot* depth_slot(const std::string& symbol) const;
 private:
-  typedef std::map<std::string, ExampleOrderBook> OrderBookMap;
+  typedef book::SymbolDirectory<ExampleOrderBook> OrderBookMap;
   OrderBookMap order_books_;
   ExampleOrderBook::TypedDepthListener* depth_listener_;
   ExampleOrderBook::TypedTradeListener* trade_listener_;
+  DepthMirror* depth_mirror_;
+  book::DepthConflator* depth_conflator_;
+  // Every book publishes its depth to a slot, in shared memory when
+  //   mirrored or else here.  A deque never moves its slots.
+  std::deque<DepthSlot> own_depth_slots_;
+  std::vector<const DepthSlot*> depth_slots_;
 };
 
 } }
@@ -0,0 +1,87 @@
+#pragma once
+
+#include <boost/cstdint.hpp>
+#include <cstring>
+
+namespace liquibook { namespace examples {
+
+// Counts latencies in nanoseconds, with no allocation, for percentiles.
+//   Each power of two range is split into 8 buckets, so a percentile is
+//   reported to within an eighth of its value.
+class LatencyHistogram {
+public:
+  LatencyHistogram() { reset(); }
+
+  void record(uint64_t nsec)
+  {
+    ++counts_[bucket(nsec)];
+    ++count_;
+    if (nsec > max_) {
+      max_ = nsec;
+    }
+  }
+
+  // The latency no more than fraction (0 to 1) of those recorded exceed,
+  //   rounded up to the top of its bucket.  0 if none are recorded.
+  uint64_t percentile(double fraction) const
+  {
+    uint64_t wanted = uint64_t(fraction * count_ + 0.5);
+    if (wanted == 0) {
+      wanted = 1;
+    }
+    uint64_t seen = 0;
+    for (size_t index = 0; index < BUCKETS; ++index) {
+      seen += counts_[index];
+      if (seen >= wanted) {
+        uint64_t top = bucket_top(index);
+        return top < max_ ? top : max_;
+      }
+    }
+    return max_;
+  }
+
+  uint64_t count() const { return count_; }
+  uint64_t max() const { return max_; }
+
+  void reset()
+  {
+    memset(counts_, 0, sizeof(counts_));
+    count_ = 0;
+    max_ = 0;
+  }
+
+private:
+  static const size_t SUB_BUCKETS = 8;
+  static const size_t BUCKETS = 62 * SUB_BUCKETS;
+
+  // Values below 8 each have a bucket; above, the top 3 bits after the
+  //   highest pick one of the 8 in its power of two
+  static size_t bucket(uint64_t nsec)
+  {
+    if (nsec < SUB_BUCKETS) {
+      return size_t(nsec);
+    }
+    int high = 3;
+    while (nsec >> (high + 1)) {
+      ++high;
+    }
+    size_t sub = size_t(nsec >> (high - 3)) & (SUB_BUCKETS - 1);
+    return size_t(high - 2) * SUB_BUCKETS + sub;
+  }
+
+  static uint64_t bucket_top(size_t index)
+  {
+    if (index < SUB_BUCKETS) {
+      return index;
+    }
+    int high = int(index / SUB_BUCKETS) + 2;
+    uint64_t width = uint64_t(1) << (high - 3);
+    return (SUB_BUCKETS + index % SUB_BUCKETS) * width + width - 1;
+  }
+
+  uint64_t counts_[BUCKETS];
+  uint64_t count_;
+  uint64_t max_;
+};
+
+} }
@@ -1,20 +1,30 @@
 
+#include <boost/bind.hpp>
 #include <boost/thread.hpp>
 #include "exchange.h"
 #include "depth_feed_publisher.h"
 #include "depth_feed_connection.h"
+#include "shm_feed_transport.h"
+#include "snapshot_server.h"
 #include "order.h"
 
+#include <algorithm>
+#include <chrono>
 #include <cstdlib>
+#include <cstring>
 #include <iostream>
+#include <memory>
+#include <thread>
 
 using namespace liquibook;
 
 struct SecurityInfo {
   std::string symbol;
+  book::SymbolId symbol_id;
   double ref_price;
   SecurityInfo(const char* sym, double price)
   : symbol(sym),
+    symbol_id(book::INVALID_SYMBOL_ID),
     ref_price(price)
   {
   }
@@ -24,9 +34,17 @@ typedef std::vector<SecurityInfo> SecurityVector;
 
 void create_securities(SecurityVector& securities);
 void populate_exchange(examples::Exchange& exchange, 
-                       const SecurityVector& securities);
+                       SecurityVector& securities);
 void generate_orders(examples::Exchange& exchange, 
-                     const SecurityVector& securities);
+                     const SecurityVector& securities,
+                     int interval_msec,
+                     book::DepthConflator* conflator);
+void wait_for_next_order(int interval_msec,
+                         book::DepthConflator* conflator);
+const char* mirror_name_from_args(int argc, const char* argv[]);
+const char* ring_name_from_args(int argc, const char* argv[]);
+int interval_from_args(int argc, const char* argv[]);
+int flush_interval_from_args(int argc, const char* argv[]);
 
 int main(int argc, const char* argv[])
 {
@@ -35,16 +53,20 @@ int main(int argc, const char* argv[])
     // Feed connection
     examples::DepthFeedConnection connection(argc, argv);
 
-    // Open connection in background thread
-    connection.accept();
-    boost::function<void ()> acceptor(
-        boost::bind(&examples::DepthFeedConnection::run, &connection));
-    boost::thread acceptor_thread(acceptor);
-  
     // Create feed publisher
     examples::DepthFeedPublisher feed;
     feed.set_connection(&connection);
 
+    // Optionally publish into a shared memory ring too, for subscribers
+    // on this host
+    std::unique_ptr<examples::ShmFeedTransport> ring;
+    const char* ring_name = ring_name_from_args(argc, argv);
+    if (ring_name) {
+      ring.reset(new examples::ShmFeedTransport(
+          ring_name, examples::DEFAULT_RING_CAPACITY));
+      feed.add_transport(ring.get());
+    }
+
     // Create exchange
     examples::Exchange exchange(&feed, &feed);
 
@@ -52,11 +74,45 @@ int main(int argc, const char* argv[])
     SecurityVector securities;
     create_securities(securities);
 
+    // Optionally mirror the depth into shared memory
+    std::unique_ptr<examples::Exchange::DepthMirror> mirror;
+    const char* mirror_name = mirror_name_from_args(argc, argv);
+    if (mirror_name) {
+      mirror.reset(examples::Exchange::DepthMirror::create(
+          mirror_name, uint32_t(securities.size())));
+      exchange.set_depth_mirror(mirror.get());
+    }
+
+    // Optionally publish each book's depth at most once per flush interval
+    std::unique_ptr<book::DepthConflator> conflator;
+    int flush_msec = flush_interval_from_args(argc, argv);
+    if (flush_msec > 0) {
+      conflator.reset(new book::DepthConflator(
+          0, std::chrono::milliseconds(flush_msec)));
+      exchange.set_depth_conflator(conflator.get());
+    }
+
     // Populate exchange with securities
     populate_exchange(exchange, securities);
+
+    // Open connection in background thread, now subscribers' symbols
+    // can be found
+    connection.set_symbol_resolver(
+        boost::bind(&examples::Exchange::find_symbol, &exchange, _1));
+    connection.accept();
+    boost::function<void ()> acceptor(
+        boost::bind(&examples::DepthFeedConnection::run, &connection));
+    boost::thread acceptor_thread(acceptor);
+
+    // Serve snapshots, for subscribers that join late or miss updates
+    examples::SnapshotServer snapshot_server(
+        exchange,
+        examples::DepthFeedConnection::snapshot_port_from_args(argc, argv));
+    snapshot_server.start();
   
     // Generate random orders
-    generate_orders(exchange, securities);
+    generate_orders(exchange, securities, interval_from_args(argc, argv),
+                    conflator.get());
   }
   catch (const std::exception & ex)
   {
@@ -172,15 +228,16 @@ create_securities(SecurityVector& securities) {
 }
 
 void
-populate_exchange(examples::Exchange& exchange, const SecurityVector& securities) {
-  SecurityVector::const_iterator sec;
+populate_exchange(examples::Exchange& exchange, SecurityVector& securities) {
+  SecurityVector::iterator sec;
   for (sec = securities.begin(); sec != securities.end(); ++sec) {
-    exchange.add_order_book(sec->symbol);
+    sec->symbol_id = exchange.add_order_book(sec->symbol);
   }
 }
 
 void
-generate_orders(examples::Exchange& exchange, const SecurityVector& securities) {
+generate_orders(examples::Exchange& exchange, const SecurityVector& securities,
+                int interval_msec, book::DepthConflator* conflator) {
   time_t now;
   time(&now);
   std::srand(uint32_t(now));
@@ -206,9 +263,89 @@ generate_orders(examples::Exchange& exchange, const SecurityVector& securities)
     examples::OrderPtr order(new examples::Order(is_buy, price, qty));
 
     // add order
-    exchange.add_order(sec.symbol, order);
+    exchange.add_order(sec.symbol_id, order);
 
     // Wait for eyes to read
-    sleep(1);
+    wait_for_next_order(interval_msec, conflator);
+  }
+}
+
+void
+wait_for_next_order(int interval_msec, book::DepthConflator* conflator)
+{
+  typedef book::DepthConflator::Clock Clock;
+  Clock::time_point next_order =
+      Clock::now() + std::chrono::milliseconds(interval_msec);
+  if (!conflator || conflator->flush_interval() == Clock::duration()) {
+    std::this_thread::sleep_until(next_order);
+    return;
   }
+  // The books belong to this thread, so the conflator is polled here
+  // rather than from the connection's thread.  Waking once per flush
+  // interval publishes the last change before a quiet spell on time.
+  while (true) {
+    conflator->poll();
+    Clock::time_point now = Clock::now();
+    if (now >= next_order) {
+      break;
+    }
+    std::this_thread::sleep_until(
+        std::min(next_order, now + conflator->flush_interval()));
+  }
+}
+
+const char*
+mirror_name_from_args(int argc, const char* argv[])
+{
+  bool next_is_name = false;
+  for (int i = 0; i < argc; ++i) {
+    if (next_is_name) {
+      return argv[i];
+    } else if (strcmp(argv[i], "-m") == 0) {
+      next_is_name = true;
+    }
+  }
+  return nullptr;
+}
+
+const char*
+ring_name_from_args(int argc, const char* argv[])
+{
+  bool next_is_name = false;
+  for (int i = 0; i < argc; ++i) {
+    if (next_is_name) {
+      return argv[i];
+    } else if (strcmp(argv[i], "-l") == 0) {
+      next_is_name = true;
+    }
+  }
+  return nullptr;
+}
+
+int
+interval_from_args(int argc, const char* argv[])
+{
+  bool next_is_interval = false;
+  for (int i = 0; i < argc; ++i) {
+    if (next_is_interval) {
+      return atoi(argv[i]);
+    } else if (strcmp(argv[i], "-i") == 0) {
+      next_is_interval = true;
+    }
+  }
+  return 1000;
+}
+
+int
+flush_interval_from_args(int argc, const char* argv[])
+{
+  bool next_is_interval = false;
+  for (int i = 0; i < argc; ++i) {
+    if (next_is_interval) {
+      return atoi(argv[i]);
+    } else if (strcmp(argv[i], "-f") == 0) {
+      next_is_interval = true;
+    }
+  }
+  return 0;
 }
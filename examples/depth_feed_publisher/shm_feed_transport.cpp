@@ -0,0 +1,87 @@
+#include "shm_feed_transport.h"
+#include "book/timestamp.h"
+#include <cstring>
+#include <iostream>
+
+namespace liquibook { namespace examples {
+
+ShmFeedTransport::ShmFeedTransport(const std::string& name, size_t capacity)
+: name_(name),
+  ring_(book::ShmBroadcastRing::create(name, capacity)),
+  seq_num_(0)
+{
+}
+
+ShmFeedTransport::~ShmFeedTransport()
+{
+  book::ShmBroadcastRing::remove(name_);
+}
+
+void
+ShmFeedTransport::send_trade(book::SymbolId symbol_id,
+                             const MessagePtr& message)
+{
+  send(message);
+}
+
+void
+ShmFeedTransport::send_depth_update(book::SymbolId symbol_id,
+                                    const MessagePtr& message)
+{
+  send(message);
+}
+
+void
+ShmFeedTransport::send(const MessagePtr& message)
+{
+  // Frames are numbered for the ring, as a session numbers its own
+  codec::Encoder::encode_frame_header(frame_, message->size, ++seq_num_,
+                                      book::timestamp_now());
+  memcpy(frame_ + codec::FRAME_HEADER_SIZE, message->data, message->size);
+  ring_->write(frame_, codec::FRAME_HEADER_SIZE + message->size);
+}
+
+ShmFeedReceiver::ShmFeedReceiver(const std::string& name)
+: ring_(book::ShmBroadcastRing::open(name)),
+  reader_(*ring_),
+  overruns_(0),
+  frame_(ring_->max_record() / 8 + 1)
+{
+}
+
+void
+ShmFeedReceiver::set_frame_handler(FrameHandler handler)
+{
+  frame_handler_ = handler;
+}
+
+void
+ShmFeedReceiver::set_reset_handler(ResetHandler handler)
+{
+  reset_handler_ = handler;
+}
+
+size_t
+ShmFeedReceiver::poll()
+{
+  size_t handled = 0;
+  const unsigned char* frame =
+      reinterpret_cast<const unsigned char*>(&frame_[0]);
+  while (size_t size = reader_.receive(&frame_[0])) {
+    if (reader_.overruns() != overruns_) {
+      overruns_ = reader_.overruns();
+      std::cout << "Fell behind the feed ring, frames lost" << std::endl;
+      reset_handler_();
+    }
+    ++handled;
+    if (size < codec::FRAME_HEADER_SIZE + codec::HEADER_SIZE ||
+        size != codec::FrameView(frame).length() ||
+        !frame_handler_(frame)) {
+      std::cout << "Bad frame from the feed ring" << std::endl;
+      reset_handler_();
+    }
+  }
+  return handled;
+}
+
+} } // End namespace
@@ -0,0 +1,74 @@
+#pragma once
+
+#include "depth_feed_connection.h"
+#include "book/shm_broadcast_ring.h"
+#include <boost/function.hpp>
+#include <boost/noncopyable.hpp>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace liquibook { namespace examples {
+
+  // Ring size the publisher creates unless told otherwise
+  const size_t DEFAULT_RING_CAPACITY = 1 << 20;
+
+  typedef boost::function<bool (const unsigned char* frame)> FrameHandler;
+
+  // Shared memory transport, for subscribers on the publisher's host.
+  //   Every frame goes once into a broadcast ring, which any number of
+  //   subscribers read without system calls.  The publisher never waits
+  //   for them: a subscriber a whole ring behind loses frames, and
+  //   recovers the depth from snapshots.
+  class ShmFeedTransport : public FeedTransport, boost::noncopyable {
+  public:
+    // Create the ring, replacing any of the same name
+    ShmFeedTransport(const std::string& name, size_t capacity);
+
+    // Remove the ring's name
+    virtual ~ShmFeedTransport();
+
+    // Readers of the ring are not known, so every symbol is wanted
+    virtual bool wants(book::SymbolId symbol_id) const { return true; }
+
+    virtual void send_trade(book::SymbolId symbol_id,
+                            const MessagePtr& message);
+    virtual void send_depth_update(book::SymbolId symbol_id,
+                                   const MessagePtr& message);
+  private:
+    std::string name_;
+    std::unique_ptr<book::ShmBroadcastRing> ring_;
+    uint32_t seq_num_;
+    unsigned char frame_[MAX_FRAME_SIZE];
+
+    void send(const MessagePtr& message);
+  };
+
+  // Reads the frames a ShmFeedTransport publishes
+  class ShmFeedReceiver : boost::noncopyable {
+  public:
+    explicit ShmFeedReceiver(const std::string& name);
+
+    // Set a callback to handle a frame
+    //   return false if failure
+    void set_frame_handler(FrameHandler frame_handler);
+
+    // Set a callback to handle a break in the frames: some were lost,
+    //   or a handler failed
+    void set_reset_handler(ResetHandler reset_handler);
+
+    // Handle the frames waiting, without waiting for more.  Returns the
+    //   number handled.
+    size_t poll();
+
+  private:
+    std::unique_ptr<book::ShmBroadcastRing> ring_;
+    book::ShmBroadcastRing::Reader reader_;
+    FrameHandler frame_handler_;
+    ResetHandler reset_handler_;
+    uint64_t overruns_;
+    // Frames are copied out of the ring, whole words at a time, into
+    //   room for the largest record the ring allows
+    std::vector<uint64_t> frame_;
+  };
+} } // End namespace
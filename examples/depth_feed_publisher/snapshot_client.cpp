@@ -0,0 +1,178 @@
+#include "snapshot_client.h"
+#include "book/timestamp.h"
+#include <boost/bind.hpp>
+#include <iostream>
+
+using namespace boost::asio::ip;
+
+namespace liquibook { namespace examples {
+
+SnapshotClient::SnapshotClient(boost::asio::io_service& ios,
+                               const char* host, int port)
+: host_(host),
+  port_(port),
+  socket_(ios),
+  retry_timer_(ios),
+  connecting_(false),
+  connected_(false),
+  writing_(false),
+  seq_num_(0),
+  expected_seq_(1)
+{
+}
+
+void
+SnapshotClient::set_snapshot_handler(SnapshotHandler handler)
+{
+  snapshot_handler_ = handler;
+}
+
+void
+SnapshotClient::request(const std::string& symbol)
+{
+  if (!requested_.insert(symbol).second) {
+    return;
+  }
+  unsent_.push_back(symbol);
+  if (connected_) {
+    write_next();
+  } else if (!connecting_) {
+    connect();
+  }
+}
+
+void
+SnapshotClient::connect()
+{
+  std::cout << "Connecting to snapshot server" << std::endl;
+  connecting_ = true;
+  tcp::endpoint endpoint(address::from_string(host_), port_);
+  socket_.async_connect(endpoint,
+                        boost::bind(&SnapshotClient::on_connect, this, _1));
+}
+
+void
+SnapshotClient::on_connect(const boost::system::error_code& error)
+{
+  connecting_ = false;
+  if (error) {
+    std::cout << "Snapshot connect error=" << error << std::endl;
+    retry();
+    return;
+  }
+  connected_ = true;
+  seq_num_ = 0;
+  expected_seq_ = 1;
+  reader_.reset();
+  // Ask again for everything unanswered
+  unsent_.assign(requested_.begin(), requested_.end());
+  issue_read();
+  write_next();
+}
+
+void
+SnapshotClient::write_next()
+{
+  if (writing_ || unsent_.empty()) {
+    return;
+  }
+  size_t size = codec::Encoder::encode_snapshot_request(
+      request_ + codec::FRAME_HEADER_SIZE, codec::HEADER_SIZE, seq_num_ + 1,
+      codec::Stamps(0, 0, book::timestamp_now()), unsent_.front());
+  codec::Encoder::encode_frame_header(request_, size, ++seq_num_,
+                                      book::timestamp_now());
+  unsent_.pop_front();
+  writing_ = true;
+  boost::asio::async_write(
+      socket_, boost::asio::buffer(request_, codec::FRAME_HEADER_SIZE + size),
+      boost::bind(&SnapshotClient::on_send, this, _1, _2));
+}
+
+void
+SnapshotClient::on_send(const boost::system::error_code& error,
+                        std::size_t bytes_transferred)
+{
+  if (error == boost::asio::error::operation_aborted) {
+    return;
+  }
+  writing_ = false;
+  if (error) {
+    std::cout << "Error " << error << " sending snapshot request"
+              << std::endl;
+    retry();
+  } else {
+    write_next();
+  }
+}
+
+void
+SnapshotClient::issue_read()
+{
+  socket_.async_receive(
+      boost::asio::buffer(recv_buffer_),
+      boost::bind(&SnapshotClient::on_receive, this, _1, _2));
+}
+
+void
+SnapshotClient::on_receive(const boost::system::error_code& error,
+                           std::size_t bytes_transferred)
+{
+  if (error == boost::asio::error::operation_aborted) {
+    return;
+  }
+  if (error) {
+    std::cout << "Error " << error << " receiving snapshot" << std::endl;
+    retry();
+  } else if (!reader_.read(recv_buffer_.data(), bytes_transferred,
+                 boost::bind(&SnapshotClient::decode_frame, this, _1))) {
+    retry();
+  } else {
+    issue_read();
+  }
+}
+
+bool
+SnapshotClient::decode_frame(const unsigned char* data)
+{
+  codec::FrameView frame(data);
+  if (!frame.valid()) {
+    std::cout << "ERROR: Malformed snapshot frame of length "
+              << frame.length() << std::endl;
+    return false;
+  }
+  if (frame.seq_num() != expected_seq_) {
+    std::cout << "ERROR: Got snapshot seq num " << frame.seq_num()
+              << ", expected " << expected_seq_ << std::endl;
+    return false;
+  }
+  ++expected_seq_;
+  codec::DepthMessageView msg(frame.message());
+  if (msg.msg_type() != codec::MSG_TYPE_DEPTH || !msg.snapshot()) {
+    std::cout << "ERROR: Unexpected message type " << int(msg.msg_type())
+              << " from snapshot server" << std::endl;
+    return false;
+  }
+  requested_.erase(msg.symbol());
+  return snapshot_handler_(msg);
+}
+
+void
+SnapshotClient::retry()
+{
+  connected_ = false;
+  writing_ = false;
+  boost::system::error_code ec;
+  socket_.close(ec);
+  retry_timer_.expires_from_now(boost::posix_time::seconds(1));
+  retry_timer_.async_wait(boost::bind(&SnapshotClient::on_retry, this, _1));
+}
+
+void
+SnapshotClient::on_retry(const boost::system::error_code& error)
+{
+  if (!error && !connecting_ && !connected_) {
+    connect();
+  }
+}
+
+} } // End namespace
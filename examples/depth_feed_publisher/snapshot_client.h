@@ -0,0 +1,71 @@
+#pragma once
+
+#include "asio_safe_include.h"
+#include "depth_feed_codec.h"
+#include "depth_feed_connection.h"
+#include <boost/function.hpp>
+#include <boost/noncopyable.hpp>
+#include <deque>
+#include <set>
+#include <string>
+
+namespace liquibook { namespace examples {
+
+  typedef boost::function<bool (const codec::DepthMessageView&)>
+      SnapshotHandler;
+
+  // Fetches depth snapshots from a SnapshotServer, on the IO service of
+  //   the feed connection.  Connects when first asked for a snapshot,
+  //   and reconnects after an error, asking again for every snapshot
+  //   not yet answered.
+  class SnapshotClient : boost::noncopyable {
+  public:
+    SnapshotClient(boost::asio::io_service& ios, const char* host, int port);
+
+    // Set a callback to handle a snapshot
+    //   return false to drop the connection
+    void set_snapshot_handler(SnapshotHandler handler);
+
+    // Ask for a snapshot of a symbol, unless one is already asked for
+    void request(const std::string& symbol);
+
+  private:
+    typedef std::set<std::string> StringSet;
+    typedef std::deque<std::string> Symbols;
+
+    const char* host_;
+    int port_;
+    SnapshotHandler snapshot_handler_;
+    boost::asio::ip::tcp::socket socket_;
+    boost::asio::deadline_timer retry_timer_;
+    bool connecting_;
+    bool connected_;
+    bool writing_;
+    uint32_t seq_num_;
+    uint32_t expected_seq_;
+
+    // Symbols asked for and not yet answered, and those of them not
+    //   yet sent on this connection
+    StringSet requested_;
+    Symbols unsent_;
+
+    unsigned char request_[codec::FRAME_HEADER_SIZE + codec::HEADER_SIZE];
+    Buffer recv_buffer_;
+    codec::FrameReader<MAX_FRAME_SIZE> reader_;
+
+    void connect();
+    void write_next();
+    void issue_read();
+    bool decode_frame(const unsigned char* data);
+
+    // Drop the connection and try again shortly
+    void retry();
+
+    void on_connect(const boost::system::error_code& error);
+    void on_send(const boost::system::error_code& error,
+                 std::size_t bytes_transferred);
+    void on_receive(const boost::system::error_code& error,
+                    std::size_t bytes_transferred);
+    void on_retry(const boost::system::error_code& error);
+  };
+} } // End namespace
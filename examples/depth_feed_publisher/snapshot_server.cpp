@@ -0,0 +1,112 @@
+#include "snapshot_server.h"
+#include "depth_feed_connection.h"
+#include "book/timestamp.h"
+#include <boost/bind.hpp>
+#include <boost/thread.hpp>
+#include <iostream>
+
+using namespace boost::asio::ip;
+
+namespace liquibook { namespace examples {
+
+SnapshotServer::SnapshotServer(const Exchange& exchange, int port)
+: exchange_(exchange),
+  port_(port)
+{
+}
+
+void
+SnapshotServer::start()
+{
+  boost::thread accept_thread(
+      boost::bind(&SnapshotServer::accept_loop, this));
+  accept_thread.detach();
+}
+
+void
+SnapshotServer::accept_loop()
+{
+  try {
+    tcp::acceptor acceptor(ios_);
+    tcp::endpoint endpoint(tcp::v4(), port_);
+    acceptor.open(endpoint.protocol());
+    acceptor.set_option(boost::asio::socket_base::reuse_address(true));
+    acceptor.bind(endpoint);
+    acceptor.listen();
+    while (true) {
+      SocketPtr socket(new tcp::socket(ios_));
+      acceptor.accept(*socket);
+      std::cout << "accepted snapshot client connection" << std::endl;
+      boost::thread serve_thread(
+          boost::bind(&SnapshotServer::serve, this, socket));
+      serve_thread.detach();
+    }
+  } catch (const std::exception& ex) {
+    std::cerr << "Snapshot server stopped: " << ex.what() << std::endl;
+  }
+}
+
+void
+SnapshotServer::serve(SocketPtr socket)
+{
+  // Requests are small, and a subscriber waits for each answer, so
+  // blocking reads and writes keep this simple
+  codec::FrameReader<MAX_FRAME_SIZE> reader;
+  unsigned char data[1024];
+  uint32_t seq_num = 0;
+  boost::system::error_code error;
+  while (true) {
+    size_t bytes_read = socket->read_some(boost::asio::buffer(data), error);
+    if (error) {
+      break;
+    }
+    bool ok = reader.read(data, bytes_read,
+        boost::bind(&SnapshotServer::answer, this, boost::ref(*socket),
+                    boost::ref(seq_num), _1));
+    if (!ok) {
+      std::cout << "Dropping snapshot client after a bad request"
+                << std::endl;
+      break;
+    }
+  }
+  socket->close(error);
+}
+
+bool
+SnapshotServer::answer(tcp::socket& socket, uint32_t& seq_num,
+                       const unsigned char* request)
+{
+  codec::FrameView frame(request);
+  codec::MessageView msg(frame.message());
+  if (!frame.valid() ||
+      msg.msg_type() != codec::MSG_TYPE_SNAPSHOT_REQUEST) {
+    return false;
+  }
+  std::string symbol = msg.symbol();
+  const Exchange::DepthSlot* slot = exchange_.depth_slot(symbol);
+  if (!slot) {
+    std::cout << "Snapshot requested for unknown symbol " << symbol
+              << std::endl;
+    return true;
+  }
+
+  // A consistent copy, however busy the book
+  Exchange::DepthSlot::Snapshot levels;
+  slot->read(levels);
+
+  // The answer echoes the request's sequence number
+  unsigned char reply[MAX_FRAME_SIZE];
+  size_t size = codec::Encoder::encode_snapshot(
+      reply + codec::FRAME_HEADER_SIZE, MAX_MESSAGE_SIZE, msg.seq_num(),
+      codec::Stamps(0, 0, book::timestamp_now()), symbol, levels);
+  codec::Encoder::encode_frame_header(reply, size, ++seq_num,
+                                      book::timestamp_now());
+  std::cout << "Sending snapshot of " << symbol << " at change "
+            << levels.change_id << std::endl;
+  boost::system::error_code error;
+  boost::asio::write(socket,
+      boost::asio::buffer(reply, codec::FRAME_HEADER_SIZE + size), error);
+  return !error;
+}
+
+} } // End namespace
@@ -0,0 +1,37 @@
+#pragma once
+
+#include "asio_safe_include.h"
+#include "exchange.h"
+#include <boost/noncopyable.hpp>
+#include <boost/shared_ptr.hpp>
+
+namespace liquibook { namespace examples {
+
+  // Serves full depth snapshots of single symbols on a port of its own.
+  //   Snapshots are copied from the exchange's depth slots, so building
+  //   them never touches the thread matching orders.  Each snapshot
+  //   carries the id of the last change it reflects, which a subscriber
+  //   uses to splice it into the incremental feed.
+  class SnapshotServer : boost::noncopyable {
+  public:
+    SnapshotServer(const Exchange& exchange, int port);
+
+    // Accept subscribers on a background thread, serving each on a
+    //   thread of its own.  Add the exchange's books first.
+    void start();
+
+  private:
+    typedef boost::shared_ptr<boost::asio::ip::tcp::socket> SocketPtr;
+
+    const Exchange& exchange_;
+    int port_;
+    boost::asio::io_service ios_;
+
+    void accept_loop();
+    void serve(SocketPtr socket);
+
+    // Answer one request frame.  Returns false to drop the subscriber.
+    bool answer(boost::asio::ip::tcp::socket& socket, uint32_t& seq_num,
+                const unsigned char* request);
+  };
+} } // End namespace
@@ -1,7 +1,17 @@
-
 #include <boost/bind.hpp>
 #include "depth_feed_connection.h"
 #include "depth_feed_subscriber.h"
+#include "shm_feed_transport.h"
+#include "snapshot_client.h"
+#include <cstdlib>
+#include <cstring>
+#include <thread>
+
+int read_pause_from_args(int argc, const char* argv[]);
+const char* ring_name_from_args(int argc, const char* argv[]);
+void read_ring(const char* ring_name,
+               liquibook::examples::DepthFeedSubscriber& feed,
+               boost::asio::io_service& ios);
 
 int main(int argc, const char* argv[])
 {
@@ -10,8 +20,33 @@ int main(int argc, const char* argv[])
     // Create the connection
     liquibook::examples::DepthFeedConnection connection(argc, argv);
 
+    // Subscribe to some symbols, or else all
+    connection.set_subscriptions(
+        liquibook::examples::DepthFeedConnection::subscriptions_from_args(
+            argc, argv));
+
     // Create feed subscriber
-    liquibook::examples::DepthFeedSubscriber feed(connection.get_templates());
+    liquibook::examples::DepthFeedSubscriber feed;
+    feed.set_read_pause(read_pause_from_args(argc, argv));
+
+    // Fetch snapshots to fill gaps, on the connection's IO service
+    liquibook::examples::SnapshotClient snapshots(
+        connection.io_service(),
+        liquibook::examples::DepthFeedConnection::host_from_args(argc, argv),
+        liquibook::examples::DepthFeedConnection::snapshot_port_from_args(
+            argc, argv));
+    liquibook::examples::SnapshotHandler snapshot_handler =
+        boost::bind(&liquibook::examples::DepthFeedSubscriber::handle_snapshot,
+                    &feed, _1);
+    snapshots.set_snapshot_handler(snapshot_handler);
+    feed.set_snapshot_client(&snapshots);
+
+    // Read the feed from shared memory, if the publisher is on this host
+    const char* ring_name = ring_name_from_args(argc, argv);
+    if (ring_name) {
+      read_ring(ring_name, feed, connection.io_service());
+      return 0;
+    }
 
     // Set up handlers
     liquibook::examples::MessageHandler msg_handler =
@@ -34,3 +69,56 @@ int main(int argc, const char* argv[])
   }
   return 0;
 }
+
+void
+read_ring(const char* ring_name,
+          liquibook::examples::DepthFeedSubscriber& feed,
+          boost::asio::io_service& ios)
+{
+  liquibook::examples::ShmFeedReceiver receiver(ring_name);
+  receiver.set_frame_handler(
+      boost::bind(&liquibook::examples::DepthFeedSubscriber::handle_frame,
+                  &feed, _1));
+  receiver.set_reset_handler(
+      boost::bind(&liquibook::examples::DepthFeedSubscriber::handle_reset,
+                  &feed));
+  std::cout << "Reading feed ring " << ring_name << std::endl;
+
+  // Spin on the ring.  Only when it is idle, see to the snapshot
+  // connection and let others run.
+  boost::asio::io_service::work work(ios);
+  while (true) {
+    if (!receiver.poll()) {
+      ios.poll();
+      std::this_thread::yield();
+    }
+  }
+}
+
+int
+read_pause_from_args(int argc, const char* argv[])
+{
+  bool next_is_pause = false;
+  for (int i = 0; i < argc; ++i) {
+    if (next_is_pause) {
+      return atoi(argv[i]);
+    } else if (strcmp(argv[i], "-w") == 0) {
+      next_is_pause = true;
+    }
+  }
+  return 0;
+}
+
+const char*
+ring_name_from_args(int argc, const char* argv[])
+{
+  bool next_is_name = false;
+  for (int i = 0; i < argc; ++i) {
+    if (next_is_name) {
+      return argv[i];
+    } else if (strcmp(argv[i], "-l") == 0) {
+      next_is_name = true;
+    }
+  }
+  return nullptr;
+}
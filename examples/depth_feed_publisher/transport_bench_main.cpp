@@ -0,0 +1,211 @@
+#include "depth_feed_connection.h"
+#include "shm_feed_transport.h"
+#include "book/depth.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+#include <boost/bind.hpp>
+
+using namespace liquibook;
+using namespace liquibook::examples;
+
+typedef std::chrono::steady_clock Clock;
+
+// Latency and throughput of the depth feed's transports on one host:
+//   the TCP connection over loopback, and the shared memory ring.
+//   transport_bench [frames] [-p port]
+//
+// Each transport first sends frames one at a time, waiting for each to
+// arrive, to time a frame's trip.  Then it sends them back to back to
+// measure throughput, keeping no more than a window of them in flight so
+// neither the session queue limit nor the ring's size comes into it.
+
+namespace {
+
+// Most frames sent and not yet received, when sending back to back
+const uint64_t WINDOW = 256;
+
+uint64_t now_nsec()
+{
+  return uint64_t(std::chrono::duration_cast<std::chrono::nanoseconds>(
+      Clock::now().time_since_epoch()).count());
+}
+
+// What the reading side saw
+struct Received {
+  Received() : frames(0), sent_at(0), last_at(0), resets(0) {}
+
+  bool on_frame(const unsigned char* frame)
+  {
+    uint64_t now = now_nsec();
+    uint64_t sent = sent_at.load(std::memory_order_acquire);
+    if (sent) {
+      trip_nsec.push_back(now - sent);
+    }
+    last_at.store(now, std::memory_order_relaxed);
+    frames.fetch_add(1, std::memory_order_release);
+    return true;
+  }
+
+  void on_reset() { ++resets; }
+
+  std::atomic<uint64_t> frames;
+  // When the one frame in flight was sent, or 0 when sending back to back
+  std::atomic<uint64_t> sent_at;
+  std::atomic<uint64_t> last_at;
+  uint64_t resets;
+  std::vector<uint64_t> trip_nsec;
+};
+
+void wait_for(const Received& received, uint64_t frames)
+{
+  while (received.frames.load(std::memory_order_acquire) < frames) {
+    std::this_thread::yield();
+  }
+}
+
+void report(const char* transport, Received& received, size_t frames,
+            uint64_t burst_nsec)
+{
+  std::vector<uint64_t>& trips = received.trip_nsec;
+  std::sort(trips.begin(), trips.end());
+  std::cout << transport << ": " << trips.size() << " frames one at a time,"
+            << " trip nsec p50 " << trips[trips.size() / 2]
+            << " p99 " << trips[trips.size() * 99 / 100]
+            << " max " << trips.back() << std::endl;
+  double seconds = burst_nsec / 1e9;
+  std::cout << transport << ": " << frames << " frames back to back in "
+            << seconds << " sec, " << (frames / seconds) << " frames/sec"
+            << std::endl;
+}
+
+// Send frames one at a time, then back to back, through a transport
+// whose reader counts into received
+void run(const char* name, FeedTransport& transport,
+         const MessagePtr& message, Received& received, size_t frames)
+{
+  // Until the reader is there, frames go nowhere
+  while (!received.frames.load(std::memory_order_acquire)) {
+    transport.send_trade(0, message);
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+  }
+  // Let the stragglers arrive
+  std::this_thread::sleep_for(std::chrono::milliseconds(50));
+
+  uint64_t base = received.frames.load(std::memory_order_acquire);
+  for (size_t frame = 1; frame <= frames; ++frame) {
+    received.sent_at.store(now_nsec(), std::memory_order_release);
+    transport.send_trade(0, message);
+    wait_for(received, base + frame);
+  }
+  received.sent_at.store(0, std::memory_order_release);
+
+  base = received.frames.load(std::memory_order_acquire);
+  uint64_t start = now_nsec();
+  for (size_t frame = 0; frame < frames; ++frame) {
+    if (frame >= WINDOW) {
+      wait_for(received, base + frame - WINDOW);
+    }
+    transport.send_trade(0, message);
+  }
+  wait_for(received, base + frames);
+  report(name, received, frames, received.last_at.load() - start);
+}
+
+// Read the ring until told to stop
+void read_ring(ShmFeedReceiver* receiver, const std::atomic<bool>* stop)
+{
+  while (!stop->load(std::memory_order_relaxed)) {
+    if (!receiver->poll()) {
+      std::this_thread::yield();
+    }
+  }
+}
+
+// Read the TCP feed until the connection closes
+void read_socket(boost::asio::ip::tcp::socket* socket, Received* received)
+{
+  codec::FrameReader<MAX_FRAME_SIZE> reader;
+  unsigned char data[64 * 1024];
+  boost::system::error_code error;
+  while (true) {
+    size_t bytes = socket->read_some(boost::asio::buffer(data), error);
+    if (error ||
+        !reader.read(data, bytes,
+                     boost::bind(&Received::on_frame, received, _1))) {
+      break;
+    }
+  }
+}
+
+} // namespace
+
+int main(int argc, const char* argv[])
+{
+  size_t frames = 100000;
+  if (argc > 1 && argv[1][0] != '-') {
+    frames = size_t(atol(argv[1]));
+  }
+  try
+  {
+    // A typical message: five levels a side
+    book::Depth<5> depth;
+    for (int level = 0; level < 5; ++level) {
+      depth.add_order(1250 - level, 100 * (level + 1), true);
+      depth.add_order(1251 + level, 200 * (level + 1), false);
+    }
+
+    // TCP, through the publisher's own sessions and a blocking reader
+    DepthFeedConnection connection(argc, argv);
+    connection.accept();
+    std::thread io_thread(boost::bind(&DepthFeedConnection::run,
+                                      &connection));
+    SendBufferPtr buffer = connection.reserve_send_buffer();
+    buffer->size = codec::Encoder::encode_depth(
+        buffer->data, sizeof(buffer->data), 1, codec::Stamps(), "AAPL", depth, true);
+    MessagePtr message(buffer);
+
+    Received tcp_received;
+    boost::asio::io_service ios;
+    boost::asio::ip::tcp::socket socket(ios);
+    socket.connect(boost::asio::ip::tcp::endpoint(
+        boost::asio::ip::address::from_string("127.0.0.1"),
+        DepthFeedConnection::port_from_args(argc, argv)));
+    socket.set_option(boost::asio::ip::tcp::no_delay(true));
+    std::thread tcp_reader(read_socket, &socket, &tcp_received);
+    run("tcp", connection, message, tcp_received, frames);
+    socket.shutdown(boost::asio::ip::tcp::socket::shutdown_both);
+    tcp_reader.join();
+    connection.io_service().stop();
+    io_thread.join();
+
+    // The shared memory ring
+    std::string name = "/liquibook_bench_" + std::to_string(getpid());
+    ShmFeedTransport ring(name, DEFAULT_RING_CAPACITY);
+    ShmFeedReceiver receiver(name);
+    Received shm_received;
+    receiver.set_frame_handler(
+        boost::bind(&Received::on_frame, &shm_received, _1));
+    receiver.set_reset_handler(
+        boost::bind(&Received::on_reset, &shm_received));
+    std::atomic<bool> stop(false);
+    std::thread shm_reader(read_ring, &receiver, &stop);
+    run("shm", ring, message, shm_received, frames);
+    stop = true;
+    shm_reader.join();
+    std::cout << "shm: reader fell behind " << shm_received.resets
+              << " times" << std::endl;
+  }
+  catch (const std::exception & ex)
+  {
+    std::cerr << "Exception caught at main level: " << ex.what() << std::endl;
+    return -1;
+  }
+  return 0;
+}
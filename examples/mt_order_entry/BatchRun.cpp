@@ -0,0 +1,273 @@
+// Copyright (c) 2017 Object Computing, Inc.
+// All rights reserved.
+// See the file license.txt for licensing information.
+#include "BatchRun.h"
+#include "BinaryCommand.h"
+#include "Market.h"
+
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <iostream>
+#include <random>
+#include <vector>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace
+{
+typedef std::chrono::steady_clock Clock;
+
+/// @brief A file's contents, read only.  Mapped where mmap is available,
+/// otherwise read into memory.
+class CommandFile
+{
+public:
+    CommandFile()
+    : data_(nullptr)
+    , size_(0)
+    {
+    }
+
+    ~CommandFile()
+    {
+#ifndef _WIN32
+        if(data_ && size_)
+        {
+            munmap(const_cast<unsigned char *>(data_), size_);
+        }
+#endif
+    }
+
+    bool open(const std::string & filename)
+    {
+#ifndef _WIN32
+        int fd = ::open(filename.c_str(), O_RDONLY);
+        if(fd < 0)
+        {
+            return false;
+        }
+        struct stat status;
+        bool ok = fstat(fd, &status) == 0;
+        size_ = ok ? size_t(status.st_size) : 0;
+        if(ok && size_)
+        {
+            int flags = MAP_PRIVATE;
+#ifdef MAP_POPULATE
+            // Fault the pages in now rather than in the timed loop
+            flags |= MAP_POPULATE;
+#endif
+            void * region = mmap(nullptr, size_, PROT_READ, flags, fd, 0);
+            ok = region != MAP_FAILED;
+            if(ok)
+            {
+                data_ = static_cast<const unsigned char *>(region);
+            }
+        }
+        close(fd);
+        return ok;
+#else
+        std::ifstream file(filename, std::ios::binary);
+        if(!file.good())
+        {
+            return false;
+        }
+        contents_.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+        data_ = reinterpret_cast<const unsigned char *>(contents_.data());
+        size_ = contents_.size();
+        return true;
+#endif
+    }
+
+    const unsigned char * data() const { return data_; }
+    size_t size() const { return size_; }
+
+private:
+    CommandFile(const CommandFile &);
+    CommandFile & operator =(const CommandFile &);
+
+    const unsigned char * data_;
+    size_t size_;
+#ifdef _WIN32
+    std::string contents_;
+#endif
+};
+
+/// @brief Latencies of one type of command, in nanoseconds
+struct Latencies
+{
+    const char * name;
+    std::vector<uint32_t> nsec;
+
+    uint32_t percentile(double fraction) const
+    {
+        return nsec[std::min(nsec.size() - 1, size_t(fraction * nsec.size()))];
+    }
+};
+
+const size_t COMMAND_TYPES = orderentry::CMD_MODIFY + 1;
+}
+
+namespace orderentry
+{
+
+int runBatch(const std::string & filename)
+{
+    CommandFile file;
+    if(!file.open(filename))
+    {
+        std::cerr << "Can't read command file " << filename << ". Exiting." << std::endl;
+        return -1;
+    }
+    if(file.size() % COMMAND_SIZE != 0)
+    {
+        std::cerr << filename << " is not a binary command file. Exiting." << std::endl;
+        return -1;
+    }
+    size_t commands = file.size() / COMMAND_SIZE;
+
+    Latencies latencies[COMMAND_TYPES];
+    latencies[CMD_BOOK].name = "book";
+    latencies[CMD_BUY].name = "buy";
+    latencies[CMD_SELL].name = "sell";
+    latencies[CMD_CANCEL].name = "cancel";
+    latencies[CMD_MODIFY].name = "modify";
+    for(size_t type = CMD_BOOK; type < COMMAND_TYPES; ++type)
+    {
+        latencies[type].nsec.reserve(commands);
+    }
+
+    // Nothing is logged, so the time is Liquibook's and the market's own
+    Market market(nullptr);
+    size_t failed = 0;
+    const unsigned char * command = file.data();
+    Clock::time_point start = Clock::now();
+    Clock::time_point before = start;
+    for(size_t index = 0; index < commands; ++index, command += COMMAND_SIZE)
+    {
+        CommandView view(command);
+        if(!market.apply(view))
+        {
+            ++failed;
+        }
+        Clock::time_point after = Clock::now();
+        if(view.type() >= CMD_BOOK && view.type() < COMMAND_TYPES)
+        {
+            int64_t nsec = std::chrono::duration_cast<std::chrono::nanoseconds>(after - before).count();
+            latencies[view.type()].nsec.push_back(uint32_t(std::min<int64_t>(nsec, UINT32_MAX)));
+        }
+        before = after;
+    }
+    double seconds = std::chrono::duration<double>(before - start).count();
+
+    std::cout << "Applied " << commands << " commands in " << seconds << " seconds: "
+        << uint64_t(commands / seconds) << " commands per second" << std::endl;
+    if(failed)
+    {
+        std::cout << failed << " commands named an unknown book or order, or were malformed" << std::endl;
+    }
+    std::cout << "Latency in nanoseconds:" << std::endl;
+    for(size_t type = CMD_BOOK; type < COMMAND_TYPES; ++type)
+    {
+        Latencies & latency = latencies[type];
+        if(latency.nsec.empty())
+        {
+            continue;
+        }
+        std::sort(latency.nsec.begin(), latency.nsec.end());
+        std::cout << '\t' << latency.name
+            << ": count " << latency.nsec.size()
+            << " p50 " << latency.percentile(0.5)
+            << " p90 " << latency.percentile(0.9)
+            << " p99 " << latency.percentile(0.99)
+            << " p99.9 " << latency.percentile(0.999)
+            << " max " << latency.nsec.back() << std::endl;
+    }
+    return 0;
+}
+
+int generateBatch(const std::string & filename, size_t commands, size_t symbols)
+{
+    std::ofstream file(filename, std::ios::binary | std::ios::trunc);
+    if(!file.good() || symbols == 0)
+    {
+        std::cerr << "Can't write command file " << filename << ". Exiting." << std::endl;
+        return -1;
+    }
+
+    std::mt19937 random(12345);
+    unsigned char command[COMMAND_SIZE];
+    std::vector<liquibook::book::Price> prices;
+    for(size_t symbol = 0; symbol < symbols; ++symbol)
+    {
+        CommandWriter::book(command, "SYM" + std::to_string(symbol), true);
+        file.write(reinterpret_cast<const char *>(command), COMMAND_SIZE);
+        prices.push_back(liquibook::book::Price(1000 + 100 * (symbol % 90)));
+    }
+
+    // Mostly orders near the price, the rest cancels and modifies of
+    // recent orders, which may already have traded away
+    std::vector<liquibook::book::SymbolId> orderSymbols;
+    for(size_t index = 0; index < commands; ++index)
+    {
+        uint32_t action = random() % 100;
+        uint32_t orders = uint32_t(orderSymbols.size());
+        if(action < 65 || orders == 0)
+        {
+            liquibook::book::SymbolId symbolId = random() % symbols;
+            bool buy = random() % 2 == 0;
+            liquibook::book::Quantity quantity = (random() % 10 + 1) * 100;
+            liquibook::book::Price price = prices[symbolId] + random() % 21 - 10;
+            uint8_t flags = 0;
+            uint32_t kind = random() % 100;
+            if(kind < 5)
+            {
+                price = liquibook::book::MARKET_ORDER_PRICE;
+            }
+            else if(kind < 8)
+            {
+                flags = FLAG_AON;
+            }
+            else if(kind < 11)
+            {
+                flags = FLAG_IOC;
+            }
+            CommandWriter::order(command, buy, symbolId, quantity, price, 0, flags);
+            orderSymbols.push_back(symbolId);
+        }
+        else
+        {
+            uint32_t recent = std::min<uint32_t>(orders, 1000);
+            uint32_t orderId = orders - random() % recent;
+            if(action < 90)
+            {
+                CommandWriter::cancel(command, orderId);
+            }
+            else if(random() % 2)
+            {
+                CommandWriter::modify(command, orderId, int32_t(random() % 5) * 100 - 200,
+                    liquibook::book::PRICE_UNCHANGED);
+            }
+            else
+            {
+                CommandWriter::modify(command, orderId, 0,
+                    prices[orderSymbols[orderId - 1]] + random() % 21 - 10);
+            }
+        }
+        file.write(reinterpret_cast<const char *>(command), COMMAND_SIZE);
+    }
+    if(!file.good())
+    {
+        std::cerr << "Error writing command file " << filename << std::endl;
+        return -1;
+    }
+    std::cout << "Wrote " << symbols << " books and " << commands << " commands to " << filename << std::endl;
+    return 0;
+}
+
+}
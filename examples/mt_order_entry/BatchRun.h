@@ -0,0 +1,26 @@
+// Copyright (c) 2017 Object Computing, Inc.
+// All rights reserved.
+// See the file license.txt for licensing information.
+
+/// @brief Batch runs of binary command files
+#pragma once
+#include <string>
+
+namespace orderentry
+{
+/// @brief Map a file of binary commands and apply them to a market as fast
+/// as it will take them, logging nothing.  Reports the throughput and the
+/// latency of each type of command.
+/// @param filename the command file, as written by generateBatch.
+/// @returns 0 on success or -1 if the file cannot be read.
+int runBatch(const std::string & filename);
+
+/// @brief Write a file of binary commands: a depth book per symbol, then a
+/// random mix of limit, market, AON and IOC orders, cancels and modifies
+/// around a price for each symbol.  The same arguments give the same file.
+/// @param filename the file to write.
+/// @param commands how many order, cancel and modify commands to write.
+/// @param symbols how many books to spread them over.
+/// @returns 0 on success or -1 if the file cannot be written.
+int generateBatch(const std::string & filename, size_t commands, size_t symbols);
+}
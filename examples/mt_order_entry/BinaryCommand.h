@@ -0,0 +1,150 @@
+// Copyright (c) 2017 Object Computing, Inc.
+// All rights reserved.
+// See the file license.txt for licensing information.
+
+/// @brief Fixed size binary commands for batch runs
+#pragma once
+#include <book/types.h>
+#include <book/symbol_directory.h>
+
+#include <cstring>
+#include <stdexcept>
+#include <string>
+
+namespace orderentry
+{
+/// Every command is a record of COMMAND_SIZE bytes, little endian, so a
+/// file of them can be mapped and applied in place with no parsing:
+///
+///    0 uint8    command type
+///    1 uint8    flags: FLAG_AON and FLAG_IOC for orders, FLAG_DEPTH_BOOK
+///               for books
+///    2 uint16   reserved
+///    4 uint32   symbol id: books are numbered from 0 in the order the
+///               file adds them
+///    8 uint32   order id for cancel and modify.  Orders are numbered
+///               from 1 in the order the file adds them, as when typed.
+///   12 uint32   quantity, or for modify the signed change in quantity
+///   16 uint32   price, 0 for market; for modify PRICE_UNCHANGED keeps it
+///   20 uint32   stop price, 0 for none
+///
+/// A book command carries its symbol, null padded, from offset 8.
+enum CommandType
+{
+    CMD_BOOK = 1,
+    CMD_BUY = 2,
+    CMD_SELL = 3,
+    CMD_CANCEL = 4,
+    CMD_MODIFY = 5
+};
+
+static const uint8_t FLAG_AON = 1;
+static const uint8_t FLAG_IOC = 2;
+static const uint8_t FLAG_DEPTH_BOOK = 4;
+
+static const size_t COMMAND_SIZE = 24;
+static const size_t COMMAND_SYMBOL_SIZE = 16;
+
+/// @brief Read only view of a command, in place.
+class CommandView
+{
+public:
+    explicit CommandView(const unsigned char * data)
+    : data_(data)
+    {
+    }
+
+    uint8_t type() const { return data_[0]; }
+    uint8_t flags() const { return data_[1]; }
+    liquibook::book::SymbolId symbolId() const { return get32(4); }
+    uint32_t orderId() const { return get32(8); }
+    liquibook::book::Quantity quantity() const { return get32(12); }
+    int32_t quantityChange() const { return int32_t(get32(12)); }
+    liquibook::book::Price price() const { return get32(16); }
+    liquibook::book::Price stopPrice() const { return get32(20); }
+
+    /// @brief the symbol of a book command
+    std::string symbol() const
+    {
+        const char * symbol = reinterpret_cast<const char *>(data_ + 8);
+        size_t length = 0;
+        while(length < COMMAND_SYMBOL_SIZE && symbol[length])
+        {
+            ++length;
+        }
+        return std::string(symbol, length);
+    }
+
+private:
+    uint32_t get32(size_t offset) const
+    {
+        const unsigned char * at = data_ + offset;
+        return uint32_t(at[0]) | (uint32_t(at[1]) << 8)
+            | (uint32_t(at[2]) << 16) | (uint32_t(at[3]) << 24);
+    }
+
+    const unsigned char * data_;
+};
+
+/// @brief Writes commands into a caller's buffer of COMMAND_SIZE bytes.
+class CommandWriter
+{
+public:
+    static void book(unsigned char * data, const std::string & symbol, bool depthBook)
+    {
+        if(symbol.empty() || symbol.size() > COMMAND_SYMBOL_SIZE)
+        {
+            throw std::runtime_error("Bad symbol for a binary command: " + symbol);
+        }
+        header(data, CMD_BOOK, depthBook ? FLAG_DEPTH_BOOK : 0, 0);
+        memcpy(data + 8, symbol.data(), symbol.size());
+    }
+
+    static void order(unsigned char * data, bool buy,
+        liquibook::book::SymbolId symbolId,
+        liquibook::book::Quantity quantity,
+        liquibook::book::Price price,
+        liquibook::book::Price stopPrice = 0,
+        uint8_t flags = 0)
+    {
+        header(data, buy ? CMD_BUY : CMD_SELL, flags, symbolId);
+        put32(data + 12, uint32_t(quantity));
+        put32(data + 16, uint32_t(price));
+        put32(data + 20, uint32_t(stopPrice));
+    }
+
+    static void cancel(unsigned char * data, uint32_t orderId)
+    {
+        header(data, CMD_CANCEL, 0, 0);
+        put32(data + 8, orderId);
+    }
+
+    static void modify(unsigned char * data, uint32_t orderId,
+        int32_t quantityChange, liquibook::book::Price price)
+    {
+        header(data, CMD_MODIFY, 0, 0);
+        put32(data + 8, orderId);
+        put32(data + 12, uint32_t(quantityChange));
+        put32(data + 16, uint32_t(price));
+    }
+
+private:
+    static void header(unsigned char * data, uint8_t type, uint8_t flags,
+        liquibook::book::SymbolId symbolId)
+    {
+        memset(data, 0, COMMAND_SIZE);
+        data[0] = type;
+        data[1] = flags;
+        put32(data + 4, symbolId);
+    }
+
+    static void put32(unsigned char * at, uint32_t value)
+    {
+        at[0] = uint8_t(value);
+        at[1] = uint8_t(value >> 8);
+        at[2] = uint8_t(value >> 16);
+        at[3] = uint8_t(value >> 24);
+    }
+};
+
+}
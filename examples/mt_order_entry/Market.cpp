@@ -152,6 +152,50 @@ Market::apply(const std::vector<std::string> & tokens)
     return false;
 }
 
+bool
+Market::apply(const CommandView & command)
+{
+    switch(command.type())
+    {
+    case CMD_BOOK:
+    {
+        std::string symbol = command.symbol();
+        if(symbol.empty() || symbolIsDefined(symbol))
+        {
+            return false;
+        }
+        addBook(symbol, (command.flags() & FLAG_DEPTH_BOOK) != 0);
+        return true;
+    }
+    case CMD_BUY:
+    case CMD_SELL:
+        return doBinaryAdd(command);
+    case CMD_CANCEL:
+    {
+        OrderPtr order;
+        OrderBookPtr book;
+        if(!findExistingOrder(command.orderId(), order, book))
+        {
+            return false;
+        }
+        book->cancel(order);
+        return true;
+    }
+    case CMD_MODIFY:
+    {
+        OrderPtr order;
+        OrderBookPtr book;
+        if(!findExistingOrder(command.orderId(), order, book))
+        {
+            return false;
+        }
+        book->replace(order, command.quantityChange(), command.price());
+        return true;
+    }
+    }
+    return false;
+}
+
 
 ////////
 // ADD
@@ -291,9 +335,44 @@ Market::doAdd(const  std::string & side, const std::vector<std::string> & tokens
         }
     }
 
+    liquibook::book::SymbolId symbolId = books_.find(symbol);
+    if(symbolId == liquibook::book::INVALID_SYMBOL_ID)
+    {
+        out() << "--No order book for symbol" << symbol << std::endl;
+        return false;
+    }
+    submitOrder(symbolId, side == "BUY", quantity, price, stopPrice, aon, ioc);
+    return true;
+}
+
+bool
+Market::doBinaryAdd(const CommandView & command)
+{
+    liquibook::book::SymbolId symbolId = command.symbolId();
+    liquibook::book::Quantity quantity = command.quantity();
+    if(!books_.contains(symbolId) || quantity == 0)
+    {
+        return false;
+    }
+    submitOrder(symbolId, command.type() == CMD_BUY, quantity,
+        command.price(), command.stopPrice(),
+        (command.flags() & FLAG_AON) != 0,
+        (command.flags() & FLAG_IOC) != 0);
+    return true;
+}
+
+void
+Market::submitOrder(liquibook::book::SymbolId symbolId,
+    bool buy,
+    liquibook::book::Quantity quantity,
+    liquibook::book::Price price,
+    liquibook::book::Price stopPrice,
+    bool aon,
+    bool ioc)
+{
     std::string orderId = std::to_string(++orderIdSeed_);
 
-    OrderPtr order = std::make_shared<Order>(orderId, side == "BUY", quantity, symbol, price, stopPrice, aon, ioc);
+    OrderPtr order = std::make_shared<Order>(orderId, buy, quantity, books_.symbol(symbolId), price, stopPrice, aon, ioc);
 
     const liquibook::book::OrderConditions AON(liquibook::book::oc_all_or_none);
     const liquibook::book::OrderConditions IOC(liquibook::book::oc_immediate_or_cancel);
@@ -302,20 +381,16 @@ Market::doAdd(const  std::string & side, const std::vector<std::string> & tokens
     const liquibook::book::OrderConditions conditions = 
         (aon ? AON : NOC) | (ioc ? IOC : NOC);
 
+    OrderBookPtr & book = books_.book(symbolId);
 
-    auto book = findBook(symbol);
-    if(!book)
+    order->onSubmitted();
+    if(logging())
     {
-        out() << "--No order book for symbol" << symbol << std::endl;
-        return false;
+        out() << "ADDING order:  " << *order << std::endl;
     }
 
-    order->onSubmitted();
-    out() << "ADDING order:  " << *order << std::endl;
-
-    orders_[orderId] = order;
+    orders_.insert(orderIdSeed_, OrderEntry(order, symbolId));
     book->add(order, conditions);
-    return true;
 }
 
 ///////////
@@ -492,41 +567,38 @@ Market::doDisplay(const std::vector<std::string> & tokens, size_t pos)
 
     // Not an order id.  Try for a symbol:
     std::string symbol = parameter;
-    if(symbolIsDefined(symbol))
+    liquibook::book::SymbolId symbolId = books_.find(symbol);
+    if(symbolId != liquibook::book::INVALID_SYMBOL_ID)
     {
-        for(auto pOrder = orders_.begin(); pOrder != orders_.end(); ++pOrder)
+        // Order ids are dense, so list the orders in the order entered
+        for(uint32_t orderNumber = 1; orderNumber <= orderIdSeed_; ++orderNumber)
         {
-            const OrderPtr & order = pOrder->second;
-            if(order->symbol() == symbol)
+            const OrderEntry * entry = orders_.find(orderNumber);
+            if(entry && entry->symbolId == symbolId)
             {
-                out() << order->verbose(verbose) << std::endl;
-                order->verbose(false);
+                out() << entry->order->verbose(verbose) << std::endl;
+                entry->order->verbose(false);
             }
         }
-        auto book = findBook(symbol);
-        if(!book)
-        {
-            out() << "--No order book for symbol" << symbol << std::endl;
-        }
-        else
-        {
-            book->log(out());
-        }
+        books_.book(symbolId)->log(out());
         return true;
     }
     else if( symbol == "ALL")
     {
-        for(auto pOrder = orders_.begin(); pOrder != orders_.end(); ++pOrder)
+        for(uint32_t orderNumber = 1; orderNumber <= orderIdSeed_; ++orderNumber)
         {
-            const OrderPtr & order = pOrder->second;
-            out() << order->verbose(verbose) << std::endl;
-            order->verbose(false);
+            const OrderEntry * entry = orders_.find(orderNumber);
+            if(entry)
+            {
+                out() << entry->order->verbose(verbose) << std::endl;
+                entry->order->verbose(false);
+            }
         }
 
-        for(auto pBook = books_.begin(); pBook != books_.end(); ++pBook)
+        for(liquibook::book::SymbolId id = 0; id < books_.size(); ++id)
         {
-            out() << "Order book for " << pBook->first << std::endl;
-            pBook->second->log(out());
+            out() << "Order book for " << books_.symbol(id) << std::endl;
+            books_.book(id)->log(out());
         }
         return true;
     }
@@ -543,8 +615,7 @@ Market::doDisplay(const std::vector<std::string> & tokens, size_t pos)
 bool
 Market::symbolIsDefined(const std::string & symbol)
 {
-    auto book = books_.find(symbol);
-    return book != books_.end();
+    return books_.find(symbol) != liquibook::book::INVALID_SYMBOL_ID;
 }
 
 OrderBookPtr
@@ -553,7 +624,10 @@ Market::addBook(const std::string & symbol, bool useDepthBook)
     OrderBookPtr result;
     if(useDepthBook)
     {
-        out() << "Create new depth order book for " << symbol << std::endl;
+        if(logging())
+        {
+            out() << "Create new depth order book for " << symbol << std::endl;
+        }
         DepthOrderBookPtr depthBook = std::make_shared<DepthOrderBook>(symbol);
         depthBook->set_bbo_listener(this);
         depthBook->set_depth_listener(this);
@@ -561,25 +635,16 @@ Market::addBook(const std::string & symbol, bool useDepthBook)
     }
     else
     {
-        out() << "Create new order book for " << symbol << std::endl;
+        if(logging())
+        {
+            out() << "Create new order book for " << symbol << std::endl;
+        }
         result = std::make_shared<OrderBook>(symbol);
     }
     result->set_order_listener(this);
     result->set_trade_listener(this);
     result->set_order_book_listener(this);
-    books_[symbol] = result;
-    return result;
-}
-
-OrderBookPtr
-Market::findBook(const std::string & symbol)
-{
-    OrderBookPtr result;
-    auto entry = books_.find(symbol);
-    if(entry != books_.end())
-    {
-        result = entry->second;
-    }
+    books_.add(symbol, result);
     return result;
 }
 
@@ -622,21 +687,25 @@ bool Market::findExistingOrder(const std::vector<std::string> & tokens, size_t &
 
 bool Market::findExistingOrder(const std::string & orderId, OrderPtr & order, OrderBookPtr & book)
 {
-    auto orderPosition = orders_.find(orderId);
-    if(orderPosition == orders_.end())
+    uint32_t orderNumber = toUint32(orderId);
+    if(orderNumber == INVALID_UINT32 || !findExistingOrder(orderNumber, order, book))
     {
         out() << "--Can't find OrderID #" << orderId << std::endl;
         return false;
     }
+    return true;
+}
 
-    order = orderPosition->second;
-    std::string symbol = order->symbol();
-    book = findBook(symbol);
-    if(!book)
+bool Market::findExistingOrder(uint32_t orderNumber, OrderPtr & order, OrderBookPtr & book)
+{
+    const OrderEntry * entry = orders_.find(orderNumber);
+    if(!entry)
     {
-        out() << "--No order book for symbol" << symbol << std::endl;
         return false;
     }
+
+    order = entry->order;
+    book = books_.book(entry->symbolId);
     return true;
 }
 
@@ -647,15 +716,20 @@ void
 Market::on_accept(const OrderPtr& order)
 {
     order->onAccepted();
-    out() << "\tAccepted: " <<*order<< std::endl;
+    if(logging())
+    {
+        out() << "\tAccepted: " <<*order<< std::endl;
+    }
 }
 
 void 
 Market::on_reject(const OrderPtr& order, const char* reason)
 {
     order->onRejected(reason);
-    out() << "\tRejected: " <<*order<< ' ' << reason << std::endl;
-
+    if(logging())
+    {
+        out() << "\tRejected: " <<*order<< ' ' << reason << std::endl;
+    }
 }
 
 void 
@@ -666,23 +740,32 @@ Market::on_fill(const OrderPtr& order,
 {
     order->onFilled(fill_qty, fill_cost);
     matched_order->onFilled(fill_qty, fill_cost);
-    out() << (order->is_buy() ? "\tBought: " : "\tSold: ") 
-        << fill_qty << " Shares for " << fill_cost << ' ' <<*order<< std::endl;
-    out() << (matched_order->is_buy() ? "\tBought: " : "\tSold: ") 
-        << fill_qty << " Shares for " << fill_cost << ' ' << *matched_order << std::endl;
+    if(logging())
+    {
+        out() << (order->is_buy() ? "\tBought: " : "\tSold: ") 
+            << fill_qty << " Shares for " << fill_cost << ' ' <<*order<< std::endl;
+        out() << (matched_order->is_buy() ? "\tBought: " : "\tSold: ") 
+            << fill_qty << " Shares for " << fill_cost << ' ' << *matched_order << std::endl;
+    }
 }
 
 void 
 Market::on_cancel(const OrderPtr& order)
 {
     order->onCancelled();
-    out() << "\tCanceled: " << *order<< std::endl;
+    if(logging())
+    {
+        out() << "\tCanceled: " << *order<< std::endl;
+    }
 }
 
 void Market::on_cancel_reject(const OrderPtr& order, const char* reason)
 {
     order->onCancelRejected(reason);
-    out() << "\tCancel Reject: " <<*order<< ' ' << reason << std::endl;
+    if(logging())
+    {
+        out() << "\tCancel Reject: " <<*order<< ' ' << reason << std::endl;
+    }
 }
 
 void Market::on_replace(const OrderPtr& order, 
@@ -690,6 +773,10 @@ void Market::on_replace(const OrderPtr& order,
     liquibook::book::Price new_price)
 {
     order->onReplaced(size_delta, new_price);
+    if(!logging())
+    {
+        return;
+    }
     out() << "\tModify " ;
     if(size_delta != liquibook::book::SIZE_UNCHANGED)
     {
@@ -706,7 +793,10 @@ void
 Market::on_replace_reject(const OrderPtr& order, const char* reason)
 {
     order->onReplaceRejected(reason);
-    out() << "\tReplace Reject: " <<*order<< ' ' << reason << std::endl;
+    if(logging())
+    {
+        out() << "\tReplace Reject: " <<*order<< ' ' << reason << std::endl;
+    }
 }
 
 ////////////////////////////////////
@@ -717,6 +807,10 @@ Market::on_trade(const OrderBook* book,
     liquibook::book::Quantity qty, 
     liquibook::book::Cost cost)
 {
+    if(!logging())
+    {
+        return;
+    }
     out() << "\tTrade: " << qty <<  ' ' << book->symbol() << " Cost "  << cost  << std::endl;
 }
 
@@ -726,6 +820,10 @@ Market::on_trade(const OrderBook* book,
 void 
 Market::on_order_book_change(const OrderBook* book)
 {
+    if(!logging())
+    {
+        return;
+    }
     out() << "\tBook Change: " << ' ' << book->symbol() << std::endl;
 }
 
@@ -736,6 +834,10 @@ Market::on_order_book_change(const OrderBook* book)
 void 
 Market::on_bbo_change(const DepthOrderBook * book, const BookDepth * depth)
 {
+    if(!logging())
+    {
+        return;
+    }
     out() << "\tBBO Change: " << ' ' << book->symbol() 
         << (depth->changed() ? " Changed" : " Unchanged")
         << " Change Id: " << depth->last_change()
@@ -749,6 +851,10 @@ Market::on_bbo_change(const DepthOrderBook * book, const BookDepth * depth)
 void 
 Market::on_depth_change(const DepthOrderBook * book, const BookDepth * depth)
 {
+    if(!logging())
+    {
+        return;
+    }
     out() << "\tDepth Change: " << ' ' << book->symbol();
     out() << (depth->changed() ? " Changed" : " Unchanged")
         << " Change Id: " << depth->last_change()
@@ -4,14 +4,16 @@
 #pragma once
 
 #include <book/depth_order_book.h>
+#include <book/symbol_directory.h>
+#include <book/order_index.h>
 
 #include "Order.h"
+#include "BinaryCommand.h"
 
 #include <string>
 #include <vector>
 #include <iostream>
 #include <algorithm>
-#include <map>
 #include <memory>
 
 namespace orderentry
@@ -29,9 +31,26 @@ class Market
     , public liquibook::book::BboListener<DepthOrderBook>
     , public liquibook::book::DepthListener<DepthOrderBook>
 {
-    typedef std::map<std::string, OrderPtr> OrderMap;
-    typedef std::map<std::string, OrderBookPtr> SymbolToBookMap;
+    /// @brief An order and the id of its symbol's book
+    struct OrderEntry
+    {
+        OrderEntry()
+        : symbolId(liquibook::book::INVALID_SYMBOL_ID)
+        {
+        }
+        OrderEntry(const OrderPtr & o, liquibook::book::SymbolId id)
+        : order(o)
+        , symbolId(id)
+        {
+        }
+        OrderPtr order;
+        liquibook::book::SymbolId symbolId;
+    };
+    typedef liquibook::book::OrderIndex<OrderEntry> OrderMap;
+    typedef liquibook::book::SymbolDirectory<OrderBookPtr> SymbolToBookMap;
 public:
+    /// @brief Construct a market
+    /// @param logFile where requests and callbacks are logged, or nullptr to log nothing
     Market(std::ostream * logFile = &std::cout);
     ~Market();
 
@@ -44,6 +63,10 @@ public:
     /// @brief Apply a user command that has been parsed into tokens.
     bool apply(const std::vector<std::string> & tokens);
 
+    /// @brief Apply a binary command.  Never prompts.
+    /// @return false if the command is malformed or names an unknown book or order.
+    bool apply(const CommandView & command);
+
 public:
     /////////////////////////////////////
     // Implement OrderListener interface
@@ -114,14 +137,27 @@ private:
     bool doCancel(const std::vector<std::string> & tokens, size_t position);
     bool doModify(const std::vector<std::string> & tokens, size_t position);
     bool doDisplay(const std::vector<std::string> & tokens, size_t position);
+    bool doBinaryAdd(const CommandView & command);
 
     ////////////////////////
     // Order book interactions
     bool symbolIsDefined(const std::string & symbol);
-    OrderBookPtr findBook(const std::string & symbol);
     OrderBookPtr addBook(const std::string & symbol, bool useDepthBook);
     bool findExistingOrder(const std::vector<std::string> & tokens, size_t & position, OrderPtr & order, OrderBookPtr & book);
     bool findExistingOrder(const std::string & orderId, OrderPtr & order, OrderBookPtr & book);
+    bool findExistingOrder(uint32_t orderNumber, OrderPtr & order, OrderBookPtr & book);
+    void submitOrder(liquibook::book::SymbolId symbolId,
+        bool buy,
+        liquibook::book::Quantity quantity,
+        liquibook::book::Price price,
+        liquibook::book::Price stopPrice,
+        bool aon,
+        bool ioc);
+
+    bool logging() const
+    {
+        return logFile_ != nullptr;
+    }
 
     std::ostream & out() 
     {
@@ -2,11 +2,13 @@
 // All rights reserved.
 // See the file license.txt for licensing information.
 #include "Market.h"
+#include "BatchRun.h"
 #include "Util.h"
 #include <fstream>
 #include <iomanip>
 #include <string>
 #include <locale>
+#include <cstdlib>
 #include <cstring>
 #include <algorithm> 
 #include <vector>
@@ -16,6 +18,18 @@ using namespace orderentry;
 
 int main(int argc, const char * argv[])
 {
+    // Binary command files: -g to generate one, -b to run one as a benchmark
+    if(argc > 2 && strcmp(argv[1], "-g") == 0)
+    {
+        size_t commands = argc > 3 ? size_t(atol(argv[3])) : 1000000;
+        size_t symbols = argc > 4 ? size_t(atol(argv[4])) : 10;
+        return generateBatch(argv[2], commands, symbols);
+    }
+    if(argc > 2 && strcmp(argv[1], "-b") == 0)
+    {
+        return runBatch(argv[2]);
+    }
+
     bool done = false;
     bool prompt = true;
     bool interactive = true;
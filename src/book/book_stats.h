@@ -0,0 +1,94 @@
+// Copyright (c) 2017 Object Computing, Inc.
+// All rights reserved.
+// See the file license.txt for licensing information.
+#pragma once
+
+#include "types.h"
+#include <atomic>
+
+// Hot path counters are compiled in only when LIQUIBOOK_ENABLE_STATS is
+// defined.  Otherwise the counters, and the code that updates them, disappear.
+// Define it for every translation unit that includes liquibook headers.
+#ifdef LIQUIBOOK_ENABLE_STATS
+#define LIQUIBOOK_STATS_ONLY(...) __VA_ARGS__
+#define LIQUIBOOK_STAT_ADD(counter, n) (counter).add(n)
+#else // LIQUIBOOK_ENABLE_STATS
+#define LIQUIBOOK_STATS_ONLY(...)
+#define LIQUIBOOK_STAT_ADD(counter, n) do{} while(false)
+#endif // LIQUIBOOK_ENABLE_STATS
+
+namespace liquibook { namespace book {
+
+/// @brief A monotonic counter written by the thread that owns the book.
+/// There is a single writer, so an update is a relaxed load and store
+/// rather than a locked read-modify-write.  Any thread may read the
+/// counter at any time without locking.
+class StatCounter {
+public:
+  StatCounter() : value_(0) {}
+
+  /// @brief add to the counter (owning thread only)
+  void add(uint64_t n = 1)
+  {
+    value_.store(value_.load(std::memory_order_relaxed) + n,
+                 std::memory_order_relaxed);
+  }
+
+  /// @brief read the counter (any thread)
+  uint64_t get() const
+  {
+    return value_.load(std::memory_order_relaxed);
+  }
+
+  /// @brief copying a book copies its counts
+  StatCounter(const StatCounter & rhs) : value_(rhs.get()) {}
+
+  StatCounter & operator =(const StatCounter & rhs)
+  {
+    value_.store(rhs.get(), std::memory_order_relaxed);
+    return *this;
+  }
+
+private:
+  std::atomic<uint64_t> value_;
+};
+
+/// @brief Counters maintained by OrderBook when LIQUIBOOK_ENABLE_STATS is set.
+struct OrderBookStats {
+  /// @brief valid orders submitted via add()
+  StatCounter orders_added;
+  /// @brief successful cancels, including stop orders not yet triggered
+  StatCounter orders_cancelled;
+  /// @brief accepted replace requests
+  StatCounter orders_replaced;
+  /// @brief fills (one per trade between two orders)
+  StatCounter fills;
+  /// @brief orders that traded against the opposite side
+  StatCounter aggressive_orders;
+  /// @brief price levels traded through by aggressive orders.
+  /// Divide by aggressive_orders for levels swept per aggressive order.
+  StatCounter levels_swept;
+  /// @brief tracker entries examined by find_on_market
+  StatCounter trackers_scanned;
+  /// @brief deferred All Or None orders rechecked for a match
+  StatCounter deferred_aon_checks;
+  /// @brief stop orders moved to the market
+  StatCounter stops_triggered;
+  /// @brief public requests (add, cancel, replace) handled
+  StatCounter operations;
+  /// @brief callbacks performed.
+  /// Divide by operations for callbacks per operation.
+  StatCounter callbacks_generated;
+};
+
+/// @brief Counters maintained by Depth when LIQUIBOOK_ENABLE_STATS is set.
+struct DepthStats {
+  /// @brief levels created directly in the excess map
+  StatCounter excess_inserts;
+  /// @brief visible levels pushed into the excess map by a better price
+  StatCounter excess_spills;
+  /// @brief excess levels restored to visibility after a level was erased
+  StatCounter excess_restores;
+};
+
+} }
@@ -56,6 +56,29 @@ public:
     cb_book_update
   };
 
+  /// @brief Bits of a callback interest mask, one per CbType.
+  /// An OrderBook only builds the callbacks that are in its mask.
+  enum CbInterest {
+    ci_none = 0,
+    ci_order_accept = 1 << cb_order_accept,
+    ci_order_accept_stop = 1 << cb_order_accept_stop,
+    ci_order_trigger_stop = 1 << cb_order_trigger_stop,
+    ci_order_reject = 1 << cb_order_reject,
+    ci_order_fill = 1 << cb_order_fill,
+    ci_order_cancel = 1 << cb_order_cancel,
+    ci_order_cancel_stop = 1 << cb_order_cancel_stop,
+    ci_order_cancel_reject = 1 << cb_order_cancel_reject,
+    ci_order_replace = 1 << cb_order_replace,
+    ci_order_replace_reject = 1 << cb_order_replace_reject,
+    ci_book_update = 1 << cb_book_update,
+    // everything an OrderListener hears about
+    ci_order_events = ci_order_accept | ci_order_accept_stop |
+      ci_order_trigger_stop | ci_order_reject | ci_order_fill |
+      ci_order_cancel | ci_order_cancel_stop | ci_order_cancel_reject |
+      ci_order_replace | ci_order_replace_reject,
+    ci_all = ci_order_events | ci_book_update
+  };
+
   enum FillFlags {
     ff_neither_filled = 0,
     ff_inbound_filled = 1,
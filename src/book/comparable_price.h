@@ -22,16 +22,47 @@ namespace liquibook { namespace book {
 ///   
 class ComparablePrice
 {
-  Price price_;
-  bool buySide_;
+  // The side is kept in the top bit.  The remaining bits hold the price,
+  // negated modulo 2^63 on the buy side, so that a single unsigned compare
+  // orders keys on the same side from most to least liquid.  Market orders
+  // (price 0) encode as 0 on either side and so sort first without a
+  // special case.  Prices must be less than 2^63.
+  static const uint64_t BUY_SIDE = uint64_t(1) << 63;
+  static const uint64_t PRICE_MASK = BUY_SIDE - 1;
+
+  uint64_t key_;
+
+  /// @brief all ones for the buy side, all zeros for the sell side
+  static uint64_t side_mask(bool buySide)
+  {
+    return uint64_t(0) - uint64_t(buySide);
+  }
+
+  /// @brief the sort value of a price on the given side, without side bit
+  static uint64_t sort_value(uint64_t sideMask, Price price)
+  {
+    // (price ^ 0) - 0 == price; (price ^ ~0) - ~0 == -price
+    return ((price ^ sideMask) - sideMask) & PRICE_MASK;
+  }
+
+  uint64_t side_mask() const
+  {
+    return uint64_t(0) - (key_ >> 63);
+  }
+
+  /// @brief the sort value of a price on this key's side, with side bit
+  uint64_t key_for(Price price) const
+  {
+    return sort_value(side_mask(), price) | (key_ & BUY_SIDE);
+  }
 
 public:
   /// @brief construct given side and price
   /// @param buySide controls whether price comparison is normal or reversed
   /// @param price is the price for this key, or 0 (MARKET_ORDER_PRICE) for market
   ComparablePrice(bool buySide, Price price)
-    : price_(price)
-    , buySide_(buySide)
+    : key_(sort_value(side_mask(buySide), price) |
+           (side_mask(buySide) & BUY_SIDE))
   {
   }
 
@@ -39,15 +70,13 @@ public:
   /// Assumes rhs is on the opposite side
   bool matches(Price rhs) const
   {
-    if(price_ == rhs)
-    {
-      return true;
-    }
-    if(buySide_)
-    {
-      return rhs < price_  || price_ == MARKET_ORDER_PRICE ;
-    }
-    return price_ < rhs || rhs == MARKET_ORDER_PRICE;
+    // A trade is possible when the ask is no higher than the bid,
+    // or when the bid is a market order.
+    uint64_t mask = side_mask();
+    Price price = this->price();
+    Price bid = (price & mask) | (rhs & ~mask);
+    Price ask = (rhs & mask) | (price & ~mask);
+    return (ask <= bid) | (bid == MARKET_ORDER_PRICE);
   }
 
   /// @brief less than compare key to a price
@@ -56,102 +85,85 @@ public:
   bool operator <(Price rhs) const
   {
     // Compare difficulty finding a match.  (easy is less than hard)
-    if(price_ == MARKET_ORDER_PRICE)
-    {
-      return rhs != MARKET_ORDER_PRICE;
-    }
-    else if(rhs == MARKET_ORDER_PRICE)
-    {
-      return false;
-    }
-    else if(buySide_)
-    {
-      // Buying: Highest prices first. 
-      return rhs < price_ ;
-    }
-    else
-    {
-      // Selling: lowest prices first
-      return price_ < rhs;
-    }
+    return key_ < key_for(rhs);
   }
 
   /// @brief equality compare key to a price
   bool operator ==(Price rhs) const
   {
     // compares equal without regard to side
-    return price_ == rhs;
+    return price() == rhs;
   }
 
   /// @brief inequality compare key to a price
   bool operator !=(Price rhs) const
   {
-    return !( price_ == rhs );
+    return !( price() == rhs );
   }
 
   /// @brief greater than compare key to a price
   /// Assumes both prices are on the same side.
   bool operator > (Price rhs) const
   {
-    return price_!= MARKET_ORDER_PRICE && ((rhs == MARKET_ORDER_PRICE) || (buySide_ ? (rhs > price_) : (price_ > rhs)));
+    return key_for(rhs) < key_;
   }
 
   /// @brief less than or equal to compare key to a price
   /// Assumes both prices are on the same side.
   bool operator <=(Price rhs) const
   {
-    return *this < rhs || *this == rhs;
+    return key_ <= key_for(rhs);
   }
 
   /// @brief greater than or equal to compare key to a price
   /// Assumes both prices are on the same side.
   bool operator >=(Price rhs) const
   {
-    return *this > rhs || *this == rhs;
+    return key_for(rhs) <= key_;
   }
 
   /// @brief less than compare order map keys
   /// compares the prices assuming they are on the same side
   bool operator <(const ComparablePrice & rhs) const
   {
-    return *this < rhs.price_;
+    return key_ < rhs.key_;
   }
 
   /// @brief equality compare order map keys
   bool operator ==(const ComparablePrice & rhs) const
   {
-    return *this == rhs.price_;
+    return price() == rhs.price();
   }
 
   /// @brief inequality compare order map keys
   bool operator !=(const ComparablePrice & rhs) const
   {
-    return *this != rhs.price_;
+    return price() != rhs.price();
   }
 
   /// @brief greater than compare order map keys
   /// Assumes both prices are on the same side.
   bool operator >(const ComparablePrice & rhs) const
   {
-    return *this > rhs.price_;
+    return rhs.key_ < key_;
   }
 
   /// @brief access price.
   Price price() const
   {
-    return price_;
+    return sort_value(side_mask(), key_);
   }
 
   /// @brief access side.
   bool isBuy() const
   {
-    return buySide_;
+    return (key_ & BUY_SIDE) != 0;
   }
 
   /// @brief check to see if this is market price
   bool isMarket() const
   {
-    return price_ == MARKET_ORDER_PRICE;
+    return (key_ & PRICE_MASK) == 0;
   }
 };
 
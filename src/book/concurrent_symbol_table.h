@@ -0,0 +1,202 @@
+// Copyright (c) 2017 Object Computing, Inc.
+// All rights reserved.
+// See the file license.txt for licensing information.
+#pragma once
+
+#include "epoch.h"
+#include "symbol_directory.h"
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace liquibook { namespace book {
+
+/// @brief Symbols and their books, added and removed while other threads
+/// look them up.
+///
+/// Like SymbolDirectory, each symbol gets a dense SymbolId and its book
+/// lives in an array slot indexed by that id.  Here the slots are atomic
+/// pointers and the symbol to id map is an immutable snapshot replaced
+/// on every change, so lookups take no lock.  A removed book, and each
+/// replaced snapshot, is retired to an EpochDomain and deleted once no
+/// reader that might hold it is still inside a ReadGuard.
+///
+/// Writers (add, remove) serialize on a mutex and copy the symbol map,
+/// which suits a universe that changes a few times a second at most.
+/// Ids are not reused, so capacity bounds the symbols ever added.
+///
+/// The table only keeps books alive; it does not make a book thread
+/// safe.  Each book is still driven by one thread at a time.
+template <class Book>
+class ConcurrentSymbolTable {
+public:
+  /// @brief Keeps the books and symbols a reader finds alive
+  /// until the guard is destroyed
+  class ReadGuard : public EpochGuard {
+  public:
+    ReadGuard(ConcurrentSymbolTable & table, size_t reader)
+    : EpochGuard(table.epochs_, reader)
+    {
+    }
+  };
+
+  /// @brief create a table for up to capacity symbols
+  explicit ConcurrentSymbolTable(size_t capacity);
+
+  /// @brief delete every book.  No reader may be active.
+  ~ConcurrentSymbolTable();
+
+  /// @brief claim a reader slot for the calling thread.
+  /// Keep it, and pass it to each ReadGuard the thread creates.
+  size_t register_reader() { return epochs_.register_reader(); }
+
+  /// @brief add a book for a new symbol, taking ownership of it
+  /// @return the symbol's id, or INVALID_SYMBOL_ID (deleting the book)
+  ///         if the symbol already has a book
+  SymbolId add(const std::string & symbol, std::unique_ptr<Book> book);
+
+  /// @brief remove a symbol and its book.  The book is deleted once no
+  ///        reader can hold it.
+  /// @return false if the id has no book
+  bool remove(SymbolId id);
+
+  /// @brief delete the retired books no reader can hold.
+  ///        add() and remove() call this; call it to reclaim sooner.
+  /// @return the number of objects deleted
+  size_t reclaim() { return epochs_.reclaim(); }
+
+  /// @brief find the book for a symbol id.  Call inside a ReadGuard.
+  /// @return the book, or nullptr if the id has no book
+  Book * find(SymbolId id) const
+  {
+    return id < capacity_ ? slots_[id].load(std::memory_order_acquire)
+                          : nullptr;
+  }
+
+  /// @brief find the id of a symbol.  Call inside a ReadGuard.
+  /// @return the id, or INVALID_SYMBOL_ID if the symbol has no book
+  SymbolId find(const std::string & symbol) const
+  {
+    const NameMap * names = names_.load(std::memory_order_acquire);
+    typename NameMap::const_iterator entry = names->find(symbol);
+    return entry == names->end() ? INVALID_SYMBOL_ID : entry->second;
+  }
+
+  /// @brief the number of symbols with books
+  size_t size() const { return names_.load(std::memory_order_acquire)->size(); }
+
+  /// @brief the most symbols that can ever be added
+  size_t capacity() const { return capacity_; }
+
+  /// @brief the reclamation domain, for readers that also protect
+  ///        objects of their own
+  EpochDomain & epochs() { return epochs_; }
+
+private:
+  ConcurrentSymbolTable(const ConcurrentSymbolTable &);
+  ConcurrentSymbolTable & operator =(const ConcurrentSymbolTable &);
+
+  typedef std::unordered_map<std::string, SymbolId> NameMap;
+
+  /// @brief publish a new symbol map and retire the old one
+  void publish(NameMap * names);
+
+  const size_t capacity_;
+  std::unique_ptr<std::atomic<Book *>[]> slots_;
+  std::atomic<const NameMap *> names_;
+  EpochDomain epochs_;
+
+  // Writer state, guarded by mutex_
+  std::mutex mutex_;
+  SymbolId next_id_;
+  std::vector<std::string> symbols_;
+};
+
+template <class Book>
+ConcurrentSymbolTable<Book>::ConcurrentSymbolTable(size_t capacity)
+: capacity_(capacity),
+  slots_(new std::atomic<Book *>[capacity]),
+  names_(new NameMap),
+  next_id_(0)
+{
+  if (capacity >= INVALID_SYMBOL_ID) {
+    throw std::runtime_error("Too many symbols");
+  }
+  for (size_t id = 0; id < capacity_; ++id) {
+    slots_[id].store(nullptr, std::memory_order_relaxed);
+  }
+}
+
+template <class Book>
+ConcurrentSymbolTable<Book>::~ConcurrentSymbolTable()
+{
+  for (size_t id = 0; id < capacity_; ++id) {
+    delete slots_[id].load(std::memory_order_relaxed);
+  }
+  delete names_.load(std::memory_order_relaxed);
+}
+
+template <class Book>
+SymbolId
+ConcurrentSymbolTable<Book>::add(const std::string & symbol,
+                                 std::unique_ptr<Book> book)
+{
+  SymbolId id;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    const NameMap * names = names_.load(std::memory_order_relaxed);
+    if (names->find(symbol) != names->end()) {
+      return INVALID_SYMBOL_ID;
+    }
+    if (next_id_ >= capacity_) {
+      throw std::runtime_error("Symbol table is full");
+    }
+    id = next_id_++;
+    symbols_.push_back(symbol);
+    // The book is visible by id before the symbol maps to it
+    slots_[id].store(book.release(), std::memory_order_release);
+    NameMap * updated = new NameMap(*names);
+    updated->insert(std::make_pair(symbol, id));
+    publish(updated);
+  }
+  reclaim();
+  return id;
+}
+
+template <class Book>
+bool
+ConcurrentSymbolTable<Book>::remove(SymbolId id)
+{
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (id >= capacity_) {
+      return false;
+    }
+    // Unlink from the symbol map before the slot, so a reader that finds
+    // the id by symbol either sees the book or nullptr
+    const NameMap * names = names_.load(std::memory_order_relaxed);
+    if (slots_[id].load(std::memory_order_relaxed) == nullptr) {
+      return false;
+    }
+    NameMap * updated = new NameMap(*names);
+    updated->erase(symbols_[id]);
+    publish(updated);
+    Book * book = slots_[id].exchange(nullptr, std::memory_order_acq_rel);
+    epochs_.retire(book);
+  }
+  reclaim();
+  return true;
+}
+
+template <class Book>
+void
+ConcurrentSymbolTable<Book>::publish(NameMap * names)
+{
+  const NameMap * old = names_.exchange(names, std::memory_order_acq_rel);
+  epochs_.retire(const_cast<NameMap *>(old));
+}
+
+} }
@@ -5,6 +5,8 @@
 
 #include "depth_constants.h"
 #include "depth_level.h"
+#include "book_stats.h"
+#include "memory_usage.h"
 #include <stdexcept>
 #include <map>
 #include <cmath>
@@ -113,6 +115,16 @@ public:
   /// @brief note the ID of last published change
   void published();
 
+  /// @brief report the memory held by this depth.
+  /// The visible levels are inline; excess levels are held in tree nodes.
+  MemoryUsage memory_usage() const;
+
+#ifdef LIQUIBOOK_ENABLE_STATS
+  /// @brief access the excess level counters for this depth.
+  /// May be read from a monitoring thread while the depth is in use.
+  const DepthStats & stats() const { return stats_; }
+#endif // LIQUIBOOK_ENABLE_STATS
+
 private:
   DepthLevel levels_[SIZE*2];
   ChangeId last_change_;
@@ -124,6 +136,9 @@ private:
   typedef std::map<Price, DepthLevel, std::less<Price> > AskLevelMap;
   BidLevelMap excess_bid_levels_;
   AskLevelMap excess_ask_levels_;
+#ifdef LIQUIBOOK_ENABLE_STATS
+  DepthStats stats_;
+#endif // LIQUIBOOK_ENABLE_STATS
 
   /// @brief find the level associated with the price
   /// @param price the price to find
@@ -412,6 +427,7 @@ Depth<SIZE>::find_level(Price price, bool is_bid, bool should_create)
         level = &find_result->second;
       // Else not found, insert if one should be created
       } else if (should_create) {
+        LIQUIBOOK_STAT_ADD(stats_.excess_inserts, 1);
         DepthLevel new_level;
         new_level.init(price, true);
         std::pair<BidLevelMap::iterator, bool> insert_result;
@@ -427,6 +443,7 @@ Depth<SIZE>::find_level(Price price, bool is_bid, bool should_create)
         level = &find_result->second;
       // Else not found, insert if one should be created
       } else if (should_create) {
+        LIQUIBOOK_STAT_ADD(stats_.excess_inserts, 1);
         DepthLevel new_level;
         new_level.init(price, true);
         std::pair<AskLevelMap::iterator, bool> insert_result;
@@ -449,6 +466,7 @@ Depth<SIZE>::insert_level_before(DepthLevel* level,
 
   // If the last level has valid data
   if (last_side_level->price() != INVALID_LEVEL_PRICE) {
+    LIQUIBOOK_STAT_ADD(stats_.excess_spills, 1);
     DepthLevel excess_level;
     excess_level.init(0, true);  // Will assign over price
     excess_level = *last_side_level;
@@ -519,6 +537,7 @@ Depth<SIZE>::erase_level(DepthLevel* level, bool is_bid)
       if (is_bid) {
         BidLevelMap::iterator best_bid = excess_bid_levels_.begin();
         if (best_bid != excess_bid_levels_.end()) {
+          LIQUIBOOK_STAT_ADD(stats_.excess_restores, 1);
           *last_side_level = best_bid->second;
           excess_bid_levels_.erase(best_bid);
         } else {
@@ -529,6 +548,7 @@ Depth<SIZE>::erase_level(DepthLevel* level, bool is_bid)
       } else {
         AskLevelMap::iterator best_ask = excess_ask_levels_.begin();
         if (best_ask != excess_ask_levels_.end()) {
+          LIQUIBOOK_STAT_ADD(stats_.excess_restores, 1);
           *last_side_level = best_ask->second;
           excess_ask_levels_.erase(best_ask);
         } else {
@@ -572,4 +592,18 @@ Depth<SIZE>::published()
   last_published_change_ = last_change_;
 }
 
+template <int SIZE> 
+MemoryUsage
+Depth<SIZE>::memory_usage() const
+{
+  MemoryUsage usage;
+  usage.object_bytes = sizeof(*this);
+  usage.container_bytes =
+    excess_bid_levels_.size() *
+      MemoryUsage::tree_node_bytes<typename BidLevelMap::value_type>() +
+    excess_ask_levels_.size() *
+      MemoryUsage::tree_node_bytes<typename AskLevelMap::value_type>();
+  return usage;
+}
+
 } }
@@ -0,0 +1,168 @@
+// Copyright (c) 2017 Object Computing, Inc.
+// All rights reserved.
+// See the file license.txt for licensing information.
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <vector>
+
+namespace liquibook { namespace book {
+
+/// @brief A book whose depth publication a DepthConflator holds back.
+class ConflatedBook {
+public:
+  virtual ~ConflatedBook() {}
+
+  /// @brief publish the net change to the depth since the last flush
+  virtual void flush_depth() = 0;
+};
+
+/// @brief Holds back depth publication for a set of books and publishes
+/// each changed book once per flush.
+///
+/// A book attached with DepthOrderBook::set_depth_conflator() stops
+/// publishing after every change.  Instead, on its first change since a
+/// flush it marks itself dirty here, and its depth keeps track of which
+/// levels changed.  A flush then makes one depth callback per dirty book
+/// covering every level changed since the previous flush.
+///
+/// Flushes happen when asked for, after event_budget held changes, or
+/// when poll() finds flush_interval has passed since the last flush.
+/// Call poll() from the thread that drives the books; it, like the
+/// books, is not thread safe.
+class DepthConflator {
+public:
+  typedef std::chrono::steady_clock Clock;
+
+  /// @brief construct
+  /// @param event_budget flush after this many held changes, 0 for no limit
+  /// @param flush_interval flush when poll() finds this much time has
+  ///        passed since the last flush, zero for no limit
+  explicit DepthConflator(size_t event_budget = 0,
+                          Clock::duration flush_interval = Clock::duration());
+
+  /// @brief publish every dirty book now
+  /// @return the number of books published
+  size_t flush();
+
+  /// @brief flush if the interval has passed or the budget is used up
+  /// @return the number of books published
+  size_t poll() { return poll(Clock::now()); }
+
+  /// @brief flush if the interval has passed by now, or the budget is
+  ///        used up
+  size_t poll(Clock::time_point now);
+
+  /// @brief note a held change to a book's depth.  Called by the book.
+  void on_change(ConflatedBook* book, bool first_since_flush);
+
+  /// @brief forget a dirty book without publishing it.  Called by a book
+  ///        that goes away or is detached, possibly from a depth callback
+  ///        during a flush.
+  void forget(ConflatedBook* book);
+
+  /// @brief the number of books waiting to be published
+  size_t dirty_books() const { return dirty_.size(); }
+
+  /// @brief the number of changes held since the last flush
+  size_t held_changes() const { return held_changes_; }
+
+  /// @brief the number of flushes that published at least one book
+  size_t flushes() const { return flushes_; }
+
+  /// @brief the flush interval poll() checks for, zero for none
+  Clock::duration flush_interval() const { return flush_interval_; }
+
+private:
+  DepthConflator(const DepthConflator &);
+  DepthConflator & operator =(const DepthConflator &);
+
+  typedef std::vector<ConflatedBook*> Books;
+  Books dirty_;
+  Books flushing_;
+  size_t event_budget_;
+  size_t held_changes_;
+  size_t flushes_;
+  bool in_flush_;
+  Clock::duration flush_interval_;
+  Clock::time_point last_flush_;
+};
+
+inline
+DepthConflator::DepthConflator(size_t event_budget,
+                               Clock::duration flush_interval)
+: event_budget_(event_budget),
+  held_changes_(0),
+  flushes_(0),
+  in_flush_(false),
+  flush_interval_(flush_interval),
+  last_flush_(Clock::now())
+{
+}
+
+inline size_t
+DepthConflator::flush()
+{
+  if (in_flush_) {
+    return 0;
+  }
+  held_changes_ = 0;
+  if (dirty_.empty()) {
+    return 0;
+  }
+  // Books changed by a depth callback mark themselves dirty again, for
+  // the next flush
+  in_flush_ = true;
+  flushing_.swap(dirty_);
+  size_t flushed = 0;
+  for (Books::iterator book = flushing_.begin();
+       book != flushing_.end(); ++book) {
+    // Books forgotten by an earlier book's callback are left null
+    if (*book) {
+      (*book)->flush_depth();
+      ++flushed;
+    }
+  }
+  flushing_.clear();
+  in_flush_ = false;
+  if (flushed) {
+    ++flushes_;
+  }
+  return flushed;
+}
+
+inline size_t
+DepthConflator::poll(Clock::time_point now)
+{
+  bool due = event_budget_ && held_changes_ >= event_budget_;
+  if (flush_interval_ != Clock::duration() &&
+      now - last_flush_ >= flush_interval_) {
+    last_flush_ = now;
+    due = true;
+  }
+  return due ? flush() : 0;
+}
+
+inline void
+DepthConflator::on_change(ConflatedBook* book, bool first_since_flush)
+{
+  if (first_since_flush) {
+    dirty_.push_back(book);
+  }
+  if (++held_changes_ == event_budget_) {
+    flush();
+  }
+}
+
+inline void
+DepthConflator::forget(ConflatedBook* book)
+{
+  dirty_.erase(std::remove(dirty_.begin(), dirty_.end(), book), dirty_.end());
+  // Erasing would move the entries under a flush in progress
+  std::replace(flushing_.begin(), flushing_.end(), book,
+               static_cast<ConflatedBook*>(nullptr));
+}
+
+} }
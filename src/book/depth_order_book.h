@@ -7,33 +7,83 @@
 #include "depth.h"
 #include "bbo_listener.h"
 #include "depth_listener.h"
+#include "top_of_book.h"
+#include "depth_conflator.h"
 
 namespace liquibook { namespace book {
 
 /// @brief Implementation of order book child class, that incorporates
 ///        aggregate depth tracking.  
+///
+/// Like OrderBook, builds every callback by default.  A derived class
+/// that handles nothing beyond depth tracking may narrow the callbacks it
+/// builds to depth_callback_interest() in its constructor; listeners still
+/// add whatever they need.
+///
+/// Listeners are called on the thread that drives the book, with the
+/// live depth.  For readers on other threads the book can also copy its
+/// BBO, or all its depth levels, into SeqlockTopOfBook slots after each
+/// change.
+///
+/// By default the depth is published after every change.  A book
+/// attached to a DepthConflator publishes only when the conflator
+/// flushes, once for all the changes since the previous flush.
 template <typename OrderPtr, int SIZE = 5>
-class DepthOrderBook : public OrderBook<OrderPtr> {
+class DepthOrderBook : public OrderBook<OrderPtr>, public ConflatedBook {
 public:
   typedef Depth<SIZE> DepthTracker;
   typedef BboListener<DepthOrderBook >TypedBboListener;
   typedef DepthListener<DepthOrderBook >TypedDepthListener;
+  typedef SeqlockTopOfBook<1> BboSlot;
+  typedef SeqlockTopOfBook<SIZE> DepthSlot;
 
   /// @brief construct
   DepthOrderBook(const std::string & symbol = "unknown");
 
+  /// @brief destroy, dropping any unpublished change from the conflator
+  virtual ~DepthOrderBook();
+
+  /// @brief the callbacks depth tracking needs: those that change the
+  /// depth, and the book update that publishes it.
+  /// @return Callback::CbInterest bits
+  static uint32_t depth_callback_interest();
+
   /// @brief set the BBO listener
   void set_bbo_listener(TypedBboListener* bbo_listener);
 
   /// @brief set the depth listener
   void set_depth_listener(TypedDepthListener* depth_listener);
 
+  /// @brief publish the best bid and offer to a slot after each change
+  ///        to them, starting with the current BBO.  nullptr to stop.
+  void set_bbo_slot(BboSlot* slot);
+
+  /// @brief publish every depth level to a slot after each change to the
+  ///        depth, starting with the current depth.  nullptr to stop.
+  void set_depth_slot(DepthSlot* slot);
+
+  /// @brief hold depth publication until a conflator flushes.  Any
+  ///        change still held by the previous conflator is published
+  ///        first.  nullptr to publish after every change again.
+  void set_depth_conflator(DepthConflator* conflator);
+
+  /// @brief publish the depth changes held since the last flush
+  virtual void flush_depth();
+
+  /// @brief when the first request among the depth changes being
+  ///        published reached the book.  For depth listeners; 0 unless
+  ///        arrivals are stamped.
+  Timestamp depth_arrival_time() const { return published_arrival_; }
+
   // @brief access the depth tracker
   DepthTracker& depth();
 
   // @brief access the depth tracker
   const DepthTracker& depth() const;
 
+  /// @brief report the memory held by this book, including its depth
+  virtual MemoryUsage memory_usage() const;
+
   protected:
   //////////////////////////////////
   // Implement virtual callback methods
@@ -60,17 +110,55 @@ public:
   virtual void on_order_book_change();
 
 private:
+  // Tell the listeners and slots about the changes since last published
+  void publish_depth();
+
   DepthTracker depth_;
   TypedBboListener* bbo_listener_;
   TypedDepthListener* depth_listener_;
+  BboSlot* bbo_slot_;
+  DepthSlot* depth_slot_;
+  DepthConflator* conflator_;
+  bool depth_held_;
+  // Arrival of the first request changing the depth since it was last
+  // published, and of the first in the publication under way
+  Timestamp held_arrival_;
+  Timestamp published_arrival_;
 };
 
 template <class OrderPtr, int SIZE>
 DepthOrderBook<OrderPtr, SIZE>::DepthOrderBook(const std::string & symbol)
 : OrderBook<OrderPtr>(symbol),
   bbo_listener_(nullptr),
-  depth_listener_(nullptr)
+  depth_listener_(nullptr),
+  bbo_slot_(nullptr),
+  depth_slot_(nullptr),
+  conflator_(nullptr),
+  depth_held_(false),
+  held_arrival_(0),
+  published_arrival_(0)
+{
+}
+
+template <class OrderPtr, int SIZE>
+uint32_t
+DepthOrderBook<OrderPtr, SIZE>::depth_callback_interest()
+{
+  typedef typename OrderBook<OrderPtr>::TypedCallback TypedCallback;
+  return TypedCallback::ci_order_accept |
+    TypedCallback::ci_order_trigger_stop |
+    TypedCallback::ci_order_fill |
+    TypedCallback::ci_order_cancel |
+    TypedCallback::ci_order_replace |
+    TypedCallback::ci_book_update;
+}
+
+template <class OrderPtr, int SIZE>
+DepthOrderBook<OrderPtr, SIZE>::~DepthOrderBook()
 {
+  if (conflator_ && depth_held_) {
+    conflator_->forget(this);
+  }
 }
 
 template <class OrderPtr, int SIZE>
@@ -87,6 +175,51 @@ DepthOrderBook<OrderPtr, SIZE>::set_depth_listener(TypedDepthListener* listener)
   depth_listener_ = listener;
 }
 
+template <class OrderPtr, int SIZE>
+void
+DepthOrderBook<OrderPtr, SIZE>::set_bbo_slot(BboSlot* slot)
+{
+  bbo_slot_ = slot;
+  if (bbo_slot_) {
+    typename BboSlot::Snapshot bbo;
+    bbo.set(depth_);
+    bbo_slot_->publish(bbo);
+  }
+}
+
+template <class OrderPtr, int SIZE>
+void
+DepthOrderBook<OrderPtr, SIZE>::set_depth_slot(DepthSlot* slot)
+{
+  depth_slot_ = slot;
+  if (depth_slot_) {
+    typename DepthSlot::Snapshot levels;
+    levels.set(depth_);
+    depth_slot_->publish(levels);
+  }
+}
+
+template <class OrderPtr, int SIZE>
+void
+DepthOrderBook<OrderPtr, SIZE>::set_depth_conflator(DepthConflator* conflator)
+{
+  if (conflator_ && depth_held_) {
+    conflator_->forget(this);
+    flush_depth();
+  }
+  conflator_ = conflator;
+}
+
+template <class OrderPtr, int SIZE>
+void
+DepthOrderBook<OrderPtr, SIZE>::flush_depth()
+{
+  if (depth_held_) {
+    depth_held_ = false;
+    publish_depth();
+  }
+}
+
 template <class OrderPtr, int SIZE> 
 void 
 DepthOrderBook<OrderPtr, SIZE>::on_accept(const OrderPtr& order, Quantity quantity)
@@ -191,15 +324,48 @@ DepthOrderBook<OrderPtr, SIZE>::on_order_book_change()
 {
   // Book was updated, see if the depth we track was effected
   if (depth_.changed()) {
+    if (!held_arrival_) {
+      held_arrival_ = this->arrival_time();
+    }
+    if (conflator_) {
+      // Hold the change; the depth keeps track of the changed levels
+      bool first_since_flush = !depth_held_;
+      depth_held_ = true;
+      conflator_->on_change(this, first_since_flush);
+    } else {
+      publish_depth();
+    }
+  }
+}
+
+template <class OrderPtr, int SIZE> 
+void 
+DepthOrderBook<OrderPtr, SIZE>::publish_depth()
+{
+  if (depth_.changed()) {
+    published_arrival_ = held_arrival_;
+    held_arrival_ = 0;
+    if (depth_slot_) {
+      typename DepthSlot::Snapshot levels;
+      levels.set(depth_);
+      depth_slot_->publish(levels);
+    }
     if (depth_listener_) {
       depth_listener_->on_depth_change(this, &depth_);
     }
-    if (bbo_listener_) {
+    if (bbo_listener_ || bbo_slot_) {
       ChangeId last_change = depth_.last_published_change();
       // May have been the first level which changed
       if ((depth_.bids()->changed_since(last_change)) ||
         (depth_.asks()->changed_since(last_change))) {
-        bbo_listener_->on_bbo_change(this, &depth_);
+        if (bbo_slot_) {
+          typename BboSlot::Snapshot bbo;
+          bbo.set(depth_);
+          bbo_slot_->publish(bbo);
+        }
+        if (bbo_listener_) {
+          bbo_listener_->on_bbo_change(this, &depth_);
+        }
       }
     }
     // Start tracking changes again...
@@ -221,4 +387,15 @@ DepthOrderBook<OrderPtr, SIZE>::depth() const
   return depth_;
 }
 
+template <class OrderPtr, int SIZE>
+MemoryUsage
+DepthOrderBook<OrderPtr, SIZE>::memory_usage() const
+{
+  MemoryUsage usage = OrderBook<OrderPtr>::memory_usage();
+  // The depth levels are inline in this object
+  usage.object_bytes = sizeof(*this);
+  usage.container_bytes += depth_.memory_usage().container_bytes;
+  return usage;
+}
+
 } }
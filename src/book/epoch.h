@@ -0,0 +1,179 @@
+// Copyright (c) 2017 Object Computing, Inc.
+// All rights reserved.
+// See the file license.txt for licensing information.
+#pragma once
+
+#include "types.h"
+#include <atomic>
+#include <mutex>
+#include <stdexcept>
+#include <vector>
+
+namespace liquibook { namespace book {
+
+/// @brief Epoch based reclamation for structures read without locks.
+///
+/// A writer that unlinks an object from a shared structure hands it to
+/// retire() rather than deleting it.  Readers bracket each access with
+/// enter() and exit() (or an EpochGuard), which publish the epoch they
+/// started in to a per reader slot.  reclaim() deletes a retired object
+/// once every reader that could still hold it has exited.
+///
+/// Readers never lock or wait: entering and exiting are a store each,
+/// plus a fence on entry.  Writers serialize on a mutex.
+///
+/// Each reader thread calls register_reader() once and keeps its slot.
+/// A slot must not be shared by threads, and guards must not nest.
+class EpochDomain {
+public:
+  /// @brief the most reader threads a domain supports
+  static const size_t MAX_READERS = 64;
+
+  EpochDomain()
+  : epoch_(1),
+    reader_count_(0)
+  {
+    for (size_t reader = 0; reader < MAX_READERS; ++reader) {
+      readers_[reader].epoch.store(QUIESCENT, std::memory_order_relaxed);
+    }
+  }
+
+  /// @brief delete everything still retired.  No reader may be active.
+  ~EpochDomain()
+  {
+    for (size_t pos = 0; pos < retired_.size(); ++pos) {
+      retired_[pos].deleter(retired_[pos].object);
+    }
+  }
+
+  /// @brief claim a reader slot for the calling thread
+  size_t register_reader()
+  {
+    size_t reader = reader_count_.fetch_add(1);
+    if (reader >= MAX_READERS) {
+      throw std::runtime_error("Too many epoch readers");
+    }
+    return reader;
+  }
+
+  /// @brief start a read.  Objects reachable now stay alive until exit().
+  void enter(size_t reader)
+  {
+    // Acquire: a reader that sees an epoch also sees every unlink that
+    // was retired before it
+    readers_[reader].epoch.store(epoch_.load(std::memory_order_acquire),
+                                 std::memory_order_relaxed);
+    // Publish the slot before reading anything it protects.  Pairs with
+    // the fence in reclaim().
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+  }
+
+  /// @brief finish a read
+  void exit(size_t reader)
+  {
+    readers_[reader].epoch.store(QUIESCENT, std::memory_order_release);
+  }
+
+  /// @brief hand over an object that readers can no longer reach.
+  /// It is deleted by a later reclaim(), once no reader can hold it.
+  template <class T>
+  void retire(T * object)
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    Retired retired = { object, &delete_object<T>,
+                        epoch_.fetch_add(1, std::memory_order_acq_rel) };
+    retired_.push_back(retired);
+  }
+
+  /// @brief delete the retired objects no active reader can hold
+  /// @return the number of objects deleted
+  size_t reclaim()
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    // Readers that started after this cannot see anything retired so far
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    uint64_t oldest = QUIESCENT;
+    for (size_t reader = 0; reader < MAX_READERS; ++reader) {
+      uint64_t epoch = readers_[reader].epoch.load(std::memory_order_acquire);
+      if (epoch < oldest) {
+        oldest = epoch;
+      }
+    }
+    // An object retired in epoch e may be held by readers that entered
+    // in e or earlier
+    size_t kept = 0;
+    size_t deleted = 0;
+    for (size_t pos = 0; pos < retired_.size(); ++pos) {
+      if (retired_[pos].epoch < oldest) {
+        retired_[pos].deleter(retired_[pos].object);
+        ++deleted;
+      } else {
+        retired_[kept++] = retired_[pos];
+      }
+    }
+    retired_.resize(kept);
+    return deleted;
+  }
+
+  /// @brief the number of retired objects not yet deleted
+  size_t pending() const
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return retired_.size();
+  }
+
+private:
+  EpochDomain(const EpochDomain &);
+  EpochDomain & operator =(const EpochDomain &);
+
+  // Slot value while a reader is outside any read
+  static const uint64_t QUIESCENT = UINT64_MAX;
+
+  template <class T>
+  static void delete_object(void * object)
+  {
+    delete static_cast<T *>(object);
+  }
+
+  struct Retired {
+    void * object;
+    void (*deleter)(void *);
+    uint64_t epoch;
+  };
+
+  // Each slot on its own cache line, so readers do not contend
+  struct alignas(64) ReaderSlot {
+    std::atomic<uint64_t> epoch;
+  };
+
+  ReaderSlot readers_[MAX_READERS];
+  std::atomic<uint64_t> epoch_;
+  std::atomic<size_t> reader_count_;
+  mutable std::mutex mutex_;
+  std::vector<Retired> retired_;
+};
+
+/// @brief Holds a reader inside an EpochDomain for its lifetime
+class EpochGuard {
+public:
+  EpochGuard(EpochDomain & domain, size_t reader)
+  : domain_(domain),
+    reader_(reader)
+  {
+    domain_.enter(reader_);
+  }
+
+  ~EpochGuard()
+  {
+    domain_.exit(reader_);
+  }
+
+private:
+  EpochGuard(const EpochGuard &);
+  EpochGuard & operator =(const EpochGuard &);
+
+  EpochDomain & domain_;
+  size_t reader_;
+};
+
+} }
@@ -0,0 +1,241 @@
+// Copyright (c) 2017 Object Computing, Inc.
+// All rights reserved.
+// See the file license.txt for licensing information.
+#pragma once
+
+#include "callback.h"
+#include <vector>
+#include <utility>
+
+namespace liquibook { namespace book {
+
+/// @brief The events produced by one order book operation, waiting to be
+/// delivered.
+///
+/// Each event is a one byte type tag plus entries in only the columns its
+/// type uses: a book update is just the tag, an accept is the tag, an order
+/// and a quantity, a fill adds the matched order, price and flags.  Events
+/// are appended during an operation and delivered in order by drain(),
+/// which walks the tags and each column front to back.
+///
+/// Not thread safe.
+template <typename OrderPtr>
+class EventBuffer {
+public:
+  typedef Callback<OrderPtr> TypedCallback;
+
+  /// @brief append an accept.
+  /// @return the slot of its quantity, to be filled in with set_quantity()
+  size_t accept(const OrderPtr& order)
+  {
+    append(TypedCallback::cb_order_accept, order);
+    quantities_.push_back(0);
+    return quantities_.size() - 1;
+  }
+
+  /// @brief set a quantity appended earlier in this operation
+  void set_quantity(size_t slot, Quantity quantity)
+  {
+    quantities_[slot] = quantity;
+  }
+
+  /// @brief append an accept of a stop order
+  void accept_stop(const OrderPtr& order)
+  {
+    append(TypedCallback::cb_order_accept_stop, order);
+  }
+
+  /// @brief append a stop order going on the market
+  void trigger_stop(const OrderPtr& order)
+  {
+    append(TypedCallback::cb_order_trigger_stop, order);
+  }
+
+  /// @brief append a reject
+  void reject(const OrderPtr& order, const char* reason)
+  {
+    append(TypedCallback::cb_order_reject, order);
+    reasons_.push_back(reason);
+  }
+
+  /// @brief append a fill
+  void fill(const OrderPtr& inbound_order,
+            const OrderPtr& matched_order,
+            Quantity fill_qty,
+            Price fill_price,
+            typename TypedCallback::FillFlags fill_flags)
+  {
+    append(TypedCallback::cb_order_fill, inbound_order);
+    matched_orders_.push_back(matched_order);
+    quantities_.push_back(fill_qty);
+    prices_.push_back(fill_price);
+    flags_.push_back(uint8_t(fill_flags));
+  }
+
+  /// @brief append a cancel
+  void cancel(const OrderPtr& order, Quantity open_qty)
+  {
+    append(TypedCallback::cb_order_cancel, order);
+    quantities_.push_back(open_qty);
+  }
+
+  /// @brief append a cancel of a stop order
+  void cancel_stop(const OrderPtr& order)
+  {
+    append(TypedCallback::cb_order_cancel_stop, order);
+  }
+
+  /// @brief append a cancel reject
+  void cancel_reject(const OrderPtr& order, const char* reason)
+  {
+    append(TypedCallback::cb_order_cancel_reject, order);
+    reasons_.push_back(reason);
+  }
+
+  /// @brief append a replace
+  void replace(const OrderPtr& order,
+               Quantity curr_open_qty,
+               int64_t size_delta,
+               Price new_price)
+  {
+    append(TypedCallback::cb_order_replace, order);
+    quantities_.push_back(curr_open_qty);
+    deltas_.push_back(size_delta);
+    prices_.push_back(new_price);
+  }
+
+  /// @brief append a replace reject
+  void replace_reject(const OrderPtr& order, const char* reason)
+  {
+    append(TypedCallback::cb_order_replace_reject, order);
+    reasons_.push_back(reason);
+  }
+
+  /// @brief append a book update
+  void book_update()
+  {
+    types_.push_back(uint8_t(TypedCallback::cb_book_update));
+  }
+
+  /// @brief the number of events held
+  size_t size() const { return types_.size(); }
+
+  /// @brief are there no events?
+  bool empty() const { return types_.empty(); }
+
+  /// @brief forget all events, keeping the memory for reuse
+  void clear()
+  {
+    types_.clear();
+    orders_.clear();
+    matched_orders_.clear();
+    quantities_.clear();
+    prices_.clear();
+    deltas_.clear();
+    flags_.clear();
+    reasons_.clear();
+  }
+
+  /// @brief make room for events without reallocating
+  void reserve(size_t events)
+  {
+    types_.reserve(events);
+    orders_.reserve(events);
+    quantities_.reserve(events);
+  }
+
+  /// @brief exchange contents with another buffer
+  void swap(EventBuffer & other)
+  {
+    types_.swap(other.types_);
+    orders_.swap(other.orders_);
+    matched_orders_.swap(other.matched_orders_);
+    quantities_.swap(other.quantities_);
+    prices_.swap(other.prices_);
+    deltas_.swap(other.deltas_);
+    flags_.swap(other.flags_);
+    reasons_.swap(other.reasons_);
+  }
+
+  /// @brief the heap memory held by the columns
+  size_t memory_bytes() const
+  {
+    return types_.capacity() * sizeof(uint8_t) +
+      (orders_.capacity() + matched_orders_.capacity()) * sizeof(OrderPtr) +
+      quantities_.capacity() * sizeof(Quantity) +
+      prices_.capacity() * sizeof(Price) +
+      deltas_.capacity() * sizeof(int64_t) +
+      flags_.capacity() * sizeof(uint8_t) +
+      reasons_.capacity() * sizeof(const char*);
+  }
+
+  /// @brief deliver every event, oldest first, then clear the buffer.
+  /// Each event is unpacked into a Callback, with the order pointers moved
+  /// out of the buffer, and passed to visit(TypedCallback&).  The visitor
+  /// must not append to this buffer.  If it throws, call clear() before
+  /// reusing the buffer.
+  template <class Visitor>
+  void drain(Visitor visit)
+  {
+    size_t order = 0;
+    size_t matched = 0;
+    size_t quantity = 0;
+    size_t price = 0;
+    size_t delta = 0;
+    size_t flag = 0;
+    size_t reason = 0;
+    for (size_t pos = 0; pos < types_.size(); ++pos) {
+      TypedCallback cb;
+      cb.type = typename TypedCallback::CbType(types_[pos]);
+      switch (cb.type) {
+        case TypedCallback::cb_order_fill:
+          cb.matched_order = std::move(matched_orders_[matched++]);
+          cb.price = prices_[price++];
+          cb.flags = flags_[flag++];
+          // fall through
+        case TypedCallback::cb_order_accept:
+        case TypedCallback::cb_order_cancel:
+          cb.order = std::move(orders_[order++]);
+          cb.quantity = quantities_[quantity++];
+          break;
+        case TypedCallback::cb_order_replace:
+          cb.order = std::move(orders_[order++]);
+          cb.quantity = quantities_[quantity++];
+          cb.delta = deltas_[delta++];
+          cb.price = prices_[price++];
+          break;
+        case TypedCallback::cb_order_reject:
+        case TypedCallback::cb_order_cancel_reject:
+        case TypedCallback::cb_order_replace_reject:
+          cb.order = std::move(orders_[order++]);
+          cb.reject_reason = reasons_[reason++];
+          break;
+        case TypedCallback::cb_book_update:
+          break;
+        default:
+          cb.order = std::move(orders_[order++]);
+          break;
+      }
+      visit(cb);
+    }
+    clear();
+  }
+
+private:
+  void append(typename TypedCallback::CbType type, const OrderPtr& order)
+  {
+    types_.push_back(uint8_t(type));
+    orders_.push_back(order);
+  }
+
+  std::vector<uint8_t> types_;
+  std::vector<OrderPtr> orders_;
+  std::vector<OrderPtr> matched_orders_;
+  std::vector<Quantity> quantities_;
+  std::vector<Price> prices_;
+  std::vector<int64_t> deltas_;
+  std::vector<uint8_t> flags_;
+  std::vector<const char*> reasons_;
+};
+
+} }
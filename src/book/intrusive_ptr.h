@@ -0,0 +1,200 @@
+// Copyright (c) 2017 Object Computing, Inc.
+// All rights reserved.
+// See the file license.txt for licensing information.
+#pragma once
+
+#include "types.h"
+#include <cstddef>
+#include <utility>
+
+namespace liquibook { namespace book {
+
+/// @brief Base for objects owned through an IntrusivePtr.
+/// The reference count lives in the object and is a plain integer, so
+/// copying a handle is an ordinary increment rather than the atomic
+/// operation std::shared_ptr needs.  Use it for orders that are only
+/// touched by the thread that owns the book; hand an order to another
+/// thread only with your own synchronization.
+///
+/// Derive as: class MyOrder : public Order, public RefCounted<MyOrder>
+/// The object is deleted as a Derived when its last handle goes away.
+template <class Derived>
+class RefCounted {
+public:
+  RefCounted() : ref_count_(0) {}
+
+  // A copied object starts with no owners of its own
+  RefCounted(const RefCounted &) : ref_count_(0) {}
+  RefCounted & operator =(const RefCounted &) { return *this; }
+
+  /// @brief the number of handles referring to this object
+  uint32_t use_count() const { return ref_count_; }
+
+  /// @brief add an owner.  Found by argument dependent lookup.
+  friend void intrusive_ptr_add_ref(const Derived * object)
+  {
+    ++static_cast<const RefCounted *>(object)->ref_count_;
+  }
+
+  /// @brief remove an owner, deleting the object with the last one.
+  friend void intrusive_ptr_release(const Derived * object)
+  {
+    if (--static_cast<const RefCounted *>(object)->ref_count_ == 0) {
+      delete object;
+    }
+  }
+
+protected:
+  ~RefCounted() {}
+
+private:
+  mutable uint32_t ref_count_;
+};
+
+/// @brief Pointer-sized owning handle to an object with its own count.
+/// Usable as the OrderPtr of an OrderBook.  T is any type for which
+/// intrusive_ptr_add_ref(T*) and intrusive_ptr_release(T*) are found by
+/// argument dependent lookup, such as a RefCounted<T>.
+template <class T>
+class IntrusivePtr {
+public:
+  typedef T element_type;
+
+  IntrusivePtr()
+  : ptr_(nullptr)
+  {
+  }
+
+  IntrusivePtr(std::nullptr_t)
+  : ptr_(nullptr)
+  {
+  }
+
+  /// @brief take a share of an object
+  explicit IntrusivePtr(T * ptr)
+  : ptr_(ptr)
+  {
+    if (ptr_) {
+      intrusive_ptr_add_ref(ptr_);
+    }
+  }
+
+  IntrusivePtr(const IntrusivePtr & rhs)
+  : ptr_(rhs.ptr_)
+  {
+    if (ptr_) {
+      intrusive_ptr_add_ref(ptr_);
+    }
+  }
+
+  template <class U>
+  IntrusivePtr(const IntrusivePtr<U> & rhs)
+  : ptr_(rhs.get())
+  {
+    if (ptr_) {
+      intrusive_ptr_add_ref(ptr_);
+    }
+  }
+
+  /// @brief take over rhs's share, leaving rhs empty
+  IntrusivePtr(IntrusivePtr && rhs)
+  : ptr_(rhs.ptr_)
+  {
+    rhs.ptr_ = nullptr;
+  }
+
+  ~IntrusivePtr()
+  {
+    if (ptr_) {
+      intrusive_ptr_release(ptr_);
+    }
+  }
+
+  IntrusivePtr & operator =(const IntrusivePtr & rhs)
+  {
+    IntrusivePtr(rhs).swap(*this);
+    return *this;
+  }
+
+  IntrusivePtr & operator =(IntrusivePtr && rhs)
+  {
+    IntrusivePtr(std::move(rhs)).swap(*this);
+    return *this;
+  }
+
+  /// @brief give up this share
+  void reset()
+  {
+    IntrusivePtr().swap(*this);
+  }
+
+  /// @brief give up this share and take a share of ptr
+  void reset(T * ptr)
+  {
+    IntrusivePtr(ptr).swap(*this);
+  }
+
+  void swap(IntrusivePtr & rhs)
+  {
+    std::swap(ptr_, rhs.ptr_);
+  }
+
+  T * get() const { return ptr_; }
+  T & operator *() const { return *ptr_; }
+  T * operator ->() const { return ptr_; }
+  explicit operator bool() const { return ptr_ != nullptr; }
+
+private:
+  T * ptr_;
+};
+
+/// @brief make a new object owned by an IntrusivePtr
+template <class T, class... Args>
+IntrusivePtr<T> make_intrusive(Args&&... args)
+{
+  return IntrusivePtr<T>(new T(std::forward<Args>(args)...));
+}
+
+template <class T, class U>
+inline bool operator ==(const IntrusivePtr<T> & lhs, const IntrusivePtr<U> & rhs)
+{
+  return lhs.get() == rhs.get();
+}
+
+template <class T, class U>
+inline bool operator !=(const IntrusivePtr<T> & lhs, const IntrusivePtr<U> & rhs)
+{
+  return lhs.get() != rhs.get();
+}
+
+template <class T, class U>
+inline bool operator <(const IntrusivePtr<T> & lhs, const IntrusivePtr<U> & rhs)
+{
+  return lhs.get() < rhs.get();
+}
+
+template <class T>
+inline bool operator ==(const IntrusivePtr<T> & lhs, std::nullptr_t)
+{
+  return lhs.get() == nullptr;
+}
+
+template <class T>
+inline bool operator !=(const IntrusivePtr<T> & lhs, std::nullptr_t)
+{
+  return lhs.get() != nullptr;
+}
+
+template <class T>
+inline bool operator ==(std::nullptr_t, const IntrusivePtr<T> & rhs)
+{
+  return rhs.get() == nullptr;
+}
+
+template <class T>
+inline bool operator !=(std::nullptr_t, const IntrusivePtr<T> & rhs)
+{
+  return rhs.get() != nullptr;
+}
+
+} }
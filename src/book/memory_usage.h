@@ -0,0 +1,91 @@
+// Copyright (c) 2017 Object Computing, Inc.
+// All rights reserved.
+// See the file license.txt for licensing information.
+#pragma once
+
+#include <string>
+#include <cstddef>
+
+namespace liquibook { namespace book {
+
+/// @brief Bytes held by a book or depth, by category.
+/// Heap figures are estimates computed from element counts and capacities
+/// using the node layout of common standard libraries.  They do not include
+/// allocator bookkeeping, nor anything the application's orders own.
+struct MemoryUsage {
+  /// @brief size of the object itself, including inline arrays
+  size_t object_bytes;
+  /// @brief heap used by containers for their own structure: tree and
+  /// list nodes, map keys, unused vector capacity, strings
+  size_t container_bytes;
+  /// @brief heap used by order trackers
+  size_t tracker_bytes;
+  /// @brief heap used by the callback buffers
+  size_t callback_bytes;
+
+  MemoryUsage()
+  : object_bytes(0),
+    container_bytes(0),
+    tracker_bytes(0),
+    callback_bytes(0)
+  {
+  }
+
+  /// @brief bytes held on the heap
+  size_t heap_bytes() const
+  {
+    return container_bytes + tracker_bytes + callback_bytes;
+  }
+
+  /// @brief all bytes, inline and heap
+  size_t total() const
+  {
+    return object_bytes + heap_bytes();
+  }
+
+  MemoryUsage & operator +=(const MemoryUsage & rhs)
+  {
+    object_bytes += rhs.object_bytes;
+    container_bytes += rhs.container_bytes;
+    tracker_bytes += rhs.tracker_bytes;
+    callback_bytes += rhs.callback_bytes;
+    return *this;
+  }
+
+  /// @brief round a size up to pointer alignment
+  static size_t aligned(size_t bytes)
+  {
+    return (bytes + sizeof(void *) - 1) & ~(sizeof(void *) - 1);
+  }
+
+  /// @brief estimated heap bytes for one node of a std::map, std::multimap
+  /// or std::set.  A red-black tree node holds a color and three links.
+  template <class Value>
+  static size_t tree_node_bytes()
+  {
+    return 4 * sizeof(void *) + aligned(sizeof(Value));
+  }
+
+  /// @brief estimated tree node overhead, excluding the value
+  static size_t tree_node_overhead()
+  {
+    return 4 * sizeof(void *);
+  }
+
+  /// @brief estimated heap bytes for one node of a std::list
+  template <class Value>
+  static size_t list_node_bytes()
+  {
+    return 2 * sizeof(void *) + aligned(sizeof(Value));
+  }
+
+  /// @brief estimated heap bytes held by a string.
+  /// Short strings are stored inside the string object.
+  static size_t string_bytes(const std::string & value)
+  {
+    return value.capacity() <= std::string().capacity()
+      ? 0 : value.capacity() + 1;
+  }
+};
+
+} }
@@ -6,11 +6,16 @@
 #include "version.h"
 #include "order_tracker.h"
 #include "callback.h"
+#include "event_buffer.h"
 #include "order_listener.h"
 #include "order_book_listener.h"
 #include "trade_listener.h"
 #include "comparable_price.h"
 #include "logger.h"
+#include "book_stats.h"
+#include "trace_ring.h"
+#include "memory_usage.h"
+#include "timestamp.h"
 
 #include <sstream>
 #include <map>
@@ -21,6 +26,12 @@
 #include <functional>
 #include <algorithm>
 
+// C++17 node handles let replace move a tracker between price levels
+// without reallocating its tree node.
+#if __cplusplus >= 201703L || (defined(_MSVC_LANG) && _MSVC_LANG >= 201703L)
+#define LIQUIBOOK_HAS_NODE_HANDLE
+#endif
+
 #ifdef LIQUIBOOK_IGNORES_DEPRECATED_CALLS
 #define COMPLAIN_ONCE(message)
 #else // LIQUIBOOK_IGNORES_DEPRECATED_CALLS
@@ -56,13 +67,21 @@ public:
   typedef TradeListener<MyClass > TypedTradeListener;
   typedef OrderBookListener<MyClass > TypedOrderBookListener;
   typedef std::vector<TypedCallback > Callbacks;
+  typedef EventBuffer<OrderPtr > Events;
   typedef std::multimap<ComparablePrice, Tracker> TrackerMap;
   typedef std::vector<Tracker> TrackerVec;
   // Keep this around briefly for compatibility.
   typedef TrackerMap Bids;
   typedef TrackerMap Asks;
 
-  typedef std::list<typename TrackerMap::iterator> DeferredMatches;
+  /// @brief A matched order set aside for later, and the container it is in.
+  struct DeferredMatch {
+    TrackerMap * orders;
+    typename TrackerMap::iterator entry;
+    DeferredMatch(TrackerMap * orders_, typename TrackerMap::iterator entry_)
+      : orders(orders_), entry(entry_) {}
+  };
+  typedef std::list<DeferredMatch> DeferredMatches;
 
   /// @brief construct
   OrderBook(const std::string & symbol = "unknown");
@@ -86,6 +105,19 @@ public:
   /// @brief let the application handle reporting errors.
   void set_logger(Logger * logger);
 
+  /// @brief stamp each add, cancel and replace with the time it reached
+  /// the book, for latency tracing.  Off by default, as it reads the
+  /// clock on every request.
+  void set_arrival_stamps(bool stamp) { stamp_arrivals_ = stamp; }
+
+  /// @brief when the request being handled, or the last one handled,
+  /// reached the book.  0 unless arrivals are stamped.
+  Timestamp arrival_time() const { return arrival_time_; }
+
+  /// @brief the callbacks this book builds, as Callback::CbInterest bits.
+  /// Those handled by the book itself plus those its listeners hear about.
+  uint32_t callback_interest() const { return callback_interest_; }
+
   /// @brief add an order to book
   /// @param order the order to add
   /// @param conditions special conditions on the order
@@ -116,12 +148,26 @@ public:
   /// The market price is normally the price at which the last trade happened.
   Price market_price()const;
 
-  /// @brief access the bids container
+  /// @brief access the bids container.
+  /// Holds limit orders only.  Resting market bids used to appear here, at
+  /// the front; they are now in marketBids(), so code that counts or walks
+  /// every bid must visit both.
   const TrackerMap& bids() const { return bids_; };
 
-  /// @brief access the asks container
+  /// @brief access the asks container.
+  /// Holds limit orders only.  Resting market asks used to appear here, at
+  /// the front; they are now in marketAsks(), so code that counts or walks
+  /// every ask must visit both.
   const TrackerMap& asks() const { return asks_; };
 
+  /// @brief access resting market bids, oldest first.
+  /// These match before any limit bid.
+  const TrackerMap& marketBids() const { return marketBids_; }
+
+  /// @brief access resting market asks, oldest first.
+  /// These match before any limit ask.
+  const TrackerMap& marketAsks() const { return marketAsks_; }
+
   /// @brief access stop bid orders
   const TrackerMap & stopBids() const { return stopBids_;}
 
@@ -141,6 +187,25 @@ public:
   /// @brief log the orders in the book.
   std::ostream & log(std::ostream & out) const;
 
+  /// @brief report the memory held by this book.
+  /// Derived books add the memory held by their own members.
+  virtual MemoryUsage memory_usage() const;
+
+#ifdef LIQUIBOOK_ENABLE_STATS
+  /// @brief access the hot path counters for this book.
+  /// May be read from a monitoring thread while the book is in use.
+  const OrderBookStats & stats() const { return stats_; }
+#endif // LIQUIBOOK_ENABLE_STATS
+
+#ifdef LIQUIBOOK_ENABLE_TRACE
+  /// @brief access the recent matching decisions for this book.
+  /// Not thread safe: read it on the thread that uses the book.
+  const TraceRing<> & trace() const { return trace_; }
+
+  /// @brief access the recent matching decisions for this book.
+  TraceRing<> & trace() { return trace_; }
+#endif // LIQUIBOOK_ENABLE_TRACE
+
 protected:
   /// @brief Internal method to process callbacks.
   /// Protected against recursive calls in case callbacks
@@ -150,26 +215,46 @@ protected:
   /// @brief perform an individual callback
   virtual void perform_callback(TypedCallback& cb);
 
+  /// @brief set the callbacks this class handles, apart from any listeners.
+  /// A derived class that overrides perform_callback or the on_* methods
+  /// must include the callbacks it handles.  OrderBook handles all of them.
+  /// @param interest Callback::CbInterest bits
+  void set_callback_interest(uint32_t interest);
+
+  /// @brief add to the callbacks this class handles.
+  /// @param interest Callback::CbInterest bits
+  void add_callback_interest(uint32_t interest);
+
+  /// @brief will a callback of this type be built?
+  bool wants_callback(typename TypedCallback::CbType type) const
+  {
+    return (callback_interest_ & (uint32_t(1) << type)) != 0;
+  }
+
   /// @brief match a new order to current orders
   /// @param inbound_order the inbound order
   /// @param inbound_price price of the inbound order
-  /// @param current_orders open orders
-  /// @param[OUT] deferred_aons AON orders from current_orders 
-  ///             that matched the inbound price, 
+  /// @param market_orders open market orders, matched first
+  /// @param current_orders open limit orders
+  /// @param[OUT] deferred_aons AON orders from market_orders or
+  ///             current_orders that matched the inbound price, 
   ///             but were not filled due to quantity
   /// @return true if a match occurred 
   virtual bool match_order(Tracker& inbound_order, 
     Price inbound_price, 
+    TrackerMap& market_orders,
     TrackerMap& current_orders,
     DeferredMatches & deferred_aons);
 
   bool match_aon_order(Tracker& inbound, 
     Price inbound_price, 
+    TrackerMap& market_orders,
     TrackerMap& current_orders,
     DeferredMatches & deferred_aons);
 
   bool match_regular_order(Tracker& inbound, 
     Price inbound_price, 
+    TrackerMap& market_orders,
     TrackerMap& current_orders,
     DeferredMatches & deferred_aons);
 
@@ -177,16 +262,15 @@ protected:
     Tracker& inbound,
     DeferredMatches & deferred_matches, 
     Quantity maxQty, // do not exceed
-    Quantity minQty, // must be at least
-    TrackerMap& current_orders);
+    Quantity minQty); // must be at least
 
   /// @brief see if any deferred All Or None orders can now execute.
-  /// @param aons iterators to the orders that might now match
-  /// @param deferredTrackers the container of the aons
-  /// @param marketTrackers the orders to check for matches
+  /// @param aons the orders that might now match
+  /// @param market_orders the market orders to check for matches
+  /// @param current_orders the limit orders to check for matches
   bool check_deferred_aons(DeferredMatches & aons, 
-    TrackerMap & deferredTrackers, 
-    TrackerMap & marketTrackers);
+    TrackerMap & market_orders, 
+    TrackerMap & current_orders);
 
   /// @brief perform fill on two orders
   /// @param inbound_tracker the new (or changed) order tracker
@@ -199,10 +283,12 @@ protected:
 
   /// @brief find an order in a container
   /// @param order is the the order we are looking for
+  /// @param[OUT] orders will point to the container holding the order
   /// @param[OUT] result will point to the entry in the container if we find a match
   /// @returns true: match, false: no match
   bool find_on_market(
     const OrderPtr& order,
+    TrackerMap*& orders,
     typename TrackerMap::iterator& result);
 
   /// @brief find stop order in a container.
@@ -261,7 +347,8 @@ protected:
 
   /// @brief callback for an order replace
   /// @param order the replaced order
-  /// @param size_delta the change to order quantity
+  /// @param current_qty the open quantity before the replace
+  /// @param new_qty the open quantity after the replace
   /// @param new_price the updated order price
   virtual void on_replace(const OrderPtr& order,
     Quantity current_qty, 
@@ -292,26 +379,62 @@ protected:
 
 
 private:
+    /// @brief match an order and rest what is left of it.
+    /// A resting order's tracker is moved into the book, leaving
+    /// inbound's quantities and conditions but not its order handle.
     bool submit_order(Tracker & inbound);
     bool add_order(Tracker& order_tracker, Price order_price);
+    /// @brief match an order against the other side of the book
+    bool match_inbound(Tracker& inbound, 
+      Price order_price,
+      DeferredMatches & deferred_aons);
+    /// @brief recheck deferred AONs once an order rests on a side
+    bool check_resting_aons(bool is_buy, DeferredMatches & deferred_aons);
+    /// @brief the container holding resting orders of a side and price
+    TrackerMap & resting_orders(bool is_buy, Price price);
+    /// @brief recompute the interest mask after a change of listeners
+    void update_callback_interest();
 private:
 
   std::string symbol_;
   TrackerMap bids_;
   TrackerMap asks_;
+  // Market orders rest apart from limit orders, in arrival order.  They
+  // share the limit containers' type, with every key equal and inserts
+  // hinted at the end, because the matching walk, DeferredMatch and
+  // find_on_market pass a (container, iterator) pair that may point into
+  // either; a list here would need a second iterator type through all of
+  // them.
+  TrackerMap marketBids_;
+  TrackerMap marketAsks_;
 
   TrackerMap stopBids_;
   TrackerMap stopAsks_;
   TrackerVec pendingOrders_;
 
-  Callbacks callbacks_;
-  Callbacks workingCallbacks_;
+  // Events from the current operation, and those being delivered
+  Events callbacks_;
+  Events workingCallbacks_;
   bool handling_callbacks_;
   TypedOrderListener* order_listener_;
   TypedTradeListener* trade_listener_;
   TypedOrderBookListener* order_book_listener_;
+  // Callbacks handled by this class, and those built for it and listeners
+  uint32_t own_interest_;
+  uint32_t callback_interest_;
   Logger * logger_;
   Price marketPrice_;
+  bool stamp_arrivals_;
+  Timestamp arrival_time_;
+#ifdef LIQUIBOOK_ENABLE_STATS
+  OrderBookStats stats_;
+  // Price levels traded through by the current inbound order
+  Price sweep_price_;
+  uint64_t sweep_levels_;
+#endif // LIQUIBOOK_ENABLE_STATS
+#ifdef LIQUIBOOK_ENABLE_TRACE
+  TraceRing<> trace_;
+#endif // LIQUIBOOK_ENABLE_TRACE
 };
 
 template <class OrderPtr>
@@ -321,11 +444,19 @@ OrderBook<OrderPtr>::OrderBook(const std::string & symbol)
   order_listener_(nullptr),
   trade_listener_(nullptr),
   order_book_listener_(nullptr),
+  own_interest_(TypedCallback::ci_all),
+  callback_interest_(TypedCallback::ci_all),
   logger_(nullptr),
-  marketPrice_(MARKET_ORDER_PRICE)
+  marketPrice_(MARKET_ORDER_PRICE),
+  stamp_arrivals_(false),
+  arrival_time_(0)
+#ifdef LIQUIBOOK_ENABLE_STATS
+  , sweep_price_(MARKET_ORDER_PRICE)
+  , sweep_levels_(0)
+#endif // LIQUIBOOK_ENABLE_STATS
 {
   callbacks_.reserve(16);  // Why 16?  Why not?  
-  workingCallbacks_.reserve(callbacks_.capacity());
+  workingCallbacks_.reserve(16);
 }
 
 template <class OrderPtr>
@@ -384,6 +515,7 @@ void
 OrderBook<OrderPtr>::set_order_listener(TypedOrderListener* listener)
 {
   order_listener_ = listener;
+  update_callback_interest();
 }
 
 template <class OrderPtr>
@@ -391,6 +523,7 @@ void
 OrderBook<OrderPtr>::set_trade_listener(TypedTradeListener* listener)
 {
   trade_listener_ = listener;
+  update_callback_interest();
 }
 
 template <class OrderPtr>
@@ -398,6 +531,43 @@ void
 OrderBook<OrderPtr>::set_order_book_listener(TypedOrderBookListener* listener)
 {
   order_book_listener_ = listener;
+  update_callback_interest();
+}
+
+template <class OrderPtr>
+void
+OrderBook<OrderPtr>::set_callback_interest(uint32_t interest)
+{
+  own_interest_ = interest;
+  update_callback_interest();
+}
+
+template <class OrderPtr>
+void
+OrderBook<OrderPtr>::add_callback_interest(uint32_t interest)
+{
+  own_interest_ |= interest;
+  update_callback_interest();
+}
+
+template <class OrderPtr>
+void
+OrderBook<OrderPtr>::update_callback_interest()
+{
+  uint32_t interest = own_interest_;
+  if(order_listener_)
+  {
+    interest |= TypedCallback::ci_order_events;
+  }
+  if(trade_listener_)
+  {
+    interest |= TypedCallback::ci_order_fill;
+  }
+  if(order_book_listener_)
+  {
+    interest |= TypedCallback::ci_book_update;
+  }
+  callback_interest_ = interest;
 }
 
 template <class OrderPtr>
@@ -405,42 +575,71 @@ bool
 OrderBook<OrderPtr>::add(const OrderPtr& order, OrderConditions conditions)
 {
   bool matched = false;
+  LIQUIBOOK_TRACE_ONLY(Quantity open_qty = 0;)
+  if (stamp_arrivals_) {
+    arrival_time_ = timestamp_now();
+  }
+  LIQUIBOOK_STAT_ADD(stats_.operations, 1);
+  LIQUIBOOK_TRACE(te_add_begin, order->price(), order->order_qty(), 0);
 
   // If the order is invalid, ignore it
   if (order->order_qty() == 0) {
-    callbacks_.push_back(TypedCallback::reject(order, "size must be positive"));
+    if(wants_callback(TypedCallback::cb_order_reject))
+    {
+      callbacks_.reject(order, "size must be positive");
+    }
   }
   else 
   {
+    LIQUIBOOK_STAT_ADD(stats_.orders_added, 1);
     Tracker inbound(order, conditions);
     if(inbound.ptr()->stop_price() != 0 && add_stop_order(inbound))
     {
       // The order has been added to stops
-      callbacks_.push_back(TypedCallback::accept_stop(order));
+      if(wants_callback(TypedCallback::cb_order_accept_stop))
+      {
+        callbacks_.accept_stop(order);
+      }
     }
     else
     {
-      size_t accept_cb_index = callbacks_.size();
-      callbacks_.push_back(TypedCallback::accept(order));
+      bool accept_cb = wants_callback(TypedCallback::cb_order_accept);
+      size_t accept_qty_slot = 0;
+      if(accept_cb)
+      {
+        accept_qty_slot = callbacks_.accept(order);
+      }
+      // If it rests, inbound's order handle is moved into the book,
+      // but its quantities are still valid here.
       matched = submit_order(inbound);
       // Note the filled qty in the accept callback
-      callbacks_[accept_cb_index].quantity = inbound.filled_qty();
+      if(accept_cb)
+      {
+        callbacks_.set_quantity(accept_qty_slot,
+          order->order_qty() - inbound.open_qty());
+      }
 
       // Cancel any unfilled IOC order
-      if (inbound.immediate_or_cancel() && !inbound.filled()) 
+      if (inbound.immediate_or_cancel() && !inbound.filled() &&
+        wants_callback(TypedCallback::cb_order_cancel))
       {
         // NOTE - this may need he actual open qty???
-        callbacks_.push_back(TypedCallback::cancel(order, 0));
+        callbacks_.cancel(order, 0);
       }
     }
+    LIQUIBOOK_TRACE_ONLY(open_qty = inbound.open_qty();)
     // If adding this order triggered any stops
     // handle those stops now
     while(!pendingOrders_.empty())
     {
       submit_pending_orders();
     }
-    callbacks_.push_back(TypedCallback::book_update(this));
+    if(wants_callback(TypedCallback::cb_book_update))
+    {
+      callbacks_.book_update();
+    }
   }
+  LIQUIBOOK_TRACE(te_add_end, order->price(), open_qty, matched ? 1 : 0);
   callback_now();
   return matched;
 }
@@ -451,18 +650,24 @@ OrderBook<OrderPtr>::cancel(const OrderPtr& order)
 {
   bool found = false;
   bool foundStop = false;
-  Quantity open_qty;
+  Quantity open_qty = 0;
+  if (stamp_arrivals_) {
+    arrival_time_ = timestamp_now();
+  }
+  LIQUIBOOK_STAT_ADD(stats_.operations, 1);
+  LIQUIBOOK_TRACE(te_cancel_begin, order->price(), 0, 0);
+  TrackerMap * orders;
+  typename TrackerMap::iterator pos;
+  if (find_on_market(order, orders, pos)) {
+    open_qty = pos->second.open_qty();
+    // Remove from container for cancel
+    orders->erase(pos);
+    found = true;
+  }
   // If the cancel is a buy order
-  if (order->is_buy()) {
+  else if (order->is_buy()) {
     typename TrackerMap::iterator bid;
-    find_on_market(order, bid);
-    if (bid != bids_.end()) {
-      open_qty = bid->second.open_qty();
-      // Remove from container for cancel
-      bids_.erase(bid);
-      found = true;
-    }
-    else if (order->stop_price()) {
+    if (order->stop_price()) {
       find_in_stop_orders(order, bid);
       if (bid != stopBids_.end()) {
         stopBids_.erase(bid);
@@ -472,14 +677,7 @@ OrderBook<OrderPtr>::cancel(const OrderPtr& order)
   // Else the cancel is a sell order
   } else {
     typename TrackerMap::iterator ask;
-    find_on_market(order, ask);
-    if (ask != asks_.end()) {
-      open_qty = ask->second.open_qty();
-      // Remove from container for cancel
-      asks_.erase(ask);
-      found = true;
-    }
-    else if (order->stop_price()) {
+    if (order->stop_price()) {
       find_in_stop_orders(order, ask);
       if (ask != stopAsks_.end()) {
         stopAsks_.erase(ask);
@@ -487,18 +685,29 @@ OrderBook<OrderPtr>::cancel(const OrderPtr& order)
       }
     }
   } 
+  if (found || foundStop) {
+    LIQUIBOOK_STAT_ADD(stats_.orders_cancelled, 1);
+  }
   // If the cancel was found, issue callback
   if (found) {
-    callbacks_.push_back(TypedCallback::cancel(order, open_qty));
-    callbacks_.push_back(TypedCallback::book_update(this));
+    if(wants_callback(TypedCallback::cb_order_cancel))
+    {
+      callbacks_.cancel(order, open_qty);
+    }
   }
   else if (foundStop) {
-    callbacks_.push_back(TypedCallback::cancel_stop(order));
-    callbacks_.push_back(TypedCallback::book_update(this));
+    if(wants_callback(TypedCallback::cb_order_cancel_stop))
+    {
+      callbacks_.cancel_stop(order);
+    }
+  }
+  else if(wants_callback(TypedCallback::cb_order_cancel_reject)) {
+    callbacks_.cancel_reject(order, "not found");
   }
-  else {
-    callbacks_.push_back(TypedCallback::cancel_reject(order, "not found"));
+  if ((found || foundStop) && wants_callback(TypedCallback::cb_book_update)) {
+    callbacks_.book_update();
   }
+  LIQUIBOOK_TRACE(te_cancel_end, order->price(), open_qty, 0);
   callback_now();
 }
 
@@ -511,13 +720,17 @@ OrderBook<OrderPtr>::replace(
 {
   bool matched = false;
   bool price_change = new_price && (new_price != order->price());
+  if (stamp_arrivals_) {
+    arrival_time_ = timestamp_now();
+  }
+  LIQUIBOOK_STAT_ADD(stats_.operations, 1);
 
   Price price = (new_price == PRICE_UNCHANGED) ? order->price() : new_price;
+  LIQUIBOOK_TRACE(te_replace_begin, price, 0, uint32_t(size_delta));
 
-  // If the order to replace is a buy order
-  TrackerMap & market = order->is_buy() ? bids_ : asks_;
+  TrackerMap * market;
   typename TrackerMap::iterator pos;
-  if(find_on_market(order, pos))
+  if(find_on_market(order, market, pos))
   {
     // If this is a valid replace
     const Tracker& tracker = pos->second;
@@ -530,32 +743,69 @@ OrderBook<OrderPtr>::replace(
       {
         // if there is nothing to get rid of
         // Reject the replace
-        callbacks_.push_back(TypedCallback::replace_reject(tracker.ptr(), 
-          "order is already filled"));
+        if(wants_callback(TypedCallback::cb_order_replace_reject))
+        {
+          callbacks_.replace_reject(tracker.ptr(),
+            "order is already filled");
+        }
+        LIQUIBOOK_TRACE(te_replace_end, price, 0, 0);
         return false;
       }
     }
 
     // Accept the replace
-    callbacks_.push_back(
-        TypedCallback::replace(order, pos->second.open_qty(), size_delta, 
-                                price));
+    LIQUIBOOK_STAT_ADD(stats_.orders_replaced, 1);
+    if(wants_callback(TypedCallback::cb_order_replace))
+    {
+      callbacks_.replace(order, pos->second.open_qty(), size_delta, price);
+    }
     Quantity new_open_qty = pos->second.open_qty() + size_delta;
     pos->second.change_qty(size_delta);  // Update my copy
     // If the size change will close the order
     if (!new_open_qty) 
     {
       // Cancel with NO open qty (should be zero after replace)
-      callbacks_.push_back(TypedCallback::cancel(order, 0));
-      market.erase(pos); // Remove order
+      if(wants_callback(TypedCallback::cb_order_cancel))
+      {
+        callbacks_.cancel(order, 0);
+      }
+      market->erase(pos); // Remove order
     } 
+    else if (!price_change && size_delta <= 0 && !pos->second.all_or_none())
+    {
+      // A smaller regular order at the same price cannot trade,
+      // so it keeps its place in the queue.
+    }
     else 
     {
       // Else rematch the new order - there could be a price change
       // or size change - that could cause all or none match
-      auto order = pos->second;
-      market.erase(pos); // Remove old order order
+#ifdef LIQUIBOOK_HAS_NODE_HANDLE
+      // Move the tree node rather than copying the tracker into a new one
+      auto node = market->extract(pos);
+      Tracker & tracker = node.mapped();
+      DeferredMatches deferred_aons;
+      matched = match_inbound(tracker, price, deferred_aons);
+      if (tracker.open_qty() && !tracker.immediate_or_cancel())
+      {
+        bool is_buy = tracker.is_buy();
+        node.key() = ComparablePrice(is_buy, price);
+        TrackerMap & orders = resting_orders(is_buy, price);
+        if (price == MARKET_ORDER_PRICE) {
+          orders.insert(orders.end(), std::move(node));
+        } else {
+          orders.insert(std::move(node));
+        }
+        if(check_resting_aons(is_buy, deferred_aons))
+        {
+          matched = true;
+        }
+      }
+#else
+      Tracker order(std::move(pos->second));
+      market->erase(pos); // Remove old order order
       matched = add_order(order, price); // Add order
+#endif // LIQUIBOOK_HAS_NODE_HANDLE
     }
     // If replace any order this order triggered any trades
     // which triggered any stops
@@ -564,14 +814,17 @@ OrderBook<OrderPtr>::replace(
     {
       submit_pending_orders();
     }
-    callbacks_.push_back(TypedCallback::book_update(this));
+    if(wants_callback(TypedCallback::cb_book_update))
+    {
+      callbacks_.book_update();
+    }
   }
-  else
+  else if(wants_callback(TypedCallback::cb_order_replace_reject))
   {
     // not found
-    callbacks_.push_back(
-          TypedCallback::replace_reject(order, "not found"));
+    callbacks_.replace_reject(order, "not found");
   }
+  LIQUIBOOK_TRACE(te_replace_end, price, 0, matched ? 1 : 0);
   callback_now();
   return matched;
 }
@@ -580,7 +833,7 @@ template <class OrderPtr>
 bool
 OrderBook<OrderPtr>::add_stop_order(Tracker & tracker)
 {
-  bool isBuy = tracker.ptr()->is_buy();
+  bool isBuy = tracker.is_buy();
   ComparablePrice key(isBuy, tracker.ptr()->stop_price());
   // if the market price is a better deal then the stop price, it's not time to panic
   bool isStopped = key < marketPrice_;
@@ -622,19 +875,33 @@ OrderBook<OrderPtr>::submit_pending_orders()
 {
   TrackerVec pending;
   pending.swap(pendingOrders_);
+  LIQUIBOOK_TRACE(te_pending_begin, 0, 0, uint32_t(pending.size()));
   for(auto pos = pending.begin(); pos != pending.end(); ++pos)
   {
     Tracker & tracker = *pos;
-    submit_order(tracker);
-    callbacks_.push_back(TypedCallback::trigger_stop(tracker.ptr()));
+    LIQUIBOOK_STAT_ADD(stats_.stops_triggered, 1);
+    LIQUIBOOK_TRACE(te_pending_submit, tracker.price(),
+      tracker.open_qty(), 0);
+    if(wants_callback(TypedCallback::cb_order_trigger_stop))
+    {
+      // submit_order may move the handle out of the tracker
+      OrderPtr order = tracker.ptr();
+      submit_order(tracker);
+      callbacks_.trigger_stop(order);
+    }
+    else
+    {
+      submit_order(tracker);
+    }
   }
+  LIQUIBOOK_TRACE(te_pending_end, 0, 0, 0);
 }
 
 template <class OrderPtr>
 bool
 OrderBook<OrderPtr>::submit_order(Tracker & inbound)
 {
-  Price order_price = inbound.ptr()->price();
+  Price order_price = inbound.price();
   return add_order(inbound, order_price);
 }
 
@@ -642,12 +909,15 @@ template <class OrderPtr>
 bool
 OrderBook<OrderPtr>::find_on_market(
   const OrderPtr& order,
+  TrackerMap*& orders,
   typename TrackerMap::iterator& result)
 {
   const ComparablePrice key(order->is_buy(), order->price());
-  TrackerMap & sideMap = order->is_buy() ? bids_ : asks_;
+  orders = &resting_orders(order->is_buy(), order->price());
+  TrackerMap & sideMap = *orders;
 
   for (result = sideMap.find(key); result != sideMap.end(); ++result) {
+    LIQUIBOOK_STAT_ADD(stats_.trackers_scanned, 1);
     // If this is the correct bid
     if (result->second.ptr() == order) 
     {
@@ -695,65 +965,111 @@ template <class OrderPtr>
 bool
 OrderBook<OrderPtr>::add_order(Tracker& inbound, Price order_price)
 {
-  bool matched = false;
-  OrderPtr& order = inbound.ptr();
   DeferredMatches deferred_aons;
-  // Try to match with current orders
-  if (order->is_buy()) {
-    matched = match_order(inbound, order_price, asks_, deferred_aons);
-  } else {
-    matched = match_order(inbound, order_price, bids_, deferred_aons);
-  }
+  bool matched = match_inbound(inbound, order_price, deferred_aons);
 
   // If order has remaining open quantity and is not immediate or cancel
   if (inbound.open_qty() && !inbound.immediate_or_cancel()) {
-    // If this is a buy order
-    if (order->is_buy()) 
-    {
-      // Insert into bids
-      bids_.insert(std::make_pair(ComparablePrice(true, order_price), inbound));
-      // and see if that satisfies any ask orders
-      if(check_deferred_aons(deferred_aons, asks_, bids_))
-      {
-        matched = true;
-      }
-    } 
-    else 
+    bool is_buy = inbound.is_buy();
+    TrackerMap & orders = resting_orders(is_buy, order_price);
+    // The book takes over the order handle
+    if (order_price == MARKET_ORDER_PRICE) {
+      // Market orders queue at the back
+      orders.emplace_hint(orders.end(),
+        ComparablePrice(is_buy, order_price), std::move(inbound));
+    } else {
+      orders.emplace(ComparablePrice(is_buy, order_price), 
+        std::move(inbound));
+    }
+    // and see if that satisfies any orders on the other side
+    if(check_resting_aons(is_buy, deferred_aons))
     {
-      // Else this is a sell order
-      // Insert into asks
-      asks_.insert(std::make_pair(ComparablePrice(false, order_price), inbound));
-      if(check_deferred_aons(deferred_aons, bids_, asks_))
-      {
-        matched = true;
-      }
+      matched = true;
     }
   }
   return matched;
 }
 
+template <class OrderPtr>
+bool
+OrderBook<OrderPtr>::match_inbound(Tracker& inbound, 
+  Price order_price,
+  DeferredMatches & deferred_aons)
+{
+  bool matched = false;
+  // The tracker carries the price at which the order will rest
+  inbound.set_price(order_price);
+  LIQUIBOOK_STATS_ONLY(sweep_levels_ = 0;)
+  // Try to match with current orders
+  if (inbound.is_buy()) {
+    matched = match_order(inbound, order_price, marketAsks_, asks_,
+      deferred_aons);
+  } else {
+    matched = match_order(inbound, order_price, marketBids_, bids_,
+      deferred_aons);
+  }
+#ifdef LIQUIBOOK_ENABLE_STATS
+  if (sweep_levels_ != 0) {
+    stats_.aggressive_orders.add(1);
+    stats_.levels_swept.add(sweep_levels_);
+  }
+#endif // LIQUIBOOK_ENABLE_STATS
+  return matched;
+}
+
+template <class OrderPtr>
+bool
+OrderBook<OrderPtr>::check_resting_aons(bool is_buy,
+  DeferredMatches & deferred_aons)
+{
+  if (is_buy) {
+    return check_deferred_aons(deferred_aons, marketBids_, bids_);
+  }
+  return check_deferred_aons(deferred_aons, marketAsks_, asks_);
+}
+
+template <class OrderPtr>
+typename OrderBook<OrderPtr>::TrackerMap &
+OrderBook<OrderPtr>::resting_orders(bool is_buy, Price price)
+{
+  if (price == MARKET_ORDER_PRICE) {
+    return is_buy ? marketBids_ : marketAsks_;
+  }
+  return is_buy ? bids_ : asks_;
+}
+
 template <class OrderPtr>
 bool
 OrderBook<OrderPtr>::check_deferred_aons(DeferredMatches & aons, 
-  TrackerMap & deferredTrackers, 
-  TrackerMap & marketTrackers)
+  TrackerMap & market_orders, 
+  TrackerMap & current_orders)
 {
   bool result = false;
+  if(aons.empty())
+  {
+    // Most adds defer nothing; keep them out of the trace
+    return result;
+  }
   DeferredMatches ignoredAons;
 
+  LIQUIBOOK_TRACE(te_check_deferred_begin, 0, 0, uint32_t(aons.size()));
   for(auto pos = aons.begin(); pos != aons.end(); ++pos)
   {
-    auto entry = *pos;
+    auto entry = pos->entry;
+    LIQUIBOOK_STAT_ADD(stats_.deferred_aon_checks, 1);
     ComparablePrice current_price = entry->first;
     Tracker & tracker = entry->second;
     bool matched = match_order(tracker, current_price.price(), 
-      marketTrackers, ignoredAons);
+      market_orders, current_orders, ignoredAons);
+    LIQUIBOOK_TRACE(te_check_deferred_aon, current_price.price(),
+      tracker.open_qty(), matched ? 1 : 0);
     result |= matched;
     if(tracker.filled())
     {
-      deferredTrackers.erase(entry);
+      pos->orders->erase(entry);
     }
   }
+  LIQUIBOOK_TRACE(te_check_deferred_end, 0, 0, 0);
   return result;
 }
 
@@ -765,20 +1081,24 @@ template <class OrderPtr>
 bool
 OrderBook<OrderPtr>::match_order(Tracker& inbound, 
   Price inbound_price, 
+  TrackerMap& market_orders,
   TrackerMap& current_orders,
   DeferredMatches & deferred_aons)
 {
   if(inbound.all_or_none())
   {
-    return match_aon_order(inbound, inbound_price, current_orders, deferred_aons);
+    return match_aon_order(inbound, inbound_price, market_orders,
+      current_orders, deferred_aons);
   }
-  return match_regular_order(inbound, inbound_price, current_orders, deferred_aons);
+  return match_regular_order(inbound, inbound_price, market_orders,
+    current_orders, deferred_aons);
 }
 
 template <class OrderPtr>
 bool
 OrderBook<OrderPtr>::match_regular_order(Tracker& inbound, 
   Price inbound_price, 
+  TrackerMap& market_orders,
   TrackerMap& current_orders,
   DeferredMatches & deferred_aons)
 {
@@ -790,10 +1110,25 @@ OrderBook<OrderPtr>::match_regular_order(Tracker& inbound,
   // loop
   bool matched = false;
   Quantity inbound_qty = inbound.open_qty();
-  typename TrackerMap::iterator pos = current_orders.begin(); 
-  while(pos != current_orders.end() && !inbound.filled()) 
+  LIQUIBOOK_TRACE_ONLY(uint32_t iterations = 0;)
+  LIQUIBOOK_TRACE(te_match_regular_begin, inbound_price, inbound_qty, 0);
+  // Market orders match any price, so walk them first, then limit orders
+  TrackerMap * orders = &market_orders;
+  typename TrackerMap::iterator pos = orders->begin(); 
+  while(!inbound.filled()) 
   {
+    if(pos == orders->end())
+    {
+      if(orders == &current_orders)
+      {
+        break;
+      }
+      orders = &current_orders;
+      pos = orders->begin();
+      continue;
+    }
     auto entry = pos++;
+    LIQUIBOOK_TRACE_ONLY(++iterations;)
     const ComparablePrice & current_price = entry->first;
     if(!current_price.matches(inbound_price))
     {
@@ -818,7 +1153,7 @@ OrderBook<OrderPtr>::match_regular_order(Tracker& inbound,
         {
           matched = true;
           // assert traded == current_quantity
-          current_orders.erase(entry);
+          orders->erase(entry);
           inbound_qty -= traded;
         }
       }
@@ -826,7 +1161,7 @@ OrderBook<OrderPtr>::match_regular_order(Tracker& inbound,
       {
         // current is AON, inbound is not AON.
         // inbound is not enough to satisfy current order's AON
-        deferred_aons.push_back(entry);
+        deferred_aons.push_back(DeferredMatch(orders, entry));
       }
     }
     else 
@@ -838,12 +1173,14 @@ OrderBook<OrderPtr>::match_regular_order(Tracker& inbound,
         matched = true;
         if(current_order.filled())
         {
-          current_orders.erase(entry);
+          orders->erase(entry);
         }
         inbound_qty -= traded;
       }
     }
   }
+  LIQUIBOOK_TRACE(te_match_regular_end, inbound_price, inbound.open_qty(),
+    iterations);
   return matched;
 }
 
@@ -851,6 +1188,7 @@ template <class OrderPtr>
 bool
 OrderBook<OrderPtr>::match_aon_order(Tracker& inbound, 
   Price inbound_price, 
+  TrackerMap& market_orders,
   TrackerMap& current_orders,
   DeferredMatches & deferred_aons)
 {
@@ -860,10 +1198,25 @@ OrderBook<OrderPtr>::match_aon_order(Tracker& inbound,
 
   DeferredMatches deferred_matches;
 
-  typename TrackerMap::iterator pos = current_orders.begin(); 
-  while(pos != current_orders.end() && !inbound.filled()) 
+  LIQUIBOOK_TRACE_ONLY(uint32_t iterations = 0;)
+  LIQUIBOOK_TRACE(te_match_aon_begin, inbound_price, inbound_qty, 0);
+  // Market orders match any price, so walk them first, then limit orders
+  TrackerMap * orders = &market_orders;
+  typename TrackerMap::iterator pos = orders->begin(); 
+  while(!inbound.filled()) 
   {
+    if(pos == orders->end())
+    {
+      if(orders == &current_orders)
+      {
+        break;
+      }
+      orders = &current_orders;
+      pos = orders->begin();
+      continue;
+    }
     auto entry = pos++;
+    LIQUIBOOK_TRACE_ONLY(++iterations;)
     const ComparablePrice current_price = entry->first;
     if(!current_price.matches(inbound_price))
     {
@@ -894,18 +1247,19 @@ OrderBook<OrderPtr>::match_aon_order(Tracker& inbound,
             inbound, 
             deferred_matches, 
             maxQty, 
-            maxQty, 
-            current_orders))
+            maxQty))
           {
             inbound_qty -= maxQty;
             // finally execute this trade
+            LIQUIBOOK_TRACE(te_aon_aon_trade, current_price.price(),
+              current_quantity, 0);
             Quantity traded = create_trade(inbound, current_order);
             if(traded > 0)
             {
               // assert traded == current_quantity
               inbound_qty -= traded;
               matched = true;
-              current_orders.erase(entry);
+              orders->erase(entry);
             }
           }
         }
@@ -913,14 +1267,18 @@ OrderBook<OrderPtr>::match_aon_order(Tracker& inbound,
         {
           // AON::AON -- inbound could satisfy current, but
           // current cannot satisfy inbound;
+          LIQUIBOOK_TRACE(te_aon_aon_defer, current_price.price(),
+            current_quantity, 0);
           deferred_qty += current_quantity;
-          deferred_matches.push_back(entry);
+          deferred_matches.push_back(DeferredMatch(orders, entry));
         }
       }
       else
       {
         // AON::AON -- inbound cannot satisfy current's AON
-        deferred_aons.push_back(entry);
+        LIQUIBOOK_TRACE(te_aon_defer_current, current_price.price(),
+          current_quantity, 0);
+        deferred_aons.push_back(DeferredMatch(orders, entry));
       }
     }
     else 
@@ -934,10 +1292,11 @@ OrderBook<OrderPtr>::match_aon_order(Tracker& inbound,
           inbound, 
           deferred_matches, 
           inbound_qty, // create as many as possible
-          (inbound_qty > current_quantity) ? (inbound_qty - current_quantity) : 0, // but we need at least this many
-          current_orders);
+          (inbound_qty > current_quantity) ? (inbound_qty - current_quantity) : 0); // but we need at least this many
         if(inbound_qty <= current_quantity + traded)
         {
+          LIQUIBOOK_TRACE(te_aon_regular_trade, current_price.price(),
+            current_quantity, 0);
           traded += create_trade(inbound, current_order);
           if(traded > 0)
           {
@@ -946,7 +1305,7 @@ OrderBook<OrderPtr>::match_aon_order(Tracker& inbound,
           }
           if(current_order.filled())
           {
-            current_orders.erase(entry);
+            orders->erase(entry);
           }
         }
       }
@@ -954,11 +1313,15 @@ OrderBook<OrderPtr>::match_aon_order(Tracker& inbound,
       {
         // not enough to satisfy inbound, yet.
         // remember the current order for later use
+        LIQUIBOOK_TRACE(te_aon_regular_defer, current_price.price(),
+          current_quantity, 0);
         deferred_qty += current_quantity;
-        deferred_matches.push_back(entry);
+        deferred_matches.push_back(DeferredMatch(orders, entry));
       }
     }
   }
+  LIQUIBOOK_TRACE(te_match_aon_end, inbound_price, inbound.open_qty(),
+    iterations);
   return matched;
 }
 namespace {
@@ -971,8 +1334,7 @@ OrderBook<OrderPtr>::try_create_deferred_trades(
   Tracker& inbound,
   DeferredMatches & deferred_matches, 
   Quantity maxQty, // do not exceed
-  Quantity minQty, // must be at least
-  TrackerMap& current_orders)
+  Quantity minQty) // must be at least
 {
   Quantity traded = 0;
   // create a vector of proposed trade quantities:
@@ -984,7 +1346,7 @@ OrderBook<OrderPtr>::try_create_deferred_trades(
     foundQty < maxQty && pos != deferred_matches.end();
     ++index)
   {
-    auto entry = *pos++;
+    auto entry = (pos++)->entry;
     Tracker & tracker = entry->second;
     Quantity qty = tracker.open_qty();
     // if this would put us over the limit
@@ -1004,6 +1366,8 @@ OrderBook<OrderPtr>::try_create_deferred_trades(
     fills[index] = qty;
   }
 
+  LIQUIBOOK_TRACE(te_deferred_trades, 0, foundQty,
+    uint32_t(deferred_matches.size()));
   if(foundQty >= minQty && foundQty <= maxQty)
   {
     // pass through deferred matches again, doing the trades.
@@ -1012,12 +1376,13 @@ OrderBook<OrderPtr>::try_create_deferred_trades(
       traded < foundQty && pos != deferred_matches.end();
       ++index)
     {
-      auto entry = *pos++;
+      TrackerMap * orders = pos->orders;
+      auto entry = (pos++)->entry;
       Tracker & tracker = entry->second;
       traded += create_trade(inbound, tracker, fills[index]);
       if(tracker.filled())
       {
-        current_orders.erase(entry);
+        orders->erase(entry);
       }
     }
   }
@@ -1030,10 +1395,10 @@ OrderBook<OrderPtr>::create_trade(Tracker& inbound_tracker,
                                   Tracker& current_tracker,
                                   Quantity maxQuantity)
 {
-  Price cross_price = current_tracker.ptr()->price();
+  Price cross_price = current_tracker.price();
   // If current order is a market order, cross at inbound price
   if (MARKET_ORDER_PRICE == cross_price) {
-    cross_price = inbound_tracker.ptr()->price();
+    cross_price = inbound_tracker.price();
   }
   if(MARKET_ORDER_PRICE == cross_price)
   {
@@ -1053,23 +1418,36 @@ OrderBook<OrderPtr>::create_trade(Tracker& inbound_tracker,
     inbound_tracker.fill(fill_qty);
     current_tracker.fill(fill_qty);
     set_market_price(cross_price);
-
-    typename TypedCallback::FillFlags fill_flags = 
-                                TypedCallback::ff_neither_filled;
-    if (!inbound_tracker.open_qty()) {
-      fill_flags = (typename TypedCallback::FillFlags)(
-                       fill_flags | TypedCallback::ff_inbound_filled);
-    }
-    if (!current_tracker.open_qty()) {
-      fill_flags = (typename TypedCallback::FillFlags)(
-                       fill_flags | TypedCallback::ff_matched_filled);
+    LIQUIBOOK_TRACE(te_fill, cross_price, fill_qty, 0);
+#ifdef LIQUIBOOK_ENABLE_STATS
+    stats_.fills.add(1);
+    // Count each resting price level the inbound order trades through
+    Price level_price = current_tracker.price();
+    if (sweep_levels_ == 0 || level_price != sweep_price_) {
+      sweep_price_ = level_price;
+      ++sweep_levels_;
     }
+#endif // LIQUIBOOK_ENABLE_STATS
 
-    callbacks_.push_back(TypedCallback::fill(inbound_tracker.ptr(),
-                                             current_tracker.ptr(),
-                                             fill_qty,
-                                             cross_price,
-                                             fill_flags));
+    if(wants_callback(TypedCallback::cb_order_fill))
+    {
+      typename TypedCallback::FillFlags fill_flags = 
+                                  TypedCallback::ff_neither_filled;
+      if (!inbound_tracker.open_qty()) {
+        fill_flags = (typename TypedCallback::FillFlags)(
+                         fill_flags | TypedCallback::ff_inbound_filled);
+      }
+      if (!current_tracker.open_qty()) {
+        fill_flags = (typename TypedCallback::FillFlags)(
+                         fill_flags | TypedCallback::ff_matched_filled);
+      }
+
+      callbacks_.fill(inbound_tracker.ptr(),
+                      current_tracker.ptr(),
+                      fill_qty,
+                      cross_price,
+                      fill_flags);
+    }
   }
   return fill_qty;
 }
@@ -1105,13 +1483,12 @@ OrderBook<OrderPtr>::callback_now()
     // new callbacks are generated by the application code.
     while(!callbacks_.empty())
     {
-      // if we needed more entries, be sure that both containers have them.
-      workingCallbacks_.reserve(callbacks_.capacity());
       workingCallbacks_.swap(callbacks_);
-      for (auto cb = workingCallbacks_.begin(); cb != workingCallbacks_.end(); ++cb) {
+      LIQUIBOOK_STAT_ADD(stats_.callbacks_generated, workingCallbacks_.size());
+      workingCallbacks_.drain([this](TypedCallback & cb) {
         try
         {
-          perform_callback(*cb);
+          perform_callback(cb);
         }
         catch(const std::exception & ex)
         {
@@ -1135,8 +1512,7 @@ OrderBook<OrderPtr>::callback_now()
             std::cerr << "Caught unknown exception during callback" << std::endl;
           }
         }
-      }
-      workingCallbacks_.clear();
+      });
     }
     handling_callbacks_ = false;
   }
@@ -1218,9 +1594,10 @@ OrderBook<OrderPtr>::perform_callback(TypedCallback& cb)
       }
       break;
     case TypedCallback::cb_order_replace:
+      // The depth holds the open quantity, not the original order size
       on_replace(cb.order, 
-        cb.order->order_qty(), 
-        cb.order->order_qty() + cb.delta,
+        cb.quantity, 
+        cb.quantity + cb.delta,
         cb.price);
       if(order_listener_)
       {
@@ -1253,6 +1630,30 @@ OrderBook<OrderPtr>::perform_callback(TypedCallback& cb)
   }
 }
 
+template <class OrderPtr>
+MemoryUsage
+OrderBook<OrderPtr>::memory_usage() const
+{
+  typedef typename TrackerMap::value_type Entry;
+  MemoryUsage usage;
+  usage.object_bytes = sizeof(*this);
+
+  // Tree nodes hold the price key and the tracker
+  size_t entries = bids_.size() + asks_.size() +
+    marketBids_.size() + marketAsks_.size() +
+    stopBids_.size() + stopAsks_.size();
+  usage.tracker_bytes = entries * sizeof(Tracker) +
+    pendingOrders_.size() * sizeof(Tracker);
+  usage.container_bytes = 
+    entries * (MemoryUsage::tree_node_bytes<Entry>() - sizeof(Tracker)) +
+    (pendingOrders_.capacity() - pendingOrders_.size()) * sizeof(Tracker) +
+    MemoryUsage::string_bytes(symbol_);
+
+  usage.callback_bytes = 
+    callbacks_.memory_bytes() + workingCallbacks_.memory_bytes();
+  return usage;
+}
+
 template <class OrderPtr>
 std::ostream &
 OrderBook<OrderPtr>::log(std::ostream & out) const
@@ -1261,7 +1662,15 @@ OrderBook<OrderPtr>::log(std::ostream & out) const
     out << "  Ask " << ask->second.open_qty() << " @ " << ask->first
                           << std::endl;
   }
+  for(auto ask = marketAsks_.rbegin(); ask != marketAsks_.rend(); ++ask) {
+    out << "  Ask " << ask->second.open_qty() << " @ " << ask->first
+                          << std::endl;
+  }
 
+  for(auto bid = marketBids_.begin(); bid != marketBids_.end(); ++bid) {
+    out << "  Bid " << bid->second.open_qty() << " @ " << bid->first
+                          << std::endl;
+  }
   for(auto bid = bids_.begin(); bid != bids_.end(); ++bid) {
     out << "  Bid " << bid->second.open_qty() << " @ " << bid->first
                           << std::endl;
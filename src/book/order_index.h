@@ -0,0 +1,178 @@
+// Copyright (c) 2017 Object Computing, Inc.
+// All rights reserved.
+// See the file license.txt for licensing information.
+#pragma once
+
+#include "types.h"
+#include <stdexcept>
+#include <vector>
+#include <utility>
+
+namespace liquibook { namespace book {
+
+/// @brief Open addressing hash table from numeric order id to Value.
+///
+/// Entries live in one flat array probed linearly from the id's hash, so
+/// a lookup usually touches a single cache line.  The table doubles when
+/// it is half full.  Erasing shifts the following entries back rather
+/// than leaving tombstones, so lookups stay short under churn.
+///
+/// Id 0 marks an empty slot and cannot be used as a key.
+template <class Value>
+class OrderIndex {
+public:
+  typedef uint64_t Id;
+
+  OrderIndex()
+  : size_(0),
+    shift_(64)
+  {
+  }
+
+  /// @brief make room for count entries without growing
+  void reserve(size_t count)
+  {
+    size_t capacity = entries_.empty() ? 16 : entries_.size();
+    while (capacity < count * 2) {
+      capacity *= 2;
+    }
+    if (capacity != entries_.size()) {
+      rehash(capacity);
+    }
+  }
+
+  /// @brief add an entry
+  /// @return false, leaving the table unchanged, if the id is present
+  bool insert(Id id, const Value & value)
+  {
+    if (id == 0) {
+      throw std::runtime_error("Order id 0 is reserved");
+    }
+    if ((size_ + 1) * 2 > entries_.size()) {
+      rehash(entries_.empty() ? 16 : entries_.size() * 2);
+    }
+    size_t mask = entries_.size() - 1;
+    for (size_t pos = slot(id); ; pos = (pos + 1) & mask) {
+      Entry & entry = entries_[pos];
+      if (entry.first == id) {
+        return false;
+      }
+      if (entry.first == 0) {
+        entry.first = id;
+        entry.second = value;
+        ++size_;
+        return true;
+      }
+    }
+  }
+
+  /// @brief find the value for an id
+  /// @return the value, or nullptr if the id is not present
+  Value * find(Id id)
+  {
+    return const_cast<Value *>(
+      static_cast<const OrderIndex *>(this)->find(id));
+  }
+
+  /// @brief find the value for an id
+  /// @return the value, or nullptr if the id is not present
+  const Value * find(Id id) const
+  {
+    if (id == 0 || entries_.empty()) {
+      return nullptr;
+    }
+    size_t mask = entries_.size() - 1;
+    for (size_t pos = slot(id); ; pos = (pos + 1) & mask) {
+      const Entry & entry = entries_[pos];
+      if (entry.first == id) {
+        return &entry.second;
+      }
+      if (entry.first == 0) {
+        return nullptr;
+      }
+    }
+  }
+
+  /// @brief remove an entry
+  /// @return false if the id was not present
+  bool erase(Id id)
+  {
+    if (id == 0 || entries_.empty()) {
+      return false;
+    }
+    size_t mask = entries_.size() - 1;
+    size_t pos = slot(id);
+    while (entries_[pos].first != id) {
+      if (entries_[pos].first == 0) {
+        return false;
+      }
+      pos = (pos + 1) & mask;
+    }
+    // Move back any later entry that would no longer be found
+    size_t hole = pos;
+    for (size_t next = (hole + 1) & mask; entries_[next].first != 0;
+         next = (next + 1) & mask) {
+      size_t home = slot(entries_[next].first);
+      // Can the entry at next move to the hole?
+      // Only if its home is not cyclically in (hole, next]
+      if (((next - home) & mask) >= ((next - hole) & mask)) {
+        entries_[hole] = std::move(entries_[next]);
+        hole = next;
+      }
+    }
+    entries_[hole] = Entry();
+    --size_;
+    return true;
+  }
+
+  /// @brief remove every entry, keeping the table
+  void clear()
+  {
+    for (size_t pos = 0; pos < entries_.size(); ++pos) {
+      entries_[pos] = Entry();
+    }
+    size_ = 0;
+  }
+
+  /// @brief the number of entries
+  size_t size() const { return size_; }
+
+  /// @brief are there no entries?
+  bool empty() const { return size_ == 0; }
+
+  /// @brief the number of slots in the table
+  size_t capacity() const { return entries_.size(); }
+
+private:
+  typedef std::pair<Id, Value> Entry;
+
+  /// @brief the home slot of an id: Fibonacci hashing, so sequential ids
+  /// spread across the table
+  size_t slot(Id id) const
+  {
+    return size_t((id * 0x9E3779B97F4A7C15ull) >> shift_);
+  }
+
+  void rehash(size_t capacity)
+  {
+    std::vector<Entry> old(capacity);
+    old.swap(entries_);
+    shift_ = 64;
+    for (size_t bits = capacity; bits > 1; bits >>= 1) {
+      --shift_;
+    }
+    size_ = 0;
+    for (size_t pos = 0; pos < old.size(); ++pos) {
+      if (old[pos].first != 0) {
+        insert(old[pos].first, old[pos].second);
+      }
+    }
+  }
+
+  std::vector<Entry> entries_;
+  size_t size_;
+  // 64 - log2(capacity)
+  unsigned shift_;
+};
+
+} }
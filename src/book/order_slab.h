@@ -0,0 +1,231 @@
+// Copyright (c) 2017 Object Computing, Inc.
+// All rights reserved.
+// See the file license.txt for licensing information.
+#pragma once
+
+#include "types.h"
+#include <cstddef>
+#include <new>
+#include <stdexcept>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace liquibook { namespace book {
+
+template <class T>
+class SlabPtr;
+
+/// @brief Pre-allocated, type-stable store of objects addressed by
+/// 32-bit handles.
+///
+/// Records live in fixed size chunks that are never moved or freed while
+/// the slab exists, so a record's address and handle stay valid until it
+/// is destroyed, and a destroyed record's slot is reused by the next
+/// create().  Looking up a record by handle is an array index.
+///
+/// A SlabPtr is only the 32-bit handle, so it finds its slab through the
+/// calling thread: each thread using SlabPtr<T> binds its own slab with a
+/// Binding.  A slab is not thread safe.  It, the books holding its handles
+/// and the handles themselves belong to the thread it is bound to.
+template <class T>
+class OrderSlab {
+public:
+  typedef SlabPtr<T> Handle;
+
+  /// @brief records per chunk
+  static const uint32_t CHUNK_BITS = 12;
+  static const uint32_t CHUNK_SIZE = uint32_t(1) << CHUNK_BITS;
+
+  /// @brief makes a slab the one SlabPtr<T> resolves against on the
+  /// constructing thread, until the binding is destroyed
+  class Binding {
+  public:
+    explicit Binding(OrderSlab & slab)
+    : previous_(current_)
+    {
+      current_ = &slab;
+    }
+
+    ~Binding()
+    {
+      current_ = previous_;
+    }
+
+  private:
+    Binding(const Binding &);
+    Binding & operator =(const Binding &);
+
+    OrderSlab * previous_;
+  };
+
+  /// @brief the slab bound to the calling thread, or nullptr
+  static OrderSlab * current() { return current_; }
+
+  OrderSlab()
+  : in_use_(1, false),
+    next_(1),
+    live_(0)
+  {
+  }
+
+  ~OrderSlab()
+  {
+    // Records still in use are abandoned, not destroyed
+    for (size_t chunk = 0; chunk < chunks_.size(); ++chunk) {
+      delete [] chunks_[chunk];
+    }
+  }
+
+  /// @brief allocate room for at least records live records up front
+  void reserve(size_t records)
+  {
+    // slot 0 is the null handle
+    while (capacity() < records + 1) {
+      add_chunk();
+    }
+    in_use_.reserve(capacity());
+  }
+
+  /// @brief construct a record in a free slot
+  template <class... Args>
+  Handle create(Args&&... args)
+  {
+    uint32_t index;
+    if (!free_.empty()) {
+      index = free_.back();
+      free_.pop_back();
+    } else {
+      if (next_ >= capacity()) {
+        add_chunk();
+      }
+      index = next_++;
+      in_use_.push_back(false);
+    }
+    new (slot(index)) T(std::forward<Args>(args)...);
+    in_use_[index] = true;
+    ++live_;
+    return Handle(index);
+  }
+
+  /// @brief destroy a record and free its slot for reuse
+  /// @throws std::runtime_error for the null handle, a handle the slab
+  ///         never issued, or a record already destroyed
+  void destroy(Handle handle)
+  {
+    uint32_t index = handle.index();
+    if (index == 0 || index >= next_) {
+      throw std::runtime_error("Invalid slab handle");
+    }
+    if (!in_use_[index]) {
+      throw std::runtime_error("Slab record already destroyed");
+    }
+    get(index)->~T();
+    in_use_[index] = false;
+    free_.push_back(index);
+    --live_;
+  }
+
+  /// @brief the record for a handle index
+  T * get(uint32_t index) const
+  {
+    return reinterpret_cast<T *>(
+      &chunks_[index >> CHUNK_BITS][index & (CHUNK_SIZE - 1)]);
+  }
+
+  /// @brief the number of live records
+  size_t size() const { return live_; }
+
+  /// @brief the number of slots allocated
+  size_t capacity() const { return chunks_.size() * CHUNK_SIZE; }
+
+  /// @brief the heap memory held by the slab
+  size_t memory_bytes() const
+  {
+    return capacity() * sizeof(Slot) +
+      chunks_.capacity() * sizeof(Slot *) +
+      free_.capacity() * sizeof(uint32_t) +
+      in_use_.capacity() / 8;
+  }
+
+private:
+  typedef typename std::aligned_storage<sizeof(T), alignof(T)>::type Slot;
+
+  OrderSlab(const OrderSlab &);
+  OrderSlab & operator =(const OrderSlab &);
+
+  void add_chunk()
+  {
+    if (chunks_.size() >= (size_t(1) << (32 - CHUNK_BITS))) {
+      throw std::runtime_error("Order slab is full");
+    }
+    chunks_.push_back(new Slot[CHUNK_SIZE]);
+  }
+
+  void * slot(uint32_t index)
+  {
+    return &chunks_[index >> CHUNK_BITS][index & (CHUNK_SIZE - 1)];
+  }
+
+  std::vector<Slot *> chunks_;
+  std::vector<uint32_t> free_;
+  // Whether each issued slot holds a record, to catch a second destroy
+  std::vector<bool> in_use_;
+  // First never used slot
+  uint32_t next_;
+  size_t live_;
+
+  static thread_local OrderSlab * current_;
+};
+
+template <class T>
+thread_local OrderSlab<T> * OrderSlab<T>::current_ = nullptr;
+
+/// @brief 32-bit handle to a record in the OrderSlab<T> bound to the
+/// calling thread.  Usable as the OrderPtr of an OrderBook.  Like a raw pointer it does
+/// not own its record: the application destroys records through the slab
+/// once the books are done with them.
+template <class T>
+class SlabPtr {
+public:
+  typedef T element_type;
+
+  SlabPtr()
+  : index_(0)
+  {
+  }
+
+  SlabPtr(std::nullptr_t)
+  : index_(0)
+  {
+  }
+
+  /// @brief a handle to the record in the given slot
+  explicit SlabPtr(uint32_t index)
+  : index_(index)
+  {
+  }
+
+  /// @brief the slot of the record, or 0 for the null handle.
+  /// Suitable as a dense order id.
+  uint32_t index() const { return index_; }
+
+  T * get() const
+  {
+    return index_ ? OrderSlab<T>::current()->get(index_) : nullptr;
+  }
+  T & operator *() const { return *OrderSlab<T>::current()->get(index_); }
+  T * operator ->() const { return OrderSlab<T>::current()->get(index_); }
+  explicit operator bool() const { return index_ != 0; }
+
+  bool operator ==(const SlabPtr & rhs) const { return index_ == rhs.index_; }
+  bool operator !=(const SlabPtr & rhs) const { return index_ != rhs.index_; }
+  bool operator <(const SlabPtr & rhs) const { return index_ < rhs.index_; }
+  bool operator ==(std::nullptr_t) const { return index_ == 0; }
+  bool operator !=(std::nullptr_t) const { return index_ != 0; }
+
+private:
+  uint32_t index_;
+};
+
+} }
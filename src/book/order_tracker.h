@@ -9,6 +9,13 @@ namespace liquibook { namespace book {
 
 /// @brief Tracker of an order's state, to keep inside the OrderBook.  
 ///   Kept separate from the order itself.
+///
+/// The tracker holds everything the matching walk needs -- open quantity,
+/// limit price, side and conditions -- next to the order pointer, so
+/// walking a price level does not touch the orders themselves.  The order
+/// holds the rest (order quantity, stop price, ...) and is only read when
+/// an order enters or leaves the book.  With a raw pointer, or any other
+/// pointer-sized order handle, a tracker is 32 bytes.
 template <typename OrderPtr>
 class OrderTracker {
 public:
@@ -37,47 +44,75 @@ public:
   /// @brief get the order pointer
   OrderPtr& ptr();
 
+  /// @brief get the price at which the order is in the book.
+  /// This is the order's limit price, or MARKET_ORDER_PRICE.
+  Price price() const;
+
+  /// @brief update the price at which the order is in the book
+  void set_price(Price price);
+
+  /// @brief is this a buy order?
+  bool is_buy() const;
+
   /// @ brief is this order marked all or none?
   bool all_or_none() const;
 
   /// @ brief is this order marked immediate or cancel?
   bool immediate_or_cancel() const;
 
+  /// @brief set aside part of the open quantity
+  /// @param reserved the change in reserved quantity (positive or negative)
+  /// @return the open quantity not reserved
+  /// @throws std::runtime_error if the total reservation leaves the range
+  ///         0 through 4294967295
   Quantity reserve(int64_t reserved);
 
 private:
-  OrderPtr order_;
+  // Condition bits are OrderConditions; the side is kept in the top bit.
+  static const uint32_t buy_side_flag = 0x80000000u;
+
   Quantity open_qty_;
-  int64_t reserved_;
-  OrderConditions conditions_;
+  Price price_;
+  OrderPtr order_;
+  uint32_t flags_;
+  uint32_t reserved_;
 };
 
 template <class OrderPtr>
 OrderTracker<OrderPtr>::OrderTracker(
   const OrderPtr& order,
   OrderConditions conditions)
-: order_(order),
-  open_qty_(order->order_qty()),
-  reserved_(0),
-  conditions_(conditions)
+: open_qty_(order->order_qty()),
+  price_(order->price()),
+  order_(order),
+  flags_(conditions & ~buy_side_flag),
+  reserved_(0)
 {
 #if defined(LIQUIBOOK_ORDER_KNOWS_CONDITIONS)
   if(order->all_or_none())
   {
-    conditions |= oc_all_or_none;
+    flags_ |= oc_all_or_none;
   }
   if(order->immediate_or_cancel())
   {
-    conditions |= oc_immediate_or_cancel;
+    flags_ |= oc_immediate_or_cancel;
   }
 #endif
+  if(order->is_buy())
+  {
+    flags_ |= buy_side_flag;
+  }
 }
 
 template <class OrderPtr>
 Quantity
 OrderTracker<OrderPtr>::reserve(int64_t reserved)
 {
-  reserved_ += reserved;
+  int64_t total = int64_t(reserved_) + reserved;
+  if (total < 0 || total > int64_t(UINT32_MAX)) {
+    throw std::runtime_error("Reserved quantity out of range");
+  }
+  reserved_ = uint32_t(total);
   return open_qty_  - reserved_;
 }
 
@@ -141,18 +176,39 @@ OrderTracker<OrderPtr>::ptr()
   return order_;
 }
 
+template <class OrderPtr>
+Price
+OrderTracker<OrderPtr>::price() const
+{
+  return price_;
+}
+
+template <class OrderPtr>
+void
+OrderTracker<OrderPtr>::set_price(Price price)
+{
+  price_ = price;
+}
+
+template <class OrderPtr>
+bool
+OrderTracker<OrderPtr>::is_buy() const
+{
+  return (flags_ & buy_side_flag) != 0;
+}
+
 template <class OrderPtr>
 bool
 OrderTracker<OrderPtr>::all_or_none() const
 {
-  return bool(conditions_ & oc_all_or_none);
+  return bool(flags_ & oc_all_or_none);
 }
 
 template <class OrderPtr>
 bool
 OrderTracker<OrderPtr>::immediate_or_cancel() const
 {
-    return bool((conditions_ & oc_immediate_or_cancel) != 0);
+    return bool((flags_ & oc_immediate_or_cancel) != 0);
 }
 
 } }
@@ -0,0 +1,316 @@
+// Copyright (c) 2017 Object Computing, Inc.
+// All rights reserved.
+// See the file license.txt for licensing information.
+#pragma once
+
+// POSIX only: the ring lives in a shm_open() region.
+
+#include <atomic>
+#include <cstring>
+#include <new>
+#include <stdexcept>
+#include <string>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace liquibook { namespace book {
+
+/// @brief A ring of byte records in POSIX shared memory, written by one
+/// process and read by any number of others on the host.
+///
+/// The writer never waits for readers.  Each reader keeps its own
+/// position and copies records out between two looks at how far the
+/// writer means to go, the way SeqlockTopOfBook readers do; a record
+/// overwritten while being copied is discarded.  A reader that falls a
+/// whole ring behind skips ahead to the records written from then on and
+/// counts an overrun, so it can recover what it missed some other way.
+///
+/// Records never wrap: one that does not fit before the end of the ring
+/// is preceded by padding up to the end.  The records are stored as
+/// relaxed atomic words, so concurrent reads of a write in progress are
+/// well defined, just discarded.
+class ShmBroadcastRing {
+public:
+  class Reader;
+
+  /// @brief create (or replace) a ring of capacity bytes, a power of two
+  ///        of at least MIN_CAPACITY.  A ring being replaced is unlinked,
+  ///        not truncated, so its readers keep a valid, if stale, mapping.
+  static ShmBroadcastRing * create(const std::string & name, size_t capacity);
+
+  /// @brief map an existing ring, read only
+  static ShmBroadcastRing * open(const std::string & name);
+
+  /// @brief remove a ring's name.  Mappings already made stay valid.
+  static void remove(const std::string & name)
+  {
+    shm_unlink(name.c_str());
+  }
+
+  /// @brief smallest ring
+  static const size_t MIN_CAPACITY = 4096;
+
+  /// @brief unmap the ring
+  ~ShmBroadcastRing();
+
+  /// @brief append a record of 1 to max_record() bytes.  Writer only.
+  void write(const void * data, size_t size);
+
+  /// @brief the bytes of records the ring holds
+  size_t capacity() const { return size_t(header_->capacity); }
+
+  /// @brief the largest record
+  size_t max_record() const { return capacity() / 4; }
+
+  /// @brief the position after the last record written
+  uint64_t tail() const
+  {
+    return header_->tail.load(std::memory_order_acquire);
+  }
+
+  /// @brief the bytes mapped
+  size_t region_bytes() const { return bytes_; }
+
+private:
+  static const uint64_t MAGIC = 0x4c4252494e473031ull;  // "LBRING01"
+  static const uint32_t RECORD_DATA = 1;
+  static const uint32_t RECORD_PADDING = 2;
+  static const size_t WORD = sizeof(uint64_t);
+
+  struct Header {
+    uint64_t magic;
+    uint64_t capacity;
+    // The writer's and readers' views of it each on their own line
+    alignas(64) std::atomic<uint64_t> tail_intent;
+    alignas(64) std::atomic<uint64_t> tail;
+  };
+
+  // Records start a cache line after the header
+  static const size_t HEADER_BYTES = 192;
+  static_assert(sizeof(Header) <= HEADER_BYTES, "Header too big");
+
+  // Bytes a record of size bytes takes, with its own header word
+  static size_t record_bytes(size_t size)
+  {
+    return WORD + (size + WORD - 1) / WORD * WORD;
+  }
+
+  ShmBroadcastRing(void * region, size_t bytes, bool writer);
+  ShmBroadcastRing(const ShmBroadcastRing &);
+  ShmBroadcastRing & operator =(const ShmBroadcastRing &);
+
+  std::atomic<uint64_t> & word(uint64_t position) const
+  {
+    return words_[(position & (header_->capacity - 1)) / WORD];
+  }
+
+  void * region_;
+  size_t bytes_;
+  Header * header_;
+  std::atomic<uint64_t> * words_;
+  bool writer_;
+};
+
+/// @brief One reader's position in a ShmBroadcastRing.  Starts after
+/// the records already written.
+class ShmBroadcastRing::Reader {
+public:
+  explicit Reader(const ShmBroadcastRing & ring)
+  : ring_(ring),
+    position_(ring.tail()),
+    overruns_(0)
+  {
+  }
+
+  /// @brief copy the next record into buffer, which must hold
+  ///        max_record() bytes rounded up to a multiple of 8
+  /// @return the record's size, or 0 if there is no new record
+  size_t receive(void * buffer);
+
+  /// @brief the number of times the reader fell a whole ring behind and
+  ///        skipped ahead
+  uint64_t overruns() const { return overruns_; }
+
+private:
+  // Might the writer have overwritten a record at this position?
+  bool overrun(uint64_t position) const
+  {
+    return ring_.header_->tail_intent.load(std::memory_order_relaxed) >
+           position + ring_.header_->capacity;
+  }
+
+  const ShmBroadcastRing & ring_;
+  uint64_t position_;
+  uint64_t overruns_;
+};
+
+inline
+ShmBroadcastRing::ShmBroadcastRing(void * region, size_t bytes, bool writer)
+: region_(region),
+  bytes_(bytes),
+  header_(static_cast<Header *>(region)),
+  words_(reinterpret_cast<std::atomic<uint64_t> *>(
+      static_cast<char *>(region) + HEADER_BYTES)),
+  writer_(writer)
+{
+}
+
+inline
+ShmBroadcastRing::~ShmBroadcastRing()
+{
+  munmap(region_, bytes_);
+}
+
+inline ShmBroadcastRing *
+ShmBroadcastRing::create(const std::string & name, size_t capacity)
+{
+  if (capacity < MIN_CAPACITY || (capacity & (capacity - 1)) != 0) {
+    throw std::runtime_error("Ring capacity must be a power of two");
+  }
+  // Truncating a region a reader has mapped would fault the reader, so
+  // any old ring is unlinked and a new region created in its place
+  shm_unlink(name.c_str());
+  int fd = shm_open(name.c_str(), O_CREAT | O_EXCL | O_RDWR, 0644);
+  if (fd < 0) {
+    throw std::runtime_error("Cannot create shared memory " + name);
+  }
+  size_t bytes = HEADER_BYTES + capacity;
+  void * region = MAP_FAILED;
+  if (ftruncate(fd, off_t(bytes)) == 0) {
+    region = mmap(nullptr, bytes, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  }
+  close(fd);
+  if (region == MAP_FAILED) {
+    shm_unlink(name.c_str());
+    throw std::runtime_error("Cannot map shared memory " + name);
+  }
+  // The region is zero filled.  Build the header last, so a reader that
+  // opens it early fails the magic check.
+  Header * header = static_cast<Header *>(region);
+  header->capacity = capacity;
+  new (&header->tail_intent) std::atomic<uint64_t>(0);
+  new (&header->tail) std::atomic<uint64_t>(0);
+  std::atomic<uint64_t> * words = reinterpret_cast<std::atomic<uint64_t> *>(
+      static_cast<char *>(region) + HEADER_BYTES);
+  for (size_t index = 0; index < capacity / WORD; ++index) {
+    new (&words[index]) std::atomic<uint64_t>(0);
+  }
+  std::atomic_thread_fence(std::memory_order_release);
+  header->magic = MAGIC;
+  return new ShmBroadcastRing(region, bytes, true);
+}
+
+inline ShmBroadcastRing *
+ShmBroadcastRing::open(const std::string & name)
+{
+  int fd = shm_open(name.c_str(), O_RDONLY, 0);
+  if (fd < 0) {
+    throw std::runtime_error("Cannot open shared memory " + name);
+  }
+  struct stat status;
+  void * region = MAP_FAILED;
+  if (fstat(fd, &status) == 0 && size_t(status.st_size) >= HEADER_BYTES) {
+    region = mmap(nullptr, size_t(status.st_size), PROT_READ, MAP_SHARED,
+                  fd, 0);
+  }
+  close(fd);
+  if (region == MAP_FAILED) {
+    throw std::runtime_error("Cannot map shared memory " + name);
+  }
+  size_t bytes = size_t(status.st_size);
+  const Header * header = static_cast<const Header *>(region);
+  if (header->magic != MAGIC || bytes != HEADER_BYTES + header->capacity) {
+    munmap(region, bytes);
+    throw std::runtime_error("Shared memory " + name +
+                             " is not a broadcast ring");
+  }
+  return new ShmBroadcastRing(region, bytes, false);
+}
+
+inline void
+ShmBroadcastRing::write(const void * data, size_t size)
+{
+  if (!writer_) {
+    throw std::runtime_error("Broadcast ring is open read only");
+  }
+  if (size == 0 || size > max_record()) {
+    throw std::runtime_error("Bad record size for broadcast ring");
+  }
+  uint64_t capacity = header_->capacity;
+  uint64_t tail = header_->tail.load(std::memory_order_relaxed);
+  size_t record = record_bytes(size);
+  size_t padding = 0;
+  size_t offset = size_t(tail & (capacity - 1));
+  if (offset + record > capacity) {
+    padding = size_t(capacity) - offset;
+  }
+
+  // Readers that see any new word also see how far it may reach
+  header_->tail_intent.store(tail + padding + record,
+                             std::memory_order_relaxed);
+  std::atomic_thread_fence(std::memory_order_release);
+
+  if (padding) {
+    word(tail).store((uint64_t(RECORD_PADDING) << 32) | (padding - WORD),
+                     std::memory_order_relaxed);
+    tail += padding;
+  }
+  const unsigned char * bytes = static_cast<const unsigned char *>(data);
+  uint64_t position = tail + WORD;
+  for (size_t done = 0; done < size; done += WORD, position += WORD) {
+    uint64_t value = 0;
+    memcpy(&value, bytes + done, size - done < WORD ? size - done : WORD);
+    word(position).store(value, std::memory_order_relaxed);
+  }
+  word(tail).store((uint64_t(RECORD_DATA) << 32) | size,
+                   std::memory_order_relaxed);
+  header_->tail.store(tail + record, std::memory_order_release);
+}
+
+inline size_t
+ShmBroadcastRing::Reader::receive(void * buffer)
+{
+  uint64_t * words = static_cast<uint64_t *>(buffer);
+  while (true) {
+    uint64_t tail = ring_.tail();
+    if (position_ == tail) {
+      return 0;
+    }
+    if (overrun(position_)) {
+      // Skip what was lost, up to the newest complete record
+      position_ = tail;
+      ++overruns_;
+      continue;
+    }
+    uint64_t head = ring_.word(position_).load(std::memory_order_relaxed);
+    uint32_t type = uint32_t(head >> 32);
+    size_t size = size_t(uint32_t(head));
+    size_t record = record_bytes(size);
+    bool sane = (type == RECORD_DATA && size <= ring_.max_record()) ||
+                (type == RECORD_PADDING &&
+                 record == ring_.header_->capacity -
+                           (position_ & (ring_.header_->capacity - 1)));
+    if (sane && type == RECORD_DATA) {
+      uint64_t position = position_ + WORD;
+      for (size_t word = 0; word < record / WORD - 1; ++word) {
+        words[word] = ring_.word(position + word * WORD).load(
+            std::memory_order_relaxed);
+      }
+    }
+    // Keep the copy only if the writer has not started over it
+    std::atomic_thread_fence(std::memory_order_acquire);
+    if (!sane || overrun(position_)) {
+      position_ = ring_.tail();
+      ++overruns_;
+      continue;
+    }
+    position_ += record;
+    if (type == RECORD_DATA) {
+      return size;
+    }
+  }
+}
+
+} }
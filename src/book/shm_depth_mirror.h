@@ -0,0 +1,239 @@
+// Copyright (c) 2017 Object Computing, Inc.
+// All rights reserved.
+// See the file license.txt for licensing information.
+#pragma once
+
+// POSIX only: the mirror lives in a shm_open() region.
+
+#include "top_of_book.h"
+#include <atomic>
+#include <cstring>
+#include <new>
+#include <stdexcept>
+#include <string>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace liquibook { namespace book {
+
+/// @brief Depth levels of many books, kept in POSIX shared memory so
+/// other processes on the host can read them.
+///
+/// The writing process creates the region and adds a slot per book,
+/// then attaches each slot to its DepthOrderBook with set_depth_slot().
+/// The book publishes its levels to the slot after every depth change.
+/// Reading processes open the region read only and copy a book's levels
+/// with the slot's seqlock, so a reader never sees a half written book
+/// and never delays the writer.
+///
+/// The region holds a header, then max_books entries, each a symbol and
+/// a SeqlockTopOfBook<SIZE> on its own cache lines.  Readers and writer
+/// must be built with the same SIZE; open() checks the layout.
+template <int SIZE = 5>
+class ShmDepthMirror {
+public:
+  typedef SeqlockTopOfBook<SIZE> Slot;
+  typedef typename Slot::Snapshot Snapshot;
+
+  /// @brief longest symbol stored, not counting the terminating null
+  static const size_t MAX_SYMBOL = 31;
+
+  /// @brief create (or replace) a region for up to max_books books.  A
+  ///        region being replaced is unlinked, not truncated, so its
+  ///        readers keep a valid, if stale, mapping.
+  static ShmDepthMirror * create(const std::string & name, uint32_t max_books);
+
+  /// @brief map an existing region, read only
+  static ShmDepthMirror * open(const std::string & name);
+
+  /// @brief remove a region's name.  Mappings already made stay valid.
+  static void remove(const std::string & name)
+  {
+    shm_unlink(name.c_str());
+  }
+
+  /// @brief unmap the region
+  ~ShmDepthMirror();
+
+  /// @brief add a book, returning the slot to attach to it.
+  ///        Writer only.
+  Slot * add_book(const std::string & symbol);
+
+  /// @brief the number of books added so far
+  uint32_t book_count() const
+  {
+    return header_->book_count.load(std::memory_order_acquire);
+  }
+
+  /// @brief the most books the region holds
+  uint32_t max_books() const { return header_->max_books; }
+
+  /// @brief the symbol of a book.  index < book_count()
+  const char * symbol(uint32_t index) const { return entry(index).symbol; }
+
+  /// @brief find a book by symbol
+  /// @return its index, or book_count() if there is none
+  uint32_t find(const std::string & symbol) const;
+
+  /// @brief the levels slot of a book.  index < book_count()
+  const Slot & slot(uint32_t index) const { return entry(index).slot; }
+
+  /// @brief the bytes mapped
+  size_t region_bytes() const { return bytes_; }
+
+private:
+  static const uint64_t MAGIC = 0x4c42444550544831ull;  // "LBDEPTH1"
+
+  struct Header {
+    uint64_t magic;
+    uint32_t levels;
+    uint32_t entry_bytes;
+    uint32_t max_books;
+    std::atomic<uint32_t> book_count;
+  };
+
+  struct Entry {
+    char symbol[MAX_SYMBOL + 1];
+    Slot slot;
+  };
+
+  // Entries start a cache line after the header
+  static const size_t HEADER_BYTES = 64;
+  static_assert(sizeof(Header) <= HEADER_BYTES, "Header too big");
+
+  static size_t region_size(uint32_t max_books)
+  {
+    return HEADER_BYTES + size_t(max_books) * sizeof(Entry);
+  }
+
+  ShmDepthMirror(void * region, size_t bytes, bool writer);
+  ShmDepthMirror(const ShmDepthMirror &);
+  ShmDepthMirror & operator =(const ShmDepthMirror &);
+
+  Entry & entry(uint32_t index) const
+  {
+    return reinterpret_cast<Entry *>(
+      static_cast<char *>(region_) + HEADER_BYTES)[index];
+  }
+
+  void * region_;
+  size_t bytes_;
+  Header * header_;
+  bool writer_;
+};
+
+template <int SIZE>
+ShmDepthMirror<SIZE>::ShmDepthMirror(void * region, size_t bytes, bool writer)
+: region_(region),
+  bytes_(bytes),
+  header_(static_cast<Header *>(region)),
+  writer_(writer)
+{
+}
+
+template <int SIZE>
+ShmDepthMirror<SIZE>::~ShmDepthMirror()
+{
+  munmap(region_, bytes_);
+}
+
+template <int SIZE>
+ShmDepthMirror<SIZE> *
+ShmDepthMirror<SIZE>::create(const std::string & name, uint32_t max_books)
+{
+  // Truncating a region a reader has mapped would fault the reader
+  shm_unlink(name.c_str());
+  int fd = shm_open(name.c_str(), O_CREAT | O_EXCL | O_RDWR, 0644);
+  if (fd < 0) {
+    throw std::runtime_error("Cannot create shared memory " + name);
+  }
+  size_t bytes = region_size(max_books);
+  void * region = MAP_FAILED;
+  if (ftruncate(fd, off_t(bytes)) == 0) {
+    region = mmap(nullptr, bytes, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  }
+  close(fd);
+  if (region == MAP_FAILED) {
+    shm_unlink(name.c_str());
+    throw std::runtime_error("Cannot map shared memory " + name);
+  }
+  // The region is zero filled.  Build the header last, so a reader that
+  // opens it early fails the magic check.
+  Header * header = static_cast<Header *>(region);
+  header->levels = SIZE;
+  header->entry_bytes = sizeof(Entry);
+  header->max_books = max_books;
+  new (&header->book_count) std::atomic<uint32_t>(0);
+  std::atomic_thread_fence(std::memory_order_release);
+  header->magic = MAGIC;
+  return new ShmDepthMirror(region, bytes, true);
+}
+
+template <int SIZE>
+ShmDepthMirror<SIZE> *
+ShmDepthMirror<SIZE>::open(const std::string & name)
+{
+  int fd = shm_open(name.c_str(), O_RDONLY, 0);
+  if (fd < 0) {
+    throw std::runtime_error("Cannot open shared memory " + name);
+  }
+  struct stat status;
+  void * region = MAP_FAILED;
+  if (fstat(fd, &status) == 0 && size_t(status.st_size) >= HEADER_BYTES) {
+    region = mmap(nullptr, size_t(status.st_size), PROT_READ, MAP_SHARED,
+                  fd, 0);
+  }
+  close(fd);
+  if (region == MAP_FAILED) {
+    throw std::runtime_error("Cannot map shared memory " + name);
+  }
+  size_t bytes = size_t(status.st_size);
+  const Header * header = static_cast<const Header *>(region);
+  if (header->magic != MAGIC || header->levels != SIZE ||
+      header->entry_bytes != sizeof(Entry) ||
+      bytes < region_size(header->max_books)) {
+    munmap(region, bytes);
+    throw std::runtime_error("Shared memory " + name +
+                             " is not a depth mirror of this layout");
+  }
+  return new ShmDepthMirror(region, bytes, false);
+}
+
+template <int SIZE>
+typename ShmDepthMirror<SIZE>::Slot *
+ShmDepthMirror<SIZE>::add_book(const std::string & symbol)
+{
+  if (!writer_) {
+    throw std::runtime_error("Depth mirror is open read only");
+  }
+  uint32_t index = header_->book_count.load(std::memory_order_relaxed);
+  if (index >= header_->max_books) {
+    throw std::runtime_error("Depth mirror is full");
+  }
+  if (symbol.size() > MAX_SYMBOL) {
+    throw std::runtime_error("Symbol too long for depth mirror: " + symbol);
+  }
+  Entry & book = entry(index);
+  memcpy(book.symbol, symbol.c_str(), symbol.size() + 1);
+  new (&book.slot) Slot;
+  // Readers see the entry only once it is complete
+  header_->book_count.store(index + 1, std::memory_order_release);
+  return &book.slot;
+}
+
+template <int SIZE>
+uint32_t
+ShmDepthMirror<SIZE>::find(const std::string & symbol) const
+{
+  uint32_t count = book_count();
+  for (uint32_t index = 0; index < count; ++index) {
+    if (symbol == entry(index).symbol) {
+      return index;
+    }
+  }
+  return count;
+}
+
+} }
@@ -0,0 +1,83 @@
+// Copyright (c) 2017 Object Computing, Inc.
+// All rights reserved.
+// See the file license.txt for licensing information.
+#pragma once
+
+#include "types.h"
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <stdexcept>
+
+namespace liquibook { namespace book {
+
+/// @brief Dense integer id assigned to a symbol by a SymbolDirectory
+typedef uint32_t SymbolId;
+
+namespace {
+const SymbolId INVALID_SYMBOL_ID(UINT32_MAX);
+}
+
+/// @brief Symbols interned to dense ids, with one book per symbol.
+///
+/// A symbol gets the next id when its book is added, and the books are
+/// kept in a vector indexed by id, so once a message carries the id,
+/// finding its book is an array access.  The symbol string is only
+/// looked up when a new symbol arrives.
+///
+/// Book is whatever the application keeps per symbol: an order book, or
+/// a pointer to one.  Books held by value move when more are added, so
+/// add every book before handing out references to them.
+template <class Book>
+class SymbolDirectory {
+public:
+  /// @brief add a book for a new symbol
+  /// @return the symbol's id, or INVALID_SYMBOL_ID if it already has a book
+  SymbolId add(const std::string & symbol, const Book & book)
+  {
+    SymbolId id = SymbolId(books_.size());
+    if (id == INVALID_SYMBOL_ID) {
+      throw std::runtime_error("Too many symbols");
+    }
+    if (!ids_.insert(std::make_pair(symbol, id)).second) {
+      return INVALID_SYMBOL_ID;
+    }
+    books_.push_back(book);
+    symbols_.push_back(symbol);
+    return id;
+  }
+
+  /// @brief find the id of a symbol
+  /// @return the id, or INVALID_SYMBOL_ID if the symbol has no book
+  SymbolId find(const std::string & symbol) const
+  {
+    typename IdMap::const_iterator entry = ids_.find(symbol);
+    return entry == ids_.end() ? INVALID_SYMBOL_ID : entry->second;
+  }
+
+  /// @brief does this id belong to a symbol?
+  bool contains(SymbolId id) const { return id < books_.size(); }
+
+  /// @brief access the book for a symbol id.  The id must be valid.
+  Book & book(SymbolId id) { return books_[id]; }
+
+  /// @brief access the book for a symbol id.  The id must be valid.
+  const Book & book(SymbolId id) const { return books_[id]; }
+
+  /// @brief the symbol for an id.  The id must be valid.
+  const std::string & symbol(SymbolId id) const { return symbols_[id]; }
+
+  /// @brief the number of symbols.  Ids run from 0 to size() - 1.
+  size_t size() const { return books_.size(); }
+
+  /// @brief are there no symbols?
+  bool empty() const { return books_.empty(); }
+
+private:
+  typedef std::unordered_map<std::string, SymbolId> IdMap;
+  IdMap ids_;
+  std::vector<Book> books_;
+  std::vector<std::string> symbols_;
+};
+
+} }
@@ -0,0 +1,119 @@
+// Copyright (c) 2017 Object Computing, Inc.
+// All rights reserved.
+// See the file license.txt for licensing information.
+#pragma once
+
+#include "symbol_directory.h"
+#include <stdexcept>
+#include <vector>
+
+namespace liquibook { namespace book {
+
+/// @brief A set of symbols as a bitset indexed by SymbolId.
+///
+/// Since a SymbolDirectory hands out ids densely from 0, a set of them
+/// takes a bit per symbol, and asking whether one is in the set is a
+/// shift and a mask rather than a string lookup.  The bits grow to the
+/// highest id inserted.
+class SymbolSet {
+public:
+  SymbolSet()
+  : size_(0)
+  {
+  }
+
+  /// @brief add a symbol
+  /// @return true if it was not already in the set
+  bool insert(SymbolId id);
+
+  /// @brief add every symbol in another set
+  void insert(const SymbolSet & other);
+
+  /// @brief remove a symbol
+  /// @return true if it was in the set
+  bool erase(SymbolId id);
+
+  /// @brief is a symbol in the set?
+  bool contains(SymbolId id) const
+  {
+    size_t word = id / WORD_BITS;
+    return word < words_.size() && (words_[word] & bit(id)) != 0;
+  }
+
+  /// @brief the number of symbols in the set
+  size_t size() const { return size_; }
+
+  /// @brief is the set empty?
+  bool empty() const { return size_ == 0; }
+
+  /// @brief remove every symbol, keeping the bits' storage
+  void clear();
+
+private:
+  static const size_t WORD_BITS = 64;
+
+  static uint64_t bit(SymbolId id)
+  {
+    return uint64_t(1) << (id % WORD_BITS);
+  }
+
+  std::vector<uint64_t> words_;
+  size_t size_;
+};
+
+inline bool
+SymbolSet::insert(SymbolId id)
+{
+  if (id == INVALID_SYMBOL_ID) {
+    throw std::runtime_error("Invalid symbol id");
+  }
+  size_t word = id / WORD_BITS;
+  if (word >= words_.size()) {
+    words_.resize(word + 1, 0);
+  }
+  if (words_[word] & bit(id)) {
+    return false;
+  }
+  words_[word] |= bit(id);
+  ++size_;
+  return true;
+}
+
+inline void
+SymbolSet::insert(const SymbolSet & other)
+{
+  if (other.words_.size() > words_.size()) {
+    words_.resize(other.words_.size(), 0);
+  }
+  size_ = 0;
+  for (size_t word = 0; word < words_.size(); ++word) {
+    if (word < other.words_.size()) {
+      words_[word] |= other.words_[word];
+    }
+    for (uint64_t bits = words_[word]; bits; bits &= bits - 1) {
+      ++size_;
+    }
+  }
+}
+
+inline bool
+SymbolSet::erase(SymbolId id)
+{
+  if (!contains(id)) {
+    return false;
+  }
+  words_[id / WORD_BITS] &= ~bit(id);
+  --size_;
+  return true;
+}
+
+inline void
+SymbolSet::clear()
+{
+  for (size_t word = 0; word < words_.size(); ++word) {
+    words_[word] = 0;
+  }
+  size_ = 0;
+}
+
+} }
@@ -0,0 +1,21 @@
+// Copyright (c) 2017 Object Computing, Inc.
+// All rights reserved.
+// See the file license.txt for licensing information.
+#pragma once
+
+#include "types.h"
+#include <chrono>
+
+namespace liquibook { namespace book {
+
+/// @brief read the system clock as a Timestamp, in nanoseconds since the
+/// epoch.  The system clock rather than the steady clock, so that stamps
+/// taken by different processes, or by hosts whose clocks are kept in
+/// step, can be compared.
+inline Timestamp timestamp_now()
+{
+  return Timestamp(std::chrono::duration_cast<std::chrono::nanoseconds>(
+    std::chrono::system_clock::now().time_since_epoch()).count());
+}
+
+} }
@@ -0,0 +1,151 @@
+// Copyright (c) 2017 Object Computing, Inc.
+// All rights reserved.
+// See the file license.txt for licensing information.
+#pragma once
+
+#include "types.h"
+#include "depth.h"
+#include <atomic>
+#include <cstring>
+
+namespace liquibook { namespace book {
+
+/// @brief A copy of the best LEVELS price levels on each side of a book.
+/// Empty levels have zero price and quantity.
+template <int LEVELS = 1>
+struct TopOfBook {
+  struct Level {
+    Price price;
+    Quantity qty;
+    uint32_t order_count;
+    // Keeps the struct free of uninitialized padding
+    uint32_t reserved;
+  };
+
+  TopOfBook()
+  : change_id(0),
+    reserved(0)
+  {
+    const Level empty = { 0, 0, 0, 0 };
+    for (int level = 0; level < LEVELS; ++level) {
+      bids[level] = empty;
+      asks[level] = empty;
+    }
+  }
+
+  /// @brief copy the top levels of a depth tracker
+  template <int SIZE>
+  void set(const Depth<SIZE> & depth)
+  {
+    static_assert(LEVELS <= SIZE, "Depth has too few levels");
+    const DepthLevel * bid = depth.bids();
+    const DepthLevel * ask = depth.asks();
+    for (int level = 0; level < LEVELS; ++level) {
+      set_level(bids[level], bid[level]);
+      set_level(asks[level], ask[level]);
+    }
+    change_id = depth.last_change();
+  }
+
+  Level bids[LEVELS];
+  Level asks[LEVELS];
+  /// @brief the depth change the levels reflect
+  ChangeId change_id;
+  uint32_t reserved;
+
+private:
+  static void set_level(Level & level, const DepthLevel & depth_level)
+  {
+    level.price = depth_level.price();
+    level.qty = depth_level.aggregate_qty();
+    level.order_count = depth_level.order_count();
+    level.reserved = 0;
+  }
+};
+
+/// @brief A TopOfBook written by one thread and read by any number of
+/// others, guarded by a sequence lock.
+///
+/// The writer never waits for readers: publishing makes the sequence
+/// odd, stores the levels, then makes it even again.  A reader copies
+/// the levels between two reads of the sequence and keeps the copy only
+/// if the sequence was even and unchanged.  try_read() makes one
+/// attempt and so never waits; read() retries until it succeeds, which
+/// only takes more than one attempt when it overlaps a publish.
+///
+/// The levels are stored as relaxed atomic words, so concurrent reads
+/// of a publish in progress are well defined, just discarded.  Each slot
+/// starts on its own cache line.  Keep slots in memory that outlives
+/// every reader.
+template <int LEVELS = 1>
+class alignas(64) SeqlockTopOfBook {
+public:
+  typedef TopOfBook<LEVELS> Snapshot;
+
+  SeqlockTopOfBook()
+  : sequence_(0)
+  {
+    publish(Snapshot());
+  }
+
+  /// @brief replace the levels.  One writer at a time.
+  void publish(const Snapshot & snapshot)
+  {
+    uint64_t words[WORDS];
+    memcpy(words, &snapshot, sizeof(Snapshot));
+    uint64_t sequence = sequence_.load(std::memory_order_relaxed);
+    sequence_.store(sequence + 1, std::memory_order_relaxed);
+    // Readers that see any new word also see the odd sequence
+    std::atomic_thread_fence(std::memory_order_release);
+    for (size_t word = 0; word < WORDS; ++word) {
+      words_[word].store(words[word], std::memory_order_relaxed);
+    }
+    sequence_.store(sequence + 2, std::memory_order_release);
+  }
+
+  /// @brief copy the levels if no publish is in progress
+  /// @return false, leaving snapshot unchanged, if the copy overlapped
+  ///         a publish
+  bool try_read(Snapshot & snapshot) const
+  {
+    uint64_t before = sequence_.load(std::memory_order_acquire);
+    if (before & 1) {
+      return false;
+    }
+    uint64_t words[WORDS];
+    for (size_t word = 0; word < WORDS; ++word) {
+      words[word] = words_[word].load(std::memory_order_relaxed);
+    }
+    std::atomic_thread_fence(std::memory_order_acquire);
+    if (sequence_.load(std::memory_order_relaxed) != before) {
+      return false;
+    }
+    memcpy(&snapshot, words, sizeof(Snapshot));
+    return true;
+  }
+
+  /// @brief copy the levels, retrying while a publish is in progress
+  void read(Snapshot & snapshot) const
+  {
+    while (!try_read(snapshot)) {
+    }
+  }
+
+  /// @brief twice the number of publishes, counting the empty levels
+  /// published on construction.  Odd while a publish is in progress.
+  uint64_t sequence() const
+  {
+    return sequence_.load(std::memory_order_acquire);
+  }
+
+private:
+  SeqlockTopOfBook(const SeqlockTopOfBook &);
+  SeqlockTopOfBook & operator =(const SeqlockTopOfBook &);
+
+  static const size_t WORDS = (sizeof(Snapshot) + 7) / 8;
+
+  std::atomic<uint64_t> sequence_;
+  std::atomic<uint64_t> words_[WORDS];
+};
+
+} }
@@ -0,0 +1,183 @@
+// Copyright (c) 2017 Object Computing, Inc.
+// All rights reserved.
+// See the file license.txt for licensing information.
+#pragma once
+
+#include "trace_ring.h"
+#include <iostream>
+#include <iomanip>
+#include <string>
+#include <cstring>
+#include <thread>
+
+namespace liquibook { namespace book {
+
+/// @brief Formatting helpers for events captured by a TraceRing.
+class TraceDump {
+public:
+  typedef TraceRing<> Ring;
+  typedef std::vector<TraceEvent> Events;
+
+  /// @brief estimate how many trace ticks elapse per microsecond.
+  /// Blocks the calling thread for roughly the sample duration.
+  static double ticks_per_microsecond(
+    std::chrono::milliseconds sample = std::chrono::milliseconds(20))
+  {
+    typedef std::chrono::steady_clock Clock;
+    Clock::time_point start_time = Clock::now();
+    uint64_t start_ticks = trace_ticks();
+    std::this_thread::sleep_for(sample);
+    uint64_t end_ticks = trace_ticks();
+    Clock::time_point end_time = Clock::now();
+    double elapsed_us = double(
+      std::chrono::duration_cast<std::chrono::nanoseconds>(
+        end_time - start_time).count()) / 1000.0;
+    return elapsed_us > 0.0 ? double(end_ticks - start_ticks) / elapsed_us : 1.0;
+  }
+
+  /// @brief write one line per event, indenting spans.
+  /// Times are microseconds since the first event.
+  static std::ostream & timeline(std::ostream & out,
+                                 const Events & events,
+                                 double ticks_per_us)
+  {
+    if (events.empty()) {
+      return out;
+    }
+    uint64_t origin = events.front().ticks;
+    int depth = 0;
+    for (Events::const_iterator event = events.begin();
+         event != events.end(); ++event) {
+      const char * name = Ring::event_name(event->type);
+      if (is_end(name) && depth > 0) {
+        --depth;
+      }
+      out << std::fixed << std::setprecision(3) << std::setw(12)
+          << double(event->ticks - origin) / ticks_per_us << "us "
+          << std::string(size_t(depth) * 2, ' ') << name
+          << " price=" << event->price
+          << " qty=" << event->quantity
+          << " count=" << event->count << '\n';
+      if (is_begin(name)) {
+        ++depth;
+      }
+    }
+    return out;
+  }
+
+  /// @brief write the events in the Chrome trace event JSON format.
+  /// Load the output in chrome://tracing or Perfetto.
+  /// @param name labels the track, normally the book symbol.
+  static std::ostream & chrome_trace(std::ostream & out,
+                                     const Events & events,
+                                     double ticks_per_us,
+                                     const std::string & name = "book")
+  {
+    out << "{\"traceEvents\":[\n";
+    out << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":1,"
+        << "\"args\":{\"name\":";
+    json_string(out, name) << "}}";
+    uint64_t origin = events.empty() ? 0 : events.front().ticks;
+    int depth = 0;
+    for (Events::const_iterator event = events.begin();
+         event != events.end(); ++event) {
+      std::string event_name = Ring::event_name(event->type);
+      const char * phase = "i";
+      if (is_begin(event_name.c_str())) {
+        phase = "B";
+        event_name.erase(event_name.size() - strlen("_begin"));
+        ++depth;
+      } else if (is_end(event_name.c_str())) {
+        // The ring may have overwritten the start of this span
+        if (depth == 0) {
+          continue;
+        }
+        phase = "E";
+        event_name.erase(event_name.size() - strlen("_end"));
+        --depth;
+      }
+      out << ",\n{\"name\":";
+      json_string(out, event_name) << ",\"ph\":\"" << phase
+          << "\",\"pid\":1,\"tid\":1,\"ts\":"
+          << std::fixed << std::setprecision(3)
+          << double(event->ticks - origin) / ticks_per_us;
+      if (phase[0] == 'i') {
+        out << ",\"s\":\"t\"";
+      }
+      out << ",\"args\":{\"price\":" << event->price
+          << ",\"qty\":" << event->quantity
+          << ",\"count\":" << event->count << "}}";
+    }
+    out << "\n]}\n";
+    return out;
+  }
+
+  /// @brief save raw events so they can be formatted later
+  static std::ostream & save(std::ostream & out, const Events & events)
+  {
+    uint64_t count = events.size();
+    out.write(reinterpret_cast<const char *>(&count), sizeof(count));
+    if (count != 0) {
+      out.write(reinterpret_cast<const char *>(&events[0]),
+                std::streamsize(count * sizeof(TraceEvent)));
+    }
+    return out;
+  }
+
+  /// @brief load raw events written by save()
+  /// @return false if the input was truncated
+  static bool load(std::istream & in, Events & events)
+  {
+    uint64_t count = 0;
+    if (!in.read(reinterpret_cast<char *>(&count), sizeof(count))) {
+      return false;
+    }
+    events.resize(size_t(count));
+    if (count != 0) {
+      in.read(reinterpret_cast<char *>(&events[0]),
+              std::streamsize(count * sizeof(TraceEvent)));
+    }
+    return bool(in);
+  }
+
+private:
+  static bool ends_with(const char * name, const char * suffix)
+  {
+    size_t name_len = strlen(name);
+    size_t suffix_len = strlen(suffix);
+    return name_len >= suffix_len &&
+           strcmp(name + name_len - suffix_len, suffix) == 0;
+  }
+
+  static bool is_begin(const char * name)
+  {
+    return ends_with(name, "_begin");
+  }
+
+  static bool is_end(const char * name)
+  {
+    return ends_with(name, "_end");
+  }
+
+  /// @brief write a quoted JSON string
+  static std::ostream & json_string(std::ostream & out,
+                                    const std::string & value)
+  {
+    out << '"';
+    for (std::string::const_iterator pos = value.begin();
+         pos != value.end(); ++pos) {
+      unsigned char c = static_cast<unsigned char>(*pos);
+      if (c == '"' || c == '\\') {
+        out << '\\' << char(c);
+      } else if (c < 0x20) {
+        static const char hex[] = "0123456789abcdef";
+        out << "\\u00" << hex[c >> 4] << hex[c & 0xf];
+      } else {
+        out << char(c);
+      }
+    }
+    return out << '"';
+  }
+};
+
+} }
@@ -0,0 +1,172 @@
+// Copyright (c) 2017 Object Computing, Inc.
+// All rights reserved.
+// See the file license.txt for licensing information.
+#pragma once
+
+#include "types.h"
+#include <vector>
+#include <chrono>
+
+#if defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+#include <intrin.h>
+#define LIQUIBOOK_HAS_RDTSC
+#elif defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#include <x86intrin.h>
+#define LIQUIBOOK_HAS_RDTSC
+#endif
+
+// Matching path tracing is compiled in only when LIQUIBOOK_ENABLE_TRACE is
+// defined.  Define it for every translation unit that includes liquibook
+// headers.  LIQUIBOOK_TRACE_CAPACITY sets the number of events kept per book.
+#ifdef LIQUIBOOK_ENABLE_TRACE
+#define LIQUIBOOK_TRACE_ONLY(...) __VA_ARGS__
+#define LIQUIBOOK_TRACE(type, price, qty, count) \
+  trace_.record(TraceRing<>::type, price, qty, count)
+#else // LIQUIBOOK_ENABLE_TRACE
+#define LIQUIBOOK_TRACE_ONLY(...)
+#define LIQUIBOOK_TRACE(type, price, qty, count) do{} while(false)
+#endif // LIQUIBOOK_ENABLE_TRACE
+
+#ifndef LIQUIBOOK_TRACE_CAPACITY
+#define LIQUIBOOK_TRACE_CAPACITY 1024
+#endif
+
+namespace liquibook { namespace book {
+
+/// @brief read a cheap, monotonic tick counter.
+/// Uses the time stamp counter where available, otherwise nanoseconds from
+/// the steady clock.
+inline uint64_t trace_ticks()
+{
+#ifdef LIQUIBOOK_HAS_RDTSC
+  return __rdtsc();
+#else
+  return uint64_t(std::chrono::duration_cast<std::chrono::nanoseconds>(
+    std::chrono::steady_clock::now().time_since_epoch()).count());
+#endif
+}
+
+/// @brief One 32 byte entry in a trace ring.
+struct TraceEvent {
+  /// @brief trace_ticks() when the event was recorded
+  uint64_t ticks;
+  /// @brief price associated with the event, if any
+  Price price;
+  /// @brief quantity associated with the event, if any
+  Quantity quantity;
+  /// @brief iteration count or other small value, if any
+  uint32_t count;
+  /// @brief one of TraceRing<>::EventType
+  uint16_t type;
+  uint16_t reserved;
+};
+
+/// @brief Fixed size ring of matching decisions, overwritten oldest first.
+/// Recording an event is a tick read and four stores with no allocation
+/// or branching, so tracing can stay enabled in production.
+/// Not thread safe: read the ring on the thread that owns the book.
+template <size_t CAPACITY = LIQUIBOOK_TRACE_CAPACITY>
+class TraceRing {
+  static_assert(CAPACITY != 0 && (CAPACITY & (CAPACITY - 1)) == 0,
+    "Trace ring capacity must be a power of two");
+public:
+  /// @brief The decision points recorded in the matching path.
+  /// *_begin and *_end events bracket a span of work.
+  enum EventType {
+    te_add_begin,           // price, order quantity
+    te_add_end,             // price, count = 1 if matched
+    te_cancel_begin,        // price
+    te_cancel_end,          // price, cancelled quantity
+    te_replace_begin,       // new price, count = size delta
+    te_replace_end,         // new price, count = 1 if matched
+    te_match_regular_begin, // inbound price, open quantity
+    te_match_regular_end,   // inbound price, open quantity, count = iterations
+    te_match_aon_begin,     // inbound price, open quantity
+    te_aon_defer_current,   // current price, quantity: current AON too big
+    te_aon_aon_trade,       // current price, quantity: AON to AON trade
+    te_aon_aon_defer,       // current price, quantity: AON kept for later
+    te_aon_regular_trade,   // current price, quantity: AON to regular trade
+    te_aon_regular_defer,   // current price, quantity: regular kept for later
+    te_match_aon_end,       // inbound price, open quantity, count = iterations
+    te_deferred_trades,     // quantity found, count = deferred orders
+    te_check_deferred_begin,// count = deferred AONs
+    te_check_deferred_aon,  // AON price, open quantity, count = 1 if matched
+    te_check_deferred_end,
+    te_pending_begin,       // count = pending orders
+    te_pending_submit,      // price, quantity of the triggered stop
+    te_pending_end,
+    te_fill,                // cross price, fill quantity
+    te_event_type_count
+  };
+
+  TraceRing()
+  : next_(0)
+  {
+    for (size_t pos = 0; pos < CAPACITY; ++pos) {
+      events_[pos] = TraceEvent();
+    }
+  }
+
+  /// @brief record an event
+  void record(EventType type, Price price, Quantity quantity, uint32_t count)
+  {
+    TraceEvent & event = events_[next_ & (CAPACITY - 1)];
+    event.ticks = trace_ticks();
+    event.price = price;
+    event.quantity = quantity;
+    event.count = count;
+    event.type = uint16_t(type);
+    ++next_;
+  }
+
+  /// @brief the number of events recorded since construction or clear()
+  uint64_t recorded() const { return next_; }
+
+  /// @brief the number of events currently held
+  size_t size() const
+  {
+    return next_ < CAPACITY ? size_t(next_) : CAPACITY;
+  }
+
+  /// @brief the maximum number of events held
+  static size_t capacity() { return CAPACITY; }
+
+  /// @brief forget all events
+  void clear() { next_ = 0; }
+
+  /// @brief copy the held events, oldest first
+  void snapshot(std::vector<TraceEvent> & events) const
+  {
+    events.clear();
+    events.reserve(size());
+    for (uint64_t pos = next_ - size(); pos != next_; ++pos) {
+      events.push_back(events_[pos & (CAPACITY - 1)]);
+    }
+  }
+
+  /// @brief get a readable name for an event type
+  static const char * event_name(uint16_t type)
+  {
+    static const char * names[te_event_type_count] = {
+      "add_begin", "add_end",
+      "cancel_begin", "cancel_end",
+      "replace_begin", "replace_end",
+      "match_regular_begin", "match_regular_end",
+      "match_aon_begin",
+      "aon_defer_current", "aon_aon_trade", "aon_aon_defer",
+      "aon_regular_trade", "aon_regular_defer",
+      "match_aon_end",
+      "deferred_trades",
+      "check_deferred_begin", "check_deferred_aon", "check_deferred_end",
+      "pending_begin", "pending_submit", "pending_end",
+      "fill"
+    };
+    return type < te_event_type_count ? names[type] : "unknown";
+  }
+
+private:
+  TraceEvent events_[CAPACITY];
+  uint64_t next_;
+};
+
+} }
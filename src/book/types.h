@@ -15,6 +15,7 @@ namespace liquibook { namespace book {
   typedef uint32_t FillId;
   typedef uint32_t ChangeId;
   typedef uint32_t OrderConditions;
+  typedef uint64_t Timestamp;
 
   enum OrderCondition {
     oc_no_conditions = 0,
@@ -3,9 +3,11 @@
 // See the file license.txt for licensing information.
 #include <simple/simple_order_book.h>
 #include <book/types.h>
+#include <book/order_slab.h>
 #include "clock_gettime.h"
 
 #include <iostream>
+#include <vector>
 #include <stdexcept>
 #include <stdlib.h>
 
@@ -15,6 +17,7 @@ using namespace liquibook::book;
 typedef simple::SimpleOrderBook<5> FullDepthOrderBook;
 typedef simple::SimpleOrderBook<1> BboOrderBook;
 typedef book::OrderBook<simple::SimpleOrder*> NoDepthOrderBook;
+typedef book::OrderSlab<simple::SimpleOrder> SimpleOrderSlab;
 
 void build_histogram(timespec* timestamps, int count) {
   timespec* prev = nullptr;
@@ -82,6 +85,12 @@ template <class TypedOrderBook>
 bool build_and_run_test(uint32_t num_to_try, bool dry_run = false) {
   TypedOrderBook order_book;
   simple::SimpleOrder** orders = new simple::SimpleOrder*[num_to_try + 1];
+  // Orders come from one contiguous slab rather than a heap block each
+  SimpleOrderSlab slab;
+  SimpleOrderSlab::Binding binding(slab);
+  std::vector<SimpleOrderSlab::Handle> handles;
+  handles.reserve(num_to_try + 1);
+  slab.reserve(num_to_try + 1);
   timespec* timestamps = new timespec[num_to_try + 1];
   
   for (uint32_t i = 0; i < num_to_try; ++i) {
@@ -112,13 +121,14 @@ bool build_and_run_test(uint32_t num_to_try, bool dry_run = false) {
     Price price = (rand() % 10) + delta;
     
     Quantity qty = ((rand() % 10) + 1) * 100;
-    orders[i] = new simple::SimpleOrder(is_buy, price, qty);
+    handles.push_back(slab.create(is_buy, price, qty));
+    orders[i] = handles.back().get();
   }
   orders[num_to_try] = nullptr; // Final null
   
   run_test(order_book, orders, timestamps);
-  for (uint32_t i = 0; i <= num_to_try; ++i) {
-    delete orders[i];
+  for (size_t i = 0; i < handles.size(); ++i) {
+    slab.destroy(handles[i]);
   }
   delete [] orders;
   std::cout << " - complete!" << std::endl;
@@ -0,0 +1,133 @@
+// Copyright (c) 2017 Object Computing, Inc.
+// All rights reserved.
+// See the file license.txt for licensing information.
+
+// Memory footprint benchmark: loads resting orders across many books and
+// reports bytes per empty book and per resting order, both as measured by
+// the allocator and as reported by memory_usage().
+//
+//   mem_order_book [books] [orders]
+#include <simple/simple_order_book.h>
+#include <book/memory_usage.h>
+#include "alloc_counter.h"
+
+#include <deque>
+#include <iostream>
+#include <vector>
+#include <stdlib.h>
+
+using namespace liquibook;
+using namespace liquibook::book;
+
+typedef simple::SimpleOrderBook<5> FullDepthOrderBook;
+typedef book::OrderBook<simple::SimpleOrder*> NoDepthOrderBook;
+
+namespace {
+
+uint64_t heap_in_use()
+{
+  perf::AllocCounts counts = perf::alloc_counts();
+  return counts.bytes - counts.freed_bytes;
+}
+
+template <class TypedOrderBook>
+MemoryUsage total_usage(const std::deque<TypedOrderBook> & books)
+{
+  MemoryUsage usage;
+  for (size_t pos = 0; pos < books.size(); ++pos) {
+    usage += books[pos].memory_usage();
+  }
+  return usage;
+}
+
+void print_usage(const char * label, const MemoryUsage & usage, double divisor)
+{
+  std::cout << "  " << label << " reported: "
+            << double(usage.total()) / divisor << " bytes ("
+            << double(usage.object_bytes) / divisor << " object, "
+            << double(usage.container_bytes) / divisor << " container, "
+            << double(usage.tracker_bytes) / divisor << " tracker, "
+            << double(usage.callback_bytes) / divisor << " callback)"
+            << std::endl;
+}
+
+template <class TypedOrderBook>
+void run_test(uint32_t num_books, uint32_t num_orders)
+{
+  // The orders belong to the application; keep them out of the measurement
+  std::vector<simple::SimpleOrder> orders;
+  orders.reserve(num_orders);
+  uint32_t orders_per_book = num_orders / num_books;
+  for (uint32_t i = 0; i < num_orders; ++i) {
+    bool is_buy((i % 2) == 0);
+    // Twenty levels a side, so some levels fall outside the visible depth
+    Price price = is_buy ? 1880 - (i / 2) % 20 : 1890 + (i / 2) % 20;
+    Quantity qty = ((rand() % 10) + 1) * 100;
+    orders.push_back(simple::SimpleOrder(is_buy, price, qty));
+  }
+
+  // Held by value, so each is destroyed as its own type: OrderBook's
+  // destructor is not virtual
+  std::deque<TypedOrderBook> books;
+
+  uint64_t start_heap = heap_in_use();
+  for (uint32_t book = 0; book < num_books; ++book) {
+    books.emplace_back();
+  }
+  uint64_t empty_heap = heap_in_use();
+  MemoryUsage empty_usage = total_usage(books);
+
+  uint32_t order = 0;
+  for (uint32_t book = 0; book < num_books; ++book) {
+    for (uint32_t i = 0; i < orders_per_book; ++i) {
+      books[book].add(&orders[order++]);
+    }
+  }
+  uint64_t loaded_heap = heap_in_use();
+  MemoryUsage loaded_usage = total_usage(books);
+
+  std::cout << "  per empty book measured: "
+            << double(empty_heap - start_heap) / num_books << " bytes"
+            << std::endl;
+  print_usage("per empty book", empty_usage, num_books);
+
+  std::cout << "  per resting order measured: "
+            << double(loaded_heap - empty_heap) / order << " bytes"
+            << std::endl;
+  MemoryUsage order_usage;
+  order_usage.container_bytes =
+    loaded_usage.container_bytes - empty_usage.container_bytes;
+  order_usage.tracker_bytes =
+    loaded_usage.tracker_bytes - empty_usage.tracker_bytes;
+  order_usage.callback_bytes =
+    loaded_usage.callback_bytes - empty_usage.callback_bytes;
+  print_usage("per resting order", order_usage, order);
+}
+
+}
+
+int main(int argc, const char* argv[])
+{
+  uint32_t num_books = 10000;
+  uint32_t num_orders = 1000000;
+  if (argc > 1) {
+    num_books = atoi(argv[1]);
+  }
+  if (argc > 2) {
+    num_orders = atoi(argv[2]);
+  }
+  if (!num_books || num_orders < num_books) {
+    std::cerr << "usage: " << argv[0] << " [books] [orders]" << std::endl;
+    return 1;
+  }
+  std::cout << "memory test of " << num_orders << " resting orders in "
+            << num_books << " books" << std::endl;
+  srand(num_books);
+
+  std::cout << "testing order book with depth" << std::endl;
+  run_test<FullDepthOrderBook>(num_books, num_orders);
+
+  std::cout << "testing order book without depth" << std::endl;
+  run_test<NoDepthOrderBook>(num_books, num_orders);
+  return 0;
+}
@@ -0,0 +1,94 @@
+// Copyright (c) 2017 Object Computing, Inc.
+// All rights reserved.
+// See the file license.txt for licensing information.
+#include "alloc_counter.h"
+
+#include <cstdlib>
+#include <new>
+
+namespace {
+  liquibook::perf::AllocCounts counts = { 0, 0, 0, 0 };
+
+  // Each block is preceded by its requested size, padded to keep the
+  // alignment malloc provides.
+  const std::size_t header_size = 16;
+
+  void * counted_alloc(std::size_t size)
+  {
+    ++counts.allocations;
+    counts.bytes += size;
+    char * memory = static_cast<char *>(std::malloc(size + header_size));
+    if (!memory) {
+      throw std::bad_alloc();
+    }
+    *reinterpret_cast<std::size_t *>(memory) = size;
+    return memory + header_size;
+  }
+
+  void counted_free(void * memory)
+  {
+    if (memory) {
+      char * block = static_cast<char *>(memory) - header_size;
+      ++counts.deallocations;
+      counts.freed_bytes += *reinterpret_cast<std::size_t *>(block);
+      std::free(block);
+    }
+  }
+}
+
+namespace liquibook { namespace perf {
+
+AllocCounts alloc_counts()
+{
+  return counts;
+}
+
+} }
+
+void * operator new(std::size_t size)
+{
+  return counted_alloc(size);
+}
+
+void * operator new[](std::size_t size)
+{
+  return counted_alloc(size);
+}
+
+void * operator new(std::size_t size, const std::nothrow_t &) noexcept
+{
+  try {
+    return counted_alloc(size);
+  } catch (const std::bad_alloc &) {
+    return nullptr;
+  }
+}
+
+void * operator new[](std::size_t size, const std::nothrow_t &) noexcept
+{
+  try {
+    return counted_alloc(size);
+  } catch (const std::bad_alloc &) {
+    return nullptr;
+  }
+}
+
+void operator delete(void * memory) noexcept
+{
+  counted_free(memory);
+}
+
+void operator delete[](void * memory) noexcept
+{
+  counted_free(memory);
+}
+
+void operator delete(void * memory, std::size_t) noexcept
+{
+  counted_free(memory);
+}
+
+void operator delete[](void * memory, std::size_t) noexcept
+{
+  counted_free(memory);
+}
@@ -0,0 +1,24 @@
+// Copyright (c) 2017 Object Computing, Inc.
+// All rights reserved.
+// See the file license.txt for licensing information.
+#pragma once
+
+#include <stdint.h>
+
+namespace liquibook { namespace perf {
+
+/// @brief Heap activity seen by the replacement operator new and delete
+/// in alloc_counter.cpp.  Linking that file into a program interposes the
+/// global allocator for the whole program.  The counts are not
+/// synchronized; the performance tests are single threaded.
+struct AllocCounts {
+  uint64_t allocations;
+  uint64_t bytes;
+  uint64_t deallocations;
+  uint64_t freed_bytes;
+};
+
+/// @brief read the counts accumulated since the program started
+AllocCounts alloc_counts();
+
+} }
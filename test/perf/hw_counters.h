@@ -0,0 +1,142 @@
+// Copyright (c) 2017 Object Computing, Inc.
+// All rights reserved.
+// See the file license.txt for licensing information.
+#pragma once
+
+#include <stdint.h>
+#include <cstring>
+
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+namespace liquibook { namespace perf {
+
+/// @brief Hardware event counts for the calling thread, read with
+/// perf_event_open on Linux.  Counting is unavailable on other platforms,
+/// or when the kernel refuses access (see
+/// /proc/sys/kernel/perf_event_paranoid).
+class HwCounters {
+public:
+  enum Event {
+    cycles,
+    instructions,
+    l1d_misses,
+    llc_misses,
+    branch_misses,
+    event_count
+  };
+
+  struct Values {
+    uint64_t value[event_count];
+  };
+
+  HwCounters()
+  : available_(false)
+  {
+    for (int event = 0; event < event_count; ++event) {
+      fd_[event] = -1;
+    }
+#ifdef __linux__
+    open_event(cycles, PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES);
+    open_event(instructions, PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS);
+    open_event(l1d_misses, PERF_TYPE_HW_CACHE,
+               PERF_COUNT_HW_CACHE_L1D |
+               (PERF_COUNT_HW_CACHE_OP_READ << 8) |
+               (PERF_COUNT_HW_CACHE_RESULT_MISS << 16));
+    open_event(llc_misses, PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES);
+    open_event(branch_misses, PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES);
+    available_ = fd_[cycles] >= 0;
+#endif
+  }
+
+  ~HwCounters()
+  {
+#ifdef __linux__
+    for (int event = 0; event < event_count; ++event) {
+      if (fd_[event] >= 0) {
+        close(fd_[event]);
+      }
+    }
+#endif
+  }
+
+  /// @brief were the counters opened?
+  bool available() const { return available_; }
+
+  /// @brief was this particular event opened?
+  /// Some virtual machines expose only a subset of the events.
+  bool available(Event event) const { return fd_[event] >= 0; }
+
+  /// @brief zero and start all counters
+  void start()
+  {
+#ifdef __linux__
+    if (available_) {
+      ioctl(fd_[cycles], PERF_EVENT_IOC_RESET, PERF_IOC_FLAG_GROUP);
+      ioctl(fd_[cycles], PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+    }
+#endif
+  }
+
+  /// @brief stop all counters and read them
+  Values stop()
+  {
+    Values values;
+    memset(&values, 0, sizeof(values));
+#ifdef __linux__
+    if (available_) {
+      ioctl(fd_[cycles], PERF_EVENT_IOC_DISABLE, PERF_IOC_FLAG_GROUP);
+      for (int event = 0; event < event_count; ++event) {
+        uint64_t value = 0;
+        if (fd_[event] >= 0 &&
+            read(fd_[event], &value, sizeof(value)) == sizeof(value)) {
+          values.value[event] = value;
+        }
+      }
+    }
+#endif
+    return values;
+  }
+
+  /// @brief get a short label for an event
+  static const char * event_name(int event)
+  {
+    static const char * names[event_count] = {
+      "cycles", "instructions", "L1D misses", "LLC misses", "branch misses"
+    };
+    return names[event];
+  }
+
+private:
+  HwCounters(const HwCounters &);
+  HwCounters & operator =(const HwCounters &);
+
+#ifdef __linux__
+  void open_event(Event event, uint32_t type, uint64_t config)
+  {
+    // Every event joins the group led by cycles
+    int group = fd_[cycles];
+    if (event != cycles && group < 0) {
+      return;
+    }
+    perf_event_attr attr;
+    memset(&attr, 0, sizeof(attr));
+    attr.size = sizeof(attr);
+    attr.type = type;
+    attr.config = config;
+    attr.disabled = (event == cycles) ? 1 : 0;
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    fd_[event] = int(syscall(__NR_perf_event_open, &attr, 0, -1, group, 0));
+  }
+#endif
+
+  int fd_[event_count];
+  bool available_;
+};
+
+} }
@@ -3,10 +3,15 @@
 // See the file license.txt for licensing information.
 #include <simple/simple_order_book.h>
 #include <book/types.h>
+#include <book/order_slab.h>
+#include "alloc_counter.h"
+#include "hw_counters.h"
 
 #include <iostream>
+#include <vector>
 #include <stdexcept>
 #include <stdlib.h>
+#include <string.h>
 #include <time.h>
 
 using namespace liquibook;
@@ -15,6 +20,18 @@ using namespace liquibook::book;
 typedef simple::SimpleOrderBook<5> FullDepthOrderBook;
 typedef simple::SimpleOrderBook<1> BboOrderBook;
 typedef book::OrderBook<simple::SimpleOrder*> NoDepthOrderBook;
+typedef book::OrderSlab<simple::SimpleOrder> SimpleOrderSlab;
+
+// A depth book that builds only the callbacks its depth needs
+class DepthOnlyOrderBook
+  : public book::DepthOrderBook<simple::SimpleOrder*, 5>
+{
+public:
+  DepthOnlyOrderBook()
+  {
+    set_callback_interest(depth_callback_interest());
+  }
+};
 
 template <class TypedOrderBook, class TypedOrder>
 int run_test(TypedOrderBook& order_book, TypedOrder** orders, clock_t end) {
@@ -31,11 +48,46 @@ int run_test(TypedOrderBook& order_book, TypedOrder** orders, clock_t end) {
   return int(pp_order - orders);
 }
 
+void report_profile(int count,
+                    const perf::AllocCounts& before,
+                    const perf::AllocCounts& after,
+                    perf::HwCounters& hw,
+                    const perf::HwCounters::Values& hw_values)
+{
+  double ops = double(count);
+  std::cout << "  allocations per order: "
+            << double(after.allocations - before.allocations) / ops
+            << ", bytes per order: "
+            << double(after.bytes - before.bytes) / ops
+            << ", frees per order: "
+            << double(after.deallocations - before.deallocations) / ops
+            << std::endl;
+  if (!hw.available()) {
+    std::cout << "  hardware counters unavailable" << std::endl;
+    return;
+  }
+  std::cout << " ";
+  for (int event = 0; event < perf::HwCounters::event_count; ++event) {
+    if (hw.available(perf::HwCounters::Event(event))) {
+      std::cout << " " << perf::HwCounters::event_name(event)
+                << " per order: " << double(hw_values.value[event]) / ops;
+    }
+  }
+  std::cout << std::endl;
+}
+
 template <class TypedOrderBook>
-bool build_and_run_test(uint32_t dur_sec, uint32_t num_to_try) {
+bool build_and_run_test(uint32_t dur_sec, uint32_t num_to_try,
+                        bool profile) {
   std::cout << "trying run of " << num_to_try << " orders";
   TypedOrderBook order_book;
   simple::SimpleOrder** orders = new simple::SimpleOrder*[num_to_try + 1];
+  // Orders come from one contiguous slab rather than a heap block each
+  SimpleOrderSlab slab;
+  SimpleOrderSlab::Binding binding(slab);
+  std::vector<SimpleOrderSlab::Handle> handles;
+  handles.reserve(num_to_try + 1);
+  slab.reserve(num_to_try + 1);
   
   for (uint32_t i = 0; i <= num_to_try; ++i) {
     bool is_buy((i % 2) == 0);
@@ -65,16 +117,27 @@ bool build_and_run_test(uint32_t dur_sec, uint32_t num_to_try) {
     Price price = (rand() % 10) + delta;
     
     Quantity qty = ((rand() % 10) + 1) * 100;
-    orders[i] = new simple::SimpleOrder(is_buy, price, qty);
+    handles.push_back(slab.create(is_buy, price, qty));
+    orders[i] = handles.back().get();
   }
   orders[num_to_try] = nullptr; // Final null
   
+  // Only the order insertion loop is profiled
+  perf::HwCounters hw;
+  perf::AllocCounts allocs_before = perf::alloc_counts();
+  if (profile) {
+    hw.start();
+  }
+
   clock_t start = clock();
   clock_t stop = start + (dur_sec * CLOCKS_PER_SEC);
 
   int count = run_test(order_book, orders, stop);
+
+  perf::HwCounters::Values hw_values = hw.stop();
+  perf::AllocCounts allocs_after = perf::alloc_counts();
   for (uint32_t i = 0; i <= num_to_try; ++i) {
-    delete orders[i];
+    slab.destroy(handles[i]);
   }
   delete [] orders;
   if (count > 0) {
@@ -84,6 +147,9 @@ bool build_and_run_test(uint32_t dur_sec, uint32_t num_to_try) {
               << std::endl;
     uint32_t remain = uint32_t(order_book.bids().size() + order_book.asks().size());
     std::cout << "Run matched " << count - remain << " orders" << std::endl;
+    if (profile) {
+      report_profile(count, allocs_before, allocs_after, hw, hw_values);
+    }
     return true;
   } else {
     std::cout << " - not enough orders" << std::endl;
@@ -96,10 +162,16 @@ bool build_and_run_test(uint32_t dur_sec, uint32_t num_to_try) {
 int main(int argc, const char* argv[])
 {
   uint32_t dur_sec = 3;
-  if (argc > 1) {
-    dur_sec = atoi(argv[1]);
-    if (!dur_sec) { 
-      dur_sec = 3;
+  // --profile reports allocations and hardware counters per order
+  bool profile = false;
+  for (int arg = 1; arg < argc; ++arg) {
+    if (strcmp(argv[arg], "--profile") == 0) {
+      profile = true;
+    } else {
+      dur_sec = atoi(argv[arg]);
+      if (!dur_sec) { 
+        dur_sec = 3;
+      }
     }
   }
   std::cout << dur_sec << " sec performance test of order book" << std::endl;
@@ -110,7 +182,19 @@ int main(int argc, const char* argv[])
     std::cout << "testing order book with depth" << std::endl;
     uint32_t num_to_try = dur_sec * 125000;
     while (true) {
-      if (build_and_run_test<FullDepthOrderBook>(dur_sec, num_to_try)) {
+      if (build_and_run_test<FullDepthOrderBook>(dur_sec, num_to_try, profile)) {
+        break;
+      } else {
+        num_to_try *= 2;
+      }
+    }
+  }
+
+  {
+    std::cout << "testing depth book with depth callbacks only" << std::endl;
+    uint32_t num_to_try = dur_sec * 125000;
+    while (true) {
+      if (build_and_run_test<DepthOnlyOrderBook>(dur_sec, num_to_try, profile)) {
         break;
       } else {
         num_to_try *= 2;
@@ -122,7 +206,7 @@ int main(int argc, const char* argv[])
     std::cout << "testing order book with bbo" << std::endl;
     uint32_t num_to_try = dur_sec * 125000;
     while (true) {
-      if (build_and_run_test<BboOrderBook>(dur_sec, num_to_try)) {
+      if (build_and_run_test<BboOrderBook>(dur_sec, num_to_try, profile)) {
         break;
       } else {
         num_to_try *= 2;
@@ -134,7 +218,7 @@ int main(int argc, const char* argv[])
     std::cout << "testing order book without depth" << std::endl;
     uint32_t num_to_try = dur_sec * 125000;
     while (true) {
-      if (build_and_run_test<NoDepthOrderBook>(dur_sec, num_to_try)) {
+      if (build_and_run_test<NoDepthOrderBook>(dur_sec, num_to_try, profile)) {
         break;
       } else {
         num_to_try *= 2;
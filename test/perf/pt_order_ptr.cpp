@@ -0,0 +1,218 @@
+// Copyright (c) 2017 Object Computing, Inc.
+// All rights reserved.
+// See the file license.txt for licensing information.
+
+// Compares the cost of the order handle used as OrderPtr: a raw pointer,
+// std::shared_ptr (atomic count), IntrusivePtr (plain count in the order)
+// and SlabPtr (32-bit index into an OrderSlab).  Every book sees the same
+// orders and handles the same callbacks.
+#include <simple/simple_order.h>
+#include <book/depth_order_book.h>
+#include <book/intrusive_ptr.h>
+#include <book/order_slab.h>
+#include "alloc_counter.h"
+
+#include <chrono>
+#include <iostream>
+#include <memory>
+#include <vector>
+#include <stdlib.h>
+
+using namespace liquibook;
+using namespace liquibook::book;
+
+// SimpleOrder has no virtual destructor, so each order type here is final
+// and only ever deleted as itself.
+class PlainOrder final : public simple::SimpleOrder
+{
+public:
+  PlainOrder(bool is_buy, Price price, Quantity qty)
+  : simple::SimpleOrder(is_buy, price, qty)
+  {
+  }
+};
+
+class CountedOrder final : public simple::SimpleOrder,
+                           public RefCounted<CountedOrder>
+{
+public:
+  CountedOrder(bool is_buy, Price price, Quantity qty)
+  : simple::SimpleOrder(is_buy, price, qty)
+  {
+  }
+};
+
+/// @brief a depth book that keeps its orders up to date, for any OrderPtr
+template <class OrderPtr>
+class HandleOrderBook : public DepthOrderBook<OrderPtr> {
+public:
+  typedef typename DepthOrderBook<OrderPtr>::TypedCallback TypedCallback;
+
+  virtual void perform_callback(TypedCallback& cb)
+  {
+    DepthOrderBook<OrderPtr>::perform_callback(cb);
+    switch(cb.type) {
+      case TypedCallback::cb_order_accept:
+        cb.order->accept();
+        break;
+      case TypedCallback::cb_order_fill: {
+        Cost fill_cost = cb.quantity * cb.price;
+        cb.matched_order->fill(cb.quantity, fill_cost, 0);
+        cb.order->fill(cb.quantity, fill_cost, 0);
+        break;
+      }
+      case TypedCallback::cb_order_cancel:
+        cb.order->cancel();
+        break;
+      default:
+        break;
+    }
+  }
+};
+
+struct OrderSpec {
+  bool is_buy;
+  Price price;
+  Quantity qty;
+};
+
+inline PlainOrder * make_order(const OrderSpec & spec, PlainOrder *)
+{
+  return new PlainOrder(spec.is_buy, spec.price, spec.qty);
+}
+
+inline std::shared_ptr<simple::SimpleOrder> make_order(const OrderSpec & spec,
+  std::shared_ptr<simple::SimpleOrder>)
+{
+  return std::make_shared<simple::SimpleOrder>(
+    spec.is_buy, spec.price, spec.qty);
+}
+
+inline IntrusivePtr<CountedOrder> make_order(const OrderSpec & spec,
+                                             IntrusivePtr<CountedOrder>)
+{
+  return make_intrusive<CountedOrder>(spec.is_buy, spec.price, spec.qty);
+}
+
+inline SlabPtr<simple::SimpleOrder> make_order(const OrderSpec & spec,
+                                               SlabPtr<simple::SimpleOrder>)
+{
+  return OrderSlab<simple::SimpleOrder>::current()->create(
+    spec.is_buy, spec.price, spec.qty);
+}
+
+inline void release_order(PlainOrder * order)
+{
+  delete order;
+}
+
+inline void release_order(SlabPtr<simple::SimpleOrder> order)
+{
+  OrderSlab<simple::SimpleOrder>::current()->destroy(order);
+}
+
+template <class OrderPtr>
+inline void release_order(const OrderPtr &)
+{
+}
+
+/// @brief add every order to a fresh book
+/// @return nanoseconds per order
+template <class OrderPtr>
+double run_test(const std::vector<OrderSpec> & specs,
+                perf::AllocCounts & allocs)
+{
+  std::vector<OrderPtr> orders;
+  orders.reserve(specs.size());
+  for (size_t pos = 0; pos < specs.size(); ++pos) {
+    orders.push_back(make_order(specs[pos], OrderPtr()));
+  }
+  HandleOrderBook<OrderPtr> order_book;
+
+  perf::AllocCounts before = perf::alloc_counts();
+  std::chrono::steady_clock::time_point start =
+    std::chrono::steady_clock::now();
+  for (size_t pos = 0; pos < orders.size(); ++pos) {
+    order_book.add(orders[pos]);
+  }
+  std::chrono::steady_clock::time_point stop =
+    std::chrono::steady_clock::now();
+  perf::AllocCounts after = perf::alloc_counts();
+  allocs.allocations = after.allocations - before.allocations;
+  allocs.bytes = after.bytes - before.bytes;
+
+  for (size_t pos = 0; pos < orders.size(); ++pos) {
+    release_order(orders[pos]);
+  }
+  return double(std::chrono::duration_cast<std::chrono::nanoseconds>(
+    stop - start).count()) / double(orders.size());
+}
+
+/// @brief the best time seen for one kind of handle
+struct Result {
+  const char * name;
+  double best_ns;
+  perf::AllocCounts allocs;
+};
+
+template <class OrderPtr>
+void run_round(Result & result, const std::vector<OrderSpec> & specs)
+{
+  double ns = run_test<OrderPtr>(specs, result.allocs);
+  if (result.best_ns == 0 || ns < result.best_ns) {
+    result.best_ns = ns;
+  }
+}
+
+int main(int argc, const char* argv[])
+{
+  size_t count = 500000;
+  int rounds = 5;
+  if (argc > 1) {
+    count = size_t(atoi(argv[1]));
+  }
+  if (argc > 2) {
+    rounds = atoi(argv[2]);
+  }
+  if (!count || rounds < 1) {
+    std::cerr << "usage: pt_order_ptr [orders [rounds]]" << std::endl;
+    return 1;
+  }
+
+  // The same crossing order stream as pt_order_book
+  srand(1);
+  std::vector<OrderSpec> specs(count);
+  for (size_t pos = 0; pos < count; ++pos) {
+    OrderSpec & spec = specs[pos];
+    spec.is_buy = (pos % 2) == 0;
+    spec.price = Price(rand() % 10) + (spec.is_buy ? 1880 : 1884);
+    spec.qty = Quantity((rand() % 10) + 1) * 100;
+  }
+
+  std::cout << "adding " << count << " orders, best of " << rounds
+            << " rounds" << std::endl;
+  Result results[] = {
+    { "raw pointer", 0, perf::AllocCounts() },
+    { "std::shared_ptr", 0, perf::AllocCounts() },
+    { "IntrusivePtr", 0, perf::AllocCounts() },
+    { "SlabPtr", 0, perf::AllocCounts() }
+  };
+  const size_t result_count = sizeof(results) / sizeof(results[0]);
+  OrderSlab<simple::SimpleOrder> slab;
+  OrderSlab<simple::SimpleOrder>::Binding binding(slab);
+  // Interleave the rounds so drift on the machine affects each alike
+  for (int round = 0; round < rounds; ++round) {
+    run_round<PlainOrder *>(results[0], specs);
+    run_round<std::shared_ptr<simple::SimpleOrder> >(results[1], specs);
+    run_round<IntrusivePtr<CountedOrder> >(results[2], specs);
+    run_round<SlabPtr<simple::SimpleOrder> >(results[3], specs);
+  }
+  for (size_t pos = 0; pos < result_count; ++pos) {
+    const Result & result = results[pos];
+    std::cout << "  " << result.name << ": " << result.best_ns
+              << " ns per order, "
+              << double(result.allocs.allocations) / double(count)
+              << " allocations per order" << std::endl;
+  }
+  return 0;
+}
@@ -0,0 +1,98 @@
+// Copyright (c) 2017 Object Computing, Inc.
+// All rights reserved.
+// See the file license.txt for licensing information.
+
+// Formats a book's trace ring as a readable timeline or as Chrome trace JSON.
+//
+//   trace_dump [--chrome] [--ticks-per-us N] [file]
+//
+// With a file, formats events written by TraceDump::save().  Without one,
+// runs a short mixed regular / all-or-none / stop order scenario on a
+// traced book and formats the result.
+#include <simple/simple_order_book.h>
+#include <book/trace_dump.h>
+
+#include <deque>
+#include <fstream>
+#include <iostream>
+#include <cstdlib>
+#include <cstring>
+
+using namespace liquibook;
+using namespace liquibook::book;
+
+#ifndef LIQUIBOOK_ENABLE_TRACE
+#error trace_dump must be built with LIQUIBOOK_ENABLE_TRACE defined
+#endif
+
+typedef simple::SimpleOrderBook<5> TracedOrderBook;
+
+namespace {
+
+// Orders live by value, at stable addresses, for as long as the book
+typedef std::deque<simple::SimpleOrder> Orders;
+
+void run_scenario(TracedOrderBook & order_book, Orders & orders)
+{
+  srand(1);
+  for (int i = 0; i < 200; ++i) {
+    bool is_buy = (i % 2) == 0;
+    Price price = (is_buy ? 1880 : 1884) + Price(rand() % 10);
+    Quantity qty = Quantity((rand() % 10 + 1) * 100);
+    OrderConditions conditions = (rand() % 4) == 0 
+      ? OrderCondition::oc_all_or_none : OrderCondition::oc_no_conditions;
+    Price stop = (rand() % 10) == 0 ? price : 0;
+    orders.emplace_back(is_buy, price, qty, stop, conditions);
+    order_book.add(&orders.back(), conditions);
+    if ((rand() % 8) == 0) {
+      order_book.cancel(&orders[rand() % orders.size()]);
+    }
+  }
+}
+
+}
+
+int main(int argc, const char * argv[])
+{
+  bool chrome = false;
+  double ticks_per_us = 0.0;
+  const char * file = nullptr;
+  for (int pos = 1; pos < argc; ++pos) {
+    if (strcmp(argv[pos], "--chrome") == 0) {
+      chrome = true;
+    } else if (strcmp(argv[pos], "--ticks-per-us") == 0 && pos + 1 < argc) {
+      ticks_per_us = atof(argv[++pos]);
+    } else if (argv[pos][0] == '-') {
+      std::cerr << "usage: " << argv[0]
+                << " [--chrome] [--ticks-per-us N] [file]" << std::endl;
+      return 1;
+    } else {
+      file = argv[pos];
+    }
+  }
+
+  TraceDump::Events events;
+  Orders orders;
+  if (file) {
+    std::ifstream in(file, std::ios::binary);
+    if (!TraceDump::load(in, events)) {
+      std::cerr << "Cannot read trace events from " << file << std::endl;
+      return 1;
+    }
+  } else {
+    TracedOrderBook order_book;
+    run_scenario(order_book, orders);
+    order_book.trace().snapshot(events);
+  }
+
+  // Ticks are only meaningful on the machine that recorded them
+  if (ticks_per_us <= 0.0) {
+    ticks_per_us = TraceDump::ticks_per_microsecond();
+  }
+  if (chrome) {
+    TraceDump::chrome_trace(std::cout, events, ticks_per_us);
+  } else {
+    TraceDump::timeline(std::cout, events, ticks_per_us);
+  }
+  return 0;
+}
@@ -764,7 +764,8 @@ BOOST_AUTO_TEST_CASE(TestBboMatchMarketOrderBid)
   BOOST_CHECK(add_and_verify(order_book, &bid1, false));
 
   // Verify sizes
-  BOOST_CHECK_EQUAL(2, order_book.bids().size());
+  BOOST_CHECK_EQUAL(1, order_book.bids().size());
+  BOOST_CHECK_EQUAL(1, order_book.marketBids().size());
   BOOST_CHECK_EQUAL(0, order_book.asks().size());
 
   // Verify depth
@@ -802,7 +803,8 @@ BOOST_AUTO_TEST_CASE(TestBboMatchMarketOrderAsk)
 
   // Verify sizes
   BOOST_CHECK_EQUAL(0, order_book.bids().size());
-  BOOST_CHECK_EQUAL(2, order_book.asks().size());
+  BOOST_CHECK_EQUAL(1, order_book.asks().size());
+  BOOST_CHECK_EQUAL(1, order_book.marketAsks().size());
 
   // Verify depth
   DepthCheck<SimpleOrderBook> dc(order_book.depth());
@@ -839,7 +841,8 @@ BOOST_AUTO_TEST_CASE(TestBboMatchMultipleMarketOrderBid)
   BOOST_CHECK(add_and_verify(order_book, &bid2, false));
 
   // Verify sizes
-  BOOST_CHECK_EQUAL(3, order_book.bids().size());
+  BOOST_CHECK_EQUAL(1, order_book.bids().size());
+  BOOST_CHECK_EQUAL(2, order_book.marketBids().size());
   BOOST_CHECK_EQUAL(0, order_book.asks().size());
 
   // Verify depth
@@ -881,7 +884,8 @@ BOOST_AUTO_TEST_CASE(TestBboMatchMultipleMarketOrderAsk)
 
   // Verify sizes
   BOOST_CHECK_EQUAL(0, order_book.bids().size());
-  BOOST_CHECK_EQUAL(3, order_book.asks().size());
+  BOOST_CHECK_EQUAL(1, order_book.asks().size());
+  BOOST_CHECK_EQUAL(2, order_book.marketAsks().size());
 
   // Verify depth
   DepthCheck<SimpleOrderBook> dc(order_book.depth());
@@ -898,7 +902,8 @@ BOOST_AUTO_TEST_CASE(TestBboMatchMultipleMarketOrderAsk)
 
   // Verify sizes
   BOOST_CHECK_EQUAL(0, order_book.bids().size());
-  BOOST_CHECK_EQUAL(2, order_book.asks().size());
+  BOOST_CHECK_EQUAL(1, order_book.asks().size());
+  BOOST_CHECK_EQUAL(1, order_book.marketAsks().size());
 
   // Verify depth
   dc.reset();
@@ -0,0 +1,100 @@
+// Copyright (c) 2017 Object Computing, Inc.
+// All rights reserved.
+// See the file license.txt for licensing information.
+
+#define BOOST_TEST_NO_MAIN LiquibookTest
+#include <boost/test/unit_test.hpp>
+
+#include "ut_utils.h"
+#include <book/depth.h>
+#include <simple/simple_order.h>
+
+// The counters only exist when the whole test program is built with them.
+#ifdef LIQUIBOOK_ENABLE_STATS
+
+namespace liquibook {
+
+using book::Depth;
+using simple::SimpleOrder;
+
+BOOST_AUTO_TEST_CASE(TestStatsCountOperations)
+{
+  SimpleOrderBook order_book;
+  SimpleOrder ask0(false, 1251, 100);
+  SimpleOrder ask1(false, 1252, 100);
+  SimpleOrder ask2(false, 1253, 100);
+  SimpleOrder bid0(true,  1252, 200);
+  SimpleOrder bid1(true,  1240, 100);
+
+  BOOST_CHECK(add_and_verify(order_book, &ask0, false));
+  BOOST_CHECK(add_and_verify(order_book, &ask1, false));
+  BOOST_CHECK(add_and_verify(order_book, &ask2, false));
+  BOOST_CHECK_EQUAL(0u, order_book.stats().fills.get());
+
+  // Sweep two ask levels
+  BOOST_CHECK(add_and_verify(order_book, &bid0, true, true));
+  const book::OrderBookStats & stats = order_book.stats();
+  BOOST_CHECK_EQUAL(4u, stats.orders_added.get());
+  BOOST_CHECK_EQUAL(2u, stats.fills.get());
+  BOOST_CHECK_EQUAL(1u, stats.aggressive_orders.get());
+  BOOST_CHECK_EQUAL(2u, stats.levels_swept.get());
+
+  BOOST_CHECK(cancel_and_verify(order_book, &ask2, simple::os_cancelled));
+  BOOST_CHECK_EQUAL(1u, stats.orders_cancelled.get());
+  BOOST_CHECK(stats.trackers_scanned.get() >= 1u);
+
+  BOOST_CHECK(add_and_verify(order_book, &bid1, false));
+  BOOST_CHECK(replace_and_verify(order_book, &bid1, -50));
+  BOOST_CHECK_EQUAL(1u, stats.orders_replaced.get());
+
+  BOOST_CHECK_EQUAL(7u, stats.operations.get());
+  BOOST_CHECK(stats.callbacks_generated.get() >= stats.operations.get());
+  BOOST_CHECK_EQUAL(0u, stats.stops_triggered.get());
+  BOOST_CHECK_EQUAL(0u, stats.deferred_aon_checks.get());
+}
+
+BOOST_AUTO_TEST_CASE(TestStatsCountExcessLevels)
+{
+  Depth<5> depth;
+  // Fill the visible bid levels, worst price first
+  for (book::Price price = 1230; price < 1235; ++price) {
+    depth.add_order(price, 100, true);
+  }
+  BOOST_CHECK_EQUAL(0u, depth.stats().excess_spills.get());
+
+  // A better price pushes the worst visible level into excess
+  depth.add_order(1235, 100, true);
+  BOOST_CHECK_EQUAL(1u, depth.stats().excess_spills.get());
+
+  // A worse price goes straight into excess
+  depth.add_order(1220, 100, true);
+  BOOST_CHECK_EQUAL(1u, depth.stats().excess_inserts.get());
+
+  // Erasing the best level restores the best excess level
+  depth.close_order(1235, 100, true);
+  BOOST_CHECK_EQUAL(1u, depth.stats().excess_restores.get());
+  BOOST_CHECK_EQUAL(1230u, depth.last_bid_level()->price());
+}
+
+} // namespace
+
+#else // LIQUIBOOK_ENABLE_STATS
+
+namespace liquibook {
+
+BOOST_AUTO_TEST_CASE(TestStatsCompiledOut)
+{
+  // The updates vanish, arguments and all, so they cannot name a counter
+  LIQUIBOOK_STAT_ADD(no_such_counter, 1);
+  LIQUIBOOK_STATS_ONLY(BOOST_ERROR("counter code compiled in");)
+
+  SimpleOrderBook order_book;
+  simple::SimpleOrder ask0(false, 1251, 100);
+  simple::SimpleOrder bid0(true,  1251, 100);
+  BOOST_CHECK(add_and_verify(order_book, &ask0, false));
+  BOOST_CHECK(add_and_verify(order_book, &bid0, true, true));
+}
+
+} // namespace
+
+#endif // LIQUIBOOK_ENABLE_STATS
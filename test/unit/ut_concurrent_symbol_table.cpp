@@ -0,0 +1,165 @@
+// Copyright (c) 2017 Object Computing, Inc.
+// All rights reserved.
+// See the file license.txt for licensing information.
+
+#define BOOST_TEST_NO_MAIN LiquibookTest
+#include <boost/test/unit_test.hpp>
+
+#include <book/concurrent_symbol_table.h>
+#include <book/order_book.h>
+#include <simple/simple_order.h>
+#include <atomic>
+#include <thread>
+#include <vector>
+
+namespace liquibook {
+
+using book::ConcurrentSymbolTable;
+using book::SymbolId;
+using book::INVALID_SYMBOL_ID;
+
+namespace {
+std::atomic<int> live_books(0);
+
+/// @brief a book that counts live instances and poisons itself on delete
+class CountedBook final : public book::OrderBook<simple::SimpleOrder *> {
+public:
+  explicit CountedBook(const std::string & symbol)
+  : book::OrderBook<simple::SimpleOrder *>(symbol),
+    alive_(true)
+  {
+    ++live_books;
+  }
+
+  ~CountedBook()
+  {
+    alive_ = false;
+    --live_books;
+  }
+
+  bool alive() const { return alive_; }
+
+private:
+  volatile bool alive_;
+};
+
+typedef ConcurrentSymbolTable<CountedBook> BookTable;
+
+std::unique_ptr<CountedBook> make_book(const std::string & symbol)
+{
+  return std::unique_ptr<CountedBook>(new CountedBook(symbol));
+}
+}
+
+BOOST_AUTO_TEST_CASE(TestConcurrentSymbolTableBasics)
+{
+  {
+    BookTable table(4);
+    size_t reader = table.register_reader();
+    SymbolId ibm = table.add("IBM", make_book("IBM"));
+    SymbolId msft = table.add("MSFT", make_book("MSFT"));
+    BOOST_CHECK_EQUAL(0u, ibm);
+    BOOST_CHECK_EQUAL(1u, msft);
+    BOOST_CHECK_EQUAL(INVALID_SYMBOL_ID, table.add("IBM", make_book("IBM")));
+    BOOST_CHECK_EQUAL(2, live_books.load());
+    BOOST_CHECK_EQUAL(2u, table.size());
+
+    {
+      BookTable::ReadGuard guard(table, reader);
+      BOOST_CHECK_EQUAL(msft, table.find("MSFT"));
+      BOOST_CHECK_EQUAL("MSFT", table.find(msft)->symbol());
+      BOOST_CHECK(table.find(SymbolId(2)) == nullptr);
+      BOOST_CHECK(table.find(SymbolId(99)) == nullptr);
+    }
+
+    // A reader inside a guard keeps a removed book alive
+    {
+      BookTable::ReadGuard guard(table, reader);
+      CountedBook * held = table.find(ibm);
+      BOOST_CHECK(table.remove(ibm));
+      BOOST_CHECK(!table.remove(ibm));
+      BOOST_CHECK(table.find(ibm) == nullptr);
+      BOOST_CHECK_EQUAL(INVALID_SYMBOL_ID, table.find("IBM"));
+      table.reclaim();
+      BOOST_CHECK(held->alive());
+      BOOST_CHECK_EQUAL(2, live_books.load());
+    }
+    table.reclaim();
+    BOOST_CHECK_EQUAL(1, live_books.load());
+    BOOST_CHECK_EQUAL(0u, table.epochs().pending());
+
+    // Ids are not reused
+    BOOST_CHECK_EQUAL(2u, table.add("IBM", make_book("IBM")));
+    BOOST_CHECK_EQUAL(3u, table.add("AAPL", make_book("AAPL")));
+    BOOST_CHECK_THROW(table.add("GOOG", make_book("GOOG")), std::runtime_error);
+  }
+  BOOST_CHECK_EQUAL(0, live_books.load());
+}
+
+BOOST_AUTO_TEST_CASE(TestConcurrentSymbolTableThreads)
+{
+  const int SYMBOLS = 8;
+  const int ROUNDS = 2000;
+  const int READERS = 3;
+  {
+    BookTable table(SYMBOLS * ROUNDS);
+    std::atomic<bool> done(false);
+    std::atomic<int> bad_reads(0);
+    std::atomic<long> lookups(0);
+
+    std::vector<std::thread> readers;
+    for (int count = 0; count < READERS; ++count) {
+      readers.push_back(std::thread([&]() {
+        size_t reader = table.register_reader();
+        long found = 0;
+        while (!done.load()) {
+          for (int symbol = 0; symbol < SYMBOLS; ++symbol) {
+            BookTable::ReadGuard guard(table, reader);
+            std::string name = "S" + std::to_string(symbol);
+            SymbolId id = table.find(name);
+            if (id == INVALID_SYMBOL_ID) {
+              continue;
+            }
+            CountedBook * book = table.find(id);
+            if (book) {
+              ++found;
+              // The book must stay intact until the guard ends
+              if (!book->alive() || book->symbol() != name) {
+                ++bad_reads;
+              }
+            }
+          }
+        }
+        lookups += found;
+      }));
+    }
+
+    // Churn the universe while the readers route
+    for (int round = 0; round < ROUNDS; ++round) {
+      std::vector<SymbolId> ids;
+      for (int symbol = 0; symbol < SYMBOLS; ++symbol) {
+        std::string name = "S" + std::to_string(symbol);
+        ids.push_back(table.add(name, make_book(name)));
+      }
+      if (round % 64 == 0) {
+        std::this_thread::yield();
+      }
+      for (size_t pos = 0; pos < ids.size(); ++pos) {
+        BOOST_REQUIRE(table.remove(ids[pos]));
+      }
+    }
+    done = true;
+    for (size_t pos = 0; pos < readers.size(); ++pos) {
+      readers[pos].join();
+    }
+
+    BOOST_CHECK_EQUAL(0, bad_reads.load());
+    BOOST_CHECK_EQUAL(0u, table.size());
+    table.reclaim();
+    BOOST_CHECK_EQUAL(0u, table.epochs().pending());
+    BOOST_CHECK_EQUAL(0, live_books.load());
+  }
+  BOOST_CHECK_EQUAL(0, live_books.load());
+}
+
+} // namespace
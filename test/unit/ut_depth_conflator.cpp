@@ -0,0 +1,242 @@
+// Copyright (c) 2017 Object Computing, Inc.
+// All rights reserved.
+// See the file license.txt for licensing information.
+
+#define BOOST_TEST_NO_MAIN LiquibookTest
+#include <boost/test/unit_test.hpp>
+
+#include <book/depth_conflator.h>
+#include <simple/simple_order_book.h>
+#include "ut_utils.h"
+#include <memory>
+#include <thread>
+#include <vector>
+
+namespace liquibook {
+
+using book::DepthConflator;
+using simple::SimpleOrder;
+
+typedef simple::SimpleOrderBook<5> SimpleOrderBook;
+typedef book::DepthOrderBook<SimpleOrder*, 5> DepthBook;
+
+namespace {
+
+// Records each depth callback, which levels it reported as changed and
+// when the first request behind it arrived
+class ConflatedDepthListener : public SimpleOrderBook::TypedDepthListener {
+public:
+  struct Change {
+    const DepthBook* book;
+    int bids_changed;
+    int asks_changed;
+    book::Timestamp arrival;
+  };
+
+  virtual void on_depth_change(const DepthBook* book,
+                               const DepthBook::DepthTracker* depth)
+  {
+    Change change = { book, 0, 0, book->depth_arrival_time() };
+    book::ChangeId published = depth->last_published_change();
+    for (int level = 0; level < 5; ++level) {
+      change.bids_changed += depth->bids()[level].changed_since(published);
+      change.asks_changed += depth->asks()[level].changed_since(published);
+    }
+    changes_.push_back(change);
+  }
+
+  std::vector<Change> changes_;
+};
+
+// Destroys another book from the first depth callback it hears
+class DestroyingDepthListener : public SimpleOrderBook::TypedDepthListener {
+public:
+  explicit DestroyingDepthListener(std::unique_ptr<SimpleOrderBook> & victim)
+  : victim_(victim)
+  {
+  }
+
+  virtual void on_depth_change(const DepthBook* book,
+                               const DepthBook::DepthTracker* depth)
+  {
+    victim_.reset();
+  }
+
+  std::unique_ptr<SimpleOrderBook> & victim_;
+};
+
+}
+
+BOOST_AUTO_TEST_CASE(TestDepthConflatorFlush)
+{
+  DepthConflator conflator;
+  ConflatedDepthListener listener;
+  SimpleOrderBook ibm;
+  SimpleOrderBook msft;
+  ibm.set_depth_listener(&listener);
+  msft.set_depth_listener(&listener);
+  SimpleOrderBook::BboSlot bbo_slot;
+  ibm.set_bbo_slot(&bbo_slot);
+  ibm.set_depth_conflator(&conflator);
+  msft.set_depth_conflator(&conflator);
+
+  SimpleOrder bid0(true, 1250, 100);
+  SimpleOrder bid1(true, 1240, 300);
+  SimpleOrder bid2(true, 1250, 200);
+  SimpleOrder ask0(false, 1260, 200);
+  SimpleOrder msft_bid(true, 3000, 100);
+
+  // Changes are held
+  uint64_t bbo_sequence = bbo_slot.sequence();
+  BOOST_CHECK(add_and_verify(ibm, &bid0, false));
+  BOOST_CHECK(add_and_verify(ibm, &bid1, false));
+  BOOST_CHECK(add_and_verify(ibm, &bid2, false));
+  BOOST_CHECK(add_and_verify(ibm, &ask0, false));
+  BOOST_CHECK(add_and_verify(msft, &msft_bid, false));
+  BOOST_CHECK_EQUAL(0u, listener.changes_.size());
+  BOOST_CHECK_EQUAL(bbo_sequence, bbo_slot.sequence());
+  BOOST_CHECK_EQUAL(2u, conflator.dirty_books());
+  BOOST_CHECK_EQUAL(5u, conflator.held_changes());
+
+  // One net update per book
+  BOOST_CHECK_EQUAL(2u, conflator.flush());
+  BOOST_REQUIRE_EQUAL(2u, listener.changes_.size());
+  BOOST_CHECK(listener.changes_[0].book == &ibm);
+  BOOST_CHECK_EQUAL(2, listener.changes_[0].bids_changed);
+  BOOST_CHECK_EQUAL(1, listener.changes_[0].asks_changed);
+  BOOST_CHECK(listener.changes_[1].book == &msft);
+  BOOST_CHECK_EQUAL(1, listener.changes_[1].bids_changed);
+  BOOST_CHECK(bbo_sequence != bbo_slot.sequence());
+  SimpleOrderBook::BboSlot::Snapshot bbo;
+  bbo_slot.read(bbo);
+  BOOST_CHECK_EQUAL(1250u, bbo.bids[0].price);
+  BOOST_CHECK_EQUAL(300u, bbo.bids[0].qty);
+  BOOST_CHECK_EQUAL(0u, conflator.dirty_books());
+  BOOST_CHECK_EQUAL(0u, conflator.flush());
+
+  // Only the levels changed since the last flush are reported
+  listener.changes_.clear();
+  BOOST_CHECK(cancel_and_verify(ibm, &bid1, simple::os_cancelled));
+  BOOST_CHECK_EQUAL(1u, conflator.flush());
+  BOOST_REQUIRE_EQUAL(1u, listener.changes_.size());
+  BOOST_CHECK_EQUAL(1, listener.changes_[0].bids_changed);
+  BOOST_CHECK_EQUAL(0, listener.changes_[0].asks_changed);
+
+  // Detaching publishes what is held, then every change again
+  listener.changes_.clear();
+  BOOST_CHECK(cancel_and_verify(msft, &msft_bid, simple::os_cancelled));
+  msft.set_depth_conflator(nullptr);
+  BOOST_CHECK_EQUAL(1u, listener.changes_.size());
+  BOOST_CHECK_EQUAL(0u, conflator.dirty_books());
+  SimpleOrder msft_ask(false, 3100, 100);
+  BOOST_CHECK(add_and_verify(msft, &msft_ask, false));
+  BOOST_CHECK_EQUAL(2u, listener.changes_.size());
+}
+
+BOOST_AUTO_TEST_CASE(TestDepthConflatorBudgetAndInterval)
+{
+  DepthConflator::Clock::duration interval = std::chrono::milliseconds(10);
+  DepthConflator conflator(3, interval);
+  ConflatedDepthListener listener;
+  SimpleOrderBook book;
+  book.set_depth_listener(&listener);
+  book.set_depth_conflator(&conflator);
+
+  // The third held change flushes
+  SimpleOrder bid0(true, 1250, 100);
+  SimpleOrder bid1(true, 1249, 100);
+  SimpleOrder bid2(true, 1248, 100);
+  BOOST_CHECK(add_and_verify(book, &bid0, false));
+  BOOST_CHECK(add_and_verify(book, &bid1, false));
+  BOOST_CHECK_EQUAL(0u, listener.changes_.size());
+  BOOST_CHECK(add_and_verify(book, &bid2, false));
+  BOOST_REQUIRE_EQUAL(1u, listener.changes_.size());
+  BOOST_CHECK_EQUAL(3, listener.changes_[0].bids_changed);
+  BOOST_CHECK_EQUAL(1u, conflator.flushes());
+
+  // Polling flushes only once the interval has passed
+  SimpleOrder ask0(false, 1260, 100);
+  BOOST_CHECK(add_and_verify(book, &ask0, false));
+  DepthConflator::Clock::time_point start = DepthConflator::Clock::now();
+  BOOST_CHECK_EQUAL(0u, conflator.poll(start));
+  BOOST_CHECK_EQUAL(1u, conflator.poll(start + 2 * interval));
+  BOOST_CHECK_EQUAL(2u, listener.changes_.size());
+
+  // A book that goes away is forgotten
+  {
+    std::unique_ptr<SimpleOrderBook> other(new SimpleOrderBook);
+    other->set_depth_conflator(&conflator);
+    SimpleOrder bid(true, 1250, 100);
+    BOOST_CHECK(add_and_verify(*other, &bid, false));
+    BOOST_CHECK_EQUAL(1u, conflator.dirty_books());
+  }
+  BOOST_CHECK_EQUAL(0u, conflator.dirty_books());
+  BOOST_CHECK_EQUAL(0u, conflator.flush());
+  BOOST_CHECK_EQUAL(2u, conflator.flushes());
+  BOOST_CHECK(interval == conflator.flush_interval());
+}
+
+BOOST_AUTO_TEST_CASE(TestDepthConflatorForgetDuringFlush)
+{
+  DepthConflator conflator;
+  ConflatedDepthListener listener;
+  std::unique_ptr<SimpleOrderBook> msft(new SimpleOrderBook);
+  DestroyingDepthListener destroyer(msft);
+  SimpleOrderBook ibm;
+  ibm.set_depth_listener(&destroyer);
+  msft->set_depth_listener(&listener);
+  ibm.set_depth_conflator(&conflator);
+  msft->set_depth_conflator(&conflator);
+
+  SimpleOrder ibm_bid(true, 1250, 100);
+  SimpleOrder msft_bid(true, 3000, 100);
+  BOOST_CHECK(add_and_verify(ibm, &ibm_bid, false));
+  BOOST_CHECK(add_and_verify(*msft, &msft_bid, false));
+  BOOST_CHECK_EQUAL(2u, conflator.dirty_books());
+
+  // Publishing ibm destroys msft, which the flush then skips
+  BOOST_CHECK_EQUAL(1u, conflator.flush());
+  BOOST_CHECK(!msft);
+  BOOST_CHECK_EQUAL(0u, listener.changes_.size());
+  BOOST_CHECK_EQUAL(0u, conflator.dirty_books());
+  BOOST_CHECK_EQUAL(0u, conflator.flush());
+  BOOST_CHECK_EQUAL(1u, conflator.flushes());
+}
+
+BOOST_AUTO_TEST_CASE(TestDepthArrivalTime)
+{
+  DepthConflator conflator;
+  ConflatedDepthListener listener;
+  SimpleOrderBook book;
+  book.set_depth_listener(&listener);
+
+  // Not stamped by default
+  SimpleOrder bid0(true, 1250, 100);
+  BOOST_CHECK(add_and_verify(book, &bid0, false));
+  BOOST_CHECK_EQUAL(0u, book.arrival_time());
+  BOOST_REQUIRE_EQUAL(1u, listener.changes_.size());
+  BOOST_CHECK_EQUAL(0u, listener.changes_[0].arrival);
+
+  // Each publication carries its request's arrival
+  book.set_arrival_stamps(true);
+  book::Timestamp before = book::timestamp_now();
+  SimpleOrder bid1(true, 1249, 100);
+  BOOST_CHECK(add_and_verify(book, &bid1, false));
+  BOOST_CHECK(book.arrival_time() >= before);
+  BOOST_REQUIRE_EQUAL(2u, listener.changes_.size());
+  BOOST_CHECK_EQUAL(book.arrival_time(), listener.changes_[1].arrival);
+
+  // A conflated publication carries the first held request's arrival
+  book.set_depth_conflator(&conflator);
+  SimpleOrder bid2(true, 1248, 100);
+  BOOST_CHECK(add_and_verify(book, &bid2, false));
+  book::Timestamp first = book.arrival_time();
+  std::this_thread::sleep_for(std::chrono::milliseconds(1));
+  BOOST_CHECK(cancel_and_verify(book, &bid1, simple::os_cancelled));
+  BOOST_CHECK(book.arrival_time() > first);
+  BOOST_CHECK_EQUAL(1u, conflator.flush());
+  BOOST_REQUIRE_EQUAL(3u, listener.changes_.size());
+  BOOST_CHECK_EQUAL(first, listener.changes_[2].arrival);
+}
+
+} // namespace
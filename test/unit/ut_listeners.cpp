@@ -25,19 +25,19 @@ class TradeCbListener : public TradeListener<TypedOrderBook>
 public:
   virtual void on_trade(const TypedOrderBook* order_book,
                         Quantity qty,
-                        Cost cost)
+                        Price price)
   {
     quantities_.push_back(qty);
-    costs_.push_back(cost);
+    prices_.push_back(price);
   }
 
   void reset()
   {
     quantities_.clear();
-    costs_.clear();
+    prices_.clear();
   }
   std::vector<Quantity> quantities_;
-  std::vector<Cost> costs_;
+  std::vector<Price> prices_;
 };
 
 class OrderCbListener : public OrderListener<OrderPtr>
@@ -67,7 +67,7 @@ public:
     cancel_rejects_.push_back(order);
   }
   virtual void on_replace(const OrderPtr& order,
-                          const int32_t& , // size_delta
+                          const int64_t& , // size_delta
                           Price )          // new_price)
   {
     replaces_.push_back(order);
@@ -391,9 +391,10 @@ BOOST_AUTO_TEST_CASE(TestTradeCallbacks)
   // Add matching order, should result in a trade
   order_book.add(&order1);
   BOOST_CHECK_EQUAL(1, listener.quantities_.size());
-  BOOST_CHECK_EQUAL(1, listener.costs_.size());
+  BOOST_CHECK_EQUAL(1, listener.prices_.size());
   BOOST_CHECK_EQUAL(100, listener.quantities_[0]);
-  BOOST_CHECK_EQUAL(100 * 3250, listener.costs_[0]);
+  // The trade listener hears the price, not the cost
+  BOOST_CHECK_EQUAL(3250, listener.prices_[0]);
   listener.reset();
   // Add invalid order, should be rejected
   order_book.add(&order2);
@@ -415,7 +416,7 @@ BOOST_AUTO_TEST_CASE(TestTradeCallbacks)
   // Add matching order, should be accepted, followed by a fill
   order_book.add(&order4);
   BOOST_CHECK_EQUAL(1, listener.quantities_.size());
-  BOOST_CHECK_EQUAL(1, listener.costs_.size());
+  BOOST_CHECK_EQUAL(1, listener.prices_.size());
   listener.reset();
   // Replace matched order, with too large of a size decrease, replace
   // should be rejected
@@ -423,4 +424,117 @@ BOOST_AUTO_TEST_CASE(TestTradeCallbacks)
   BOOST_CHECK_EQUAL(0, listener.quantities_.size());
 }
 
+// A depth book that handles nothing beyond depth tracking
+class NarrowDepthOrderBook : public TypedDepthOrderBook
+{
+public:
+  NarrowDepthOrderBook()
+  : rejects_(0)
+  {
+    set_callback_interest(depth_callback_interest());
+  }
+
+  virtual void on_reject(const OrderPtr& order, const char* reason)
+  {
+    ++rejects_;
+  }
+
+  uint32_t rejects_;
+};
+
+BOOST_AUTO_TEST_CASE(TestCallbackInterest)
+{
+  typedef TypedOrderBook::TypedCallback Cb;
+  SimpleOrder order0(false, 3250, 100);
+  SimpleOrder order1(true,  3250, 0);
+
+  // A plain order book cannot tell which callbacks it handles
+  TypedOrderBook order_book;
+  BOOST_CHECK_EQUAL(uint32_t(Cb::ci_all), order_book.callback_interest());
+
+  // Nor can a depth book, since a derived class may override any hook
+  TypedDepthOrderBook default_depth_book;
+  BOOST_CHECK_EQUAL(uint32_t(Cb::ci_all), default_depth_book.callback_interest());
+
+  // A depth book that opts in builds only what it needs to track depth
+  DepthCbListener depth_listener;
+  NarrowDepthOrderBook depth_book;
+  depth_book.set_depth_listener(&depth_listener);
+  uint32_t depth_interest = depth_book.callback_interest();
+  BOOST_CHECK(depth_interest & Cb::ci_order_fill);
+  BOOST_CHECK(depth_interest & Cb::ci_book_update);
+  BOOST_CHECK(!(depth_interest & Cb::ci_order_reject));
+  BOOST_CHECK(!(depth_interest & Cb::ci_order_cancel_reject));
+  BOOST_CHECK(!(depth_interest & Cb::ci_order_accept_stop));
+
+  // Order level callbacks it did not ask for are never built...
+  SimpleOrder rejected(true, 3250, 0);
+  depth_book.add(&rejected);
+  BOOST_CHECK_EQUAL(0, depth_book.rejects_);
+  BOOST_CHECK_EQUAL(0, depth_listener.changes_.size());
+
+  // Listeners add their callbacks, and take them away again
+  OrderCbListener order_listener;
+  depth_book.set_order_listener(&order_listener);
+  BOOST_CHECK_EQUAL(uint32_t(Cb::ci_all), depth_book.callback_interest());
+  depth_book.add(&order1);
+  BOOST_CHECK_EQUAL(1, order_listener.rejects_.size());
+  BOOST_CHECK_EQUAL(1, depth_book.rejects_);
+  depth_book.set_order_listener(nullptr);
+  BOOST_CHECK_EQUAL(depth_interest, depth_book.callback_interest());
+
+  // ...while depth is still tracked
+  depth_book.add(&order0);
+  BOOST_CHECK_EQUAL(1, depth_listener.changes_.size());
+  BOOST_CHECK_EQUAL(100, depth_book.depth().asks()->aggregate_qty());
+  SimpleOrder rejected_again(true, 3250, 0);
+  depth_book.add(&rejected_again);
+  BOOST_CHECK_EQUAL(1, depth_book.rejects_);
+}
+
+BOOST_AUTO_TEST_CASE(TestEventBufferOrder)
+{
+  typedef book::EventBuffer<OrderPtr> Events;
+  typedef Events::TypedCallback Cb;
+  SimpleOrder order0(false, 3250, 100);
+  SimpleOrder order1(true,  3250, 300);
+
+  Events events;
+  size_t slot = events.accept(&order1);
+  events.fill(&order1, &order0, 100, 3250, Cb::ff_matched_filled);
+  events.set_quantity(slot, 100);
+  events.replace(&order1, 200, -50, 3249);
+  events.cancel_reject(&order0, "not found");
+  events.book_update();
+  BOOST_CHECK_EQUAL(5, events.size());
+
+  std::vector<Cb> delivered;
+  events.drain([&delivered](Cb & cb) { delivered.push_back(cb); });
+  BOOST_CHECK(events.empty());
+  BOOST_REQUIRE_EQUAL(5, delivered.size());
+
+  BOOST_CHECK_EQUAL(Cb::cb_order_accept, delivered[0].type);
+  BOOST_CHECK_EQUAL(&order1, delivered[0].order);
+  BOOST_CHECK_EQUAL(100, delivered[0].quantity);
+
+  BOOST_CHECK_EQUAL(Cb::cb_order_fill, delivered[1].type);
+  BOOST_CHECK_EQUAL(&order1, delivered[1].order);
+  BOOST_CHECK_EQUAL(&order0, delivered[1].matched_order);
+  BOOST_CHECK_EQUAL(100, delivered[1].quantity);
+  BOOST_CHECK_EQUAL(3250, delivered[1].price);
+  BOOST_CHECK_EQUAL(Cb::ff_matched_filled, delivered[1].flags);
+
+  BOOST_CHECK_EQUAL(Cb::cb_order_replace, delivered[2].type);
+  BOOST_CHECK_EQUAL(200, delivered[2].quantity);
+  BOOST_CHECK_EQUAL(-50, delivered[2].delta);
+  BOOST_CHECK_EQUAL(3249, delivered[2].price);
+
+  BOOST_CHECK_EQUAL(Cb::cb_order_cancel_reject, delivered[3].type);
+  BOOST_CHECK_EQUAL(&order0, delivered[3].order);
+  BOOST_CHECK_EQUAL(std::string("not found"), delivered[3].reject_reason);
+
+  BOOST_CHECK_EQUAL(Cb::cb_book_update, delivered[4].type);
+  BOOST_CHECK(delivered[4].order == nullptr);
+}
+
 } // namespace liquibook
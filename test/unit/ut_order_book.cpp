@@ -92,6 +92,46 @@ BOOST_AUTO_TEST_CASE(TestAsksMultimapSortCorrect)
   BOOST_CHECK((asks.lower_bound(book::ComparablePrice(false, 3235)))->second.ptr()->price() == 3235);
 }
 
+BOOST_AUTO_TEST_CASE(TestComparablePriceMatches)
+{
+  BOOST_CHECK_EQUAL(sizeof(Price), sizeof(book::ComparablePrice));
+
+  book::ComparablePrice bid(true, 1250);
+  BOOST_CHECK(bid.isBuy());
+  BOOST_CHECK_EQUAL(1250u, bid.price());
+  BOOST_CHECK(bid.matches(1250));
+  BOOST_CHECK(bid.matches(1249));
+  BOOST_CHECK(!bid.matches(1251));
+  BOOST_CHECK(bid.matches(MARKET_ORDER_PRICE));
+  BOOST_CHECK(bid < 1249);
+  BOOST_CHECK(bid > 1251);
+  BOOST_CHECK(bid > MARKET_ORDER_PRICE);
+
+  book::ComparablePrice ask(false, 1250);
+  BOOST_CHECK(!ask.isBuy());
+  BOOST_CHECK_EQUAL(1250u, ask.price());
+  BOOST_CHECK(ask.matches(1250));
+  BOOST_CHECK(ask.matches(1251));
+  BOOST_CHECK(!ask.matches(1249));
+  BOOST_CHECK(ask.matches(MARKET_ORDER_PRICE));
+  BOOST_CHECK(ask < 1251);
+  BOOST_CHECK(ask > 1249);
+  BOOST_CHECK(ask > MARKET_ORDER_PRICE);
+
+  book::ComparablePrice market_bid(true, MARKET_ORDER_PRICE);
+  BOOST_CHECK(market_bid.isMarket());
+  BOOST_CHECK(market_bid.isBuy());
+  BOOST_CHECK_EQUAL(MARKET_ORDER_PRICE, market_bid.price());
+  BOOST_CHECK(market_bid.matches(1));
+  BOOST_CHECK(market_bid < 1);
+  BOOST_CHECK(market_bid <= MARKET_ORDER_PRICE);
+
+  book::ComparablePrice market_ask(false, MARKET_ORDER_PRICE);
+  BOOST_CHECK(market_ask.isMarket());
+  BOOST_CHECK(market_ask.matches(1));
+  BOOST_CHECK(market_ask < 1);
+}
+
 BOOST_AUTO_TEST_CASE(TestAddCompleteBid)
 {
   SimpleOrderBook order_book;
@@ -789,7 +829,8 @@ BOOST_AUTO_TEST_CASE(TestMatchMarketOrderBid)
   BOOST_CHECK(add_and_verify(order_book, &bid1, false));
 
   // Verify sizes
-  BOOST_CHECK_EQUAL(2, order_book.bids().size());
+  BOOST_CHECK_EQUAL(1, order_book.bids().size());
+  BOOST_CHECK_EQUAL(1, order_book.marketBids().size());
   BOOST_CHECK_EQUAL(0, order_book.asks().size());
 
   // Verify depth
@@ -828,7 +869,8 @@ BOOST_AUTO_TEST_CASE(TestMatchMarketOrderAsk)
 
   // Verify sizes
   BOOST_CHECK_EQUAL(0, order_book.bids().size());
-  BOOST_CHECK_EQUAL(2, order_book.asks().size());
+  BOOST_CHECK_EQUAL(1, order_book.asks().size());
+  BOOST_CHECK_EQUAL(1, order_book.marketAsks().size());
 
   // Verify depth
   DepthCheck<SimpleOrderBook> dc(order_book.depth());
@@ -868,7 +910,8 @@ BOOST_AUTO_TEST_CASE(TestMatchMultipleMarketOrderBid)
   BOOST_CHECK(add_and_verify(order_book, &bid2, false));
 
   // Verify sizes
-  BOOST_CHECK_EQUAL(3, order_book.bids().size());
+  BOOST_CHECK_EQUAL(1, order_book.bids().size());
+  BOOST_CHECK_EQUAL(2, order_book.marketBids().size());
   BOOST_CHECK_EQUAL(0, order_book.asks().size());
 
   // Verify depth
@@ -913,7 +956,8 @@ BOOST_AUTO_TEST_CASE(TestMatchMultipleMarketOrderAsk)
 
   // Verify sizes
   BOOST_CHECK_EQUAL(0, order_book.bids().size());
-  BOOST_CHECK_EQUAL(3, order_book.asks().size());
+  BOOST_CHECK_EQUAL(1, order_book.asks().size());
+  BOOST_CHECK_EQUAL(2, order_book.marketAsks().size());
 
   // Verify depth
   DepthCheck<SimpleOrderBook> dc(order_book.depth());
@@ -931,7 +975,8 @@ BOOST_AUTO_TEST_CASE(TestMatchMultipleMarketOrderAsk)
 
   // Verify sizes
   BOOST_CHECK_EQUAL(0, order_book.bids().size());
-  BOOST_CHECK_EQUAL(2, order_book.asks().size());
+  BOOST_CHECK_EQUAL(1, order_book.asks().size());
+  BOOST_CHECK_EQUAL(1, order_book.marketAsks().size());
 
   // Verify depth
   dc.reset();
@@ -1827,6 +1872,41 @@ BOOST_AUTO_TEST_CASE(TestReplaceSizeDecrease)
   cc.reset();
 }
 
+BOOST_AUTO_TEST_CASE(TestReplaceSizeDecreaseKeepsPriority)
+{
+  SimpleOrderBook order_book;
+  SimpleOrder bid0(true,  1250, 100);
+  SimpleOrder bid1(true,  1250, 100);
+  SimpleOrder bid2(true,  1249, 100);
+  SimpleOrder ask0(false, 1249, 50);
+
+  // No match
+  BOOST_CHECK(add_and_verify(order_book, &bid0, false));
+  BOOST_CHECK(add_and_verify(order_book, &bid1, false));
+  BOOST_CHECK(add_and_verify(order_book, &bid2, false));
+
+  // Reduce the first order and the one at the lower price
+  BOOST_CHECK(replace_and_verify(order_book, &bid0, -40));
+  BOOST_CHECK(replace_and_verify(order_book, &bid2, -40));
+
+  // Still first at its price
+  auto pos = order_book.bids().begin();
+  BOOST_CHECK_EQUAL(&bid0, pos->second.ptr());
+  BOOST_CHECK_EQUAL(&bid1, (++pos)->second.ptr());
+  BOOST_CHECK_EQUAL(&bid2, (++pos)->second.ptr());
+
+  // Match - fills the reduced order first
+  {
+    SimpleFillCheck fc0(&bid0, 50, 1250 * 50);
+    SimpleFillCheck fc1(&bid1, 0, 0);
+    BOOST_CHECK(add_and_verify(order_book, &ask0, true, true));
+  }
+
+  DepthCheck<SimpleOrderBook> dc(order_book.depth());
+  BOOST_CHECK(dc.verify_bid(1250, 2, 110));
+  BOOST_CHECK(dc.verify_bid(1249, 1, 60));
+}
+
 BOOST_AUTO_TEST_CASE(TestReplaceSizeDecreaseCancel)
 {
   SimpleOrderBook order_book;
@@ -2650,4 +2730,106 @@ BOOST_AUTO_TEST_CASE(TestReplaceAskMatch)
   BOOST_CHECK(cc.verify_ask_changed(true, true, true, false, false));
 }
 
+BOOST_AUTO_TEST_CASE(TestReplacePartiallyFilledPriceChange)
+{
+  SimpleOrderBook order_book;
+  SimpleOrder ask0(false, 1253, 300);
+  SimpleOrder bid1(true,  1253, 100);
+  SimpleOrder bid0(true,  1250, 120);
+
+  BOOST_CHECK(add_and_verify(order_book, &ask0, false));
+  BOOST_CHECK(add_and_verify(order_book, &bid0, false));
+  // Match - partial
+  {
+    SimpleFillCheck fc0(&ask0,  100, 100 * 1253);
+    SimpleFillCheck fc1(&bid1,  100, 100 * 1253);
+    BOOST_CHECK(add_and_verify(order_book, &bid1, true, true));
+  }
+
+  DepthCheck<SimpleOrderBook> dc(order_book.depth());
+  BOOST_CHECK(dc.verify_bid(1250, 1, 120));
+  BOOST_CHECK(dc.verify_ask(1253, 1, 200));
+
+  // Replace price decrease 1253 -> 1252, only the open quantity moves
+  BOOST_CHECK(replace_and_verify(order_book, &ask0, SIZE_UNCHANGED, 1252));
+  dc.reset();
+  BOOST_CHECK(dc.verify_bid(1250, 1, 120));
+  BOOST_CHECK(dc.verify_ask(1252, 1, 200));
+  BOOST_CHECK(dc.verify_ask(   0, 0,   0));
+
+  // Match - complete
+  {
+    SimpleFillCheck fc0(&ask0,  120, 120 * 1250);
+    SimpleFillCheck fc1(&bid0,  120, 120 * 1250);
+    // Replace price decrease match 1252 -> 1250
+    BOOST_CHECK(replace_and_verify(order_book, &ask0, SIZE_UNCHANGED, 1250,
+                  simple::os_accepted, 120));
+  }
+
+  // Verify order
+  BOOST_CHECK_EQUAL(1250, ask0.price());
+  BOOST_CHECK_EQUAL(300, ask0.order_qty());
+  BOOST_CHECK_EQUAL(80, ask0.open_qty());
+
+  // Verify depth
+  dc.reset();
+  BOOST_CHECK(dc.verify_bid(   0, 0,   0));
+  BOOST_CHECK(dc.verify_ask(1250, 1,  80));
+  BOOST_CHECK(dc.verify_ask(   0, 0,   0));
+}
+
+BOOST_AUTO_TEST_CASE(TestTrackerLayout)
+{
+  // The matching walk reads the tracker, not the order
+  BOOST_CHECK(sizeof(SimpleTracker) <= 32u);
+
+  SimpleOrder bid(true, 1250, 300);
+  SimpleTracker tracker(&bid, oc_all_or_none);
+  BOOST_CHECK_EQUAL(1250u, tracker.price());
+  BOOST_CHECK(tracker.is_buy());
+  BOOST_CHECK(tracker.all_or_none());
+  BOOST_CHECK(!tracker.immediate_or_cancel());
+  BOOST_CHECK_EQUAL(300u, tracker.open_qty());
+
+  BOOST_CHECK_EQUAL(200u, tracker.reserve(100));
+  BOOST_CHECK_EQUAL(200u, tracker.open_qty());
+  BOOST_CHECK_THROW(tracker.reserve(-200), std::runtime_error);
+  BOOST_CHECK_EQUAL(300u, tracker.reserve(-100));
+
+  SimpleOrder ask(false, 1251, 100);
+  SimpleTracker ask_tracker(&ask);
+  BOOST_CHECK(!ask_tracker.is_buy());
+}
+
+BOOST_AUTO_TEST_CASE(TestMemoryUsage)
+{
+  SimpleOrderBook order_book;
+  const MemoryUsage empty = order_book.memory_usage();
+  BOOST_CHECK(empty.object_bytes >= sizeof(SimpleDepth));
+  BOOST_CHECK_EQUAL(0u, empty.tracker_bytes);
+  BOOST_CHECK(empty.callback_bytes > 0u);
+
+  // Seven bid levels, so two are kept in the excess depth map
+  std::vector<SimpleOrder> bids;
+  for (Price price = 1240; price < 1247; ++price) {
+    bids.push_back(SimpleOrder(true, price, 100));
+  }
+  for (size_t pos = 0; pos < bids.size(); ++pos) {
+    BOOST_CHECK(add_and_verify(order_book, &bids[pos], false));
+  }
+  const MemoryUsage loaded = order_book.memory_usage();
+  BOOST_CHECK_EQUAL(7 * sizeof(SimpleOrderBook::Tracker), loaded.tracker_bytes);
+  BOOST_CHECK(loaded.container_bytes >
+    order_book.depth().memory_usage().container_bytes);
+  BOOST_CHECK(order_book.depth().memory_usage().container_bytes > 0u);
+  BOOST_CHECK_EQUAL(loaded.object_bytes + loaded.heap_bytes(), loaded.total());
+
+  for (size_t pos = 0; pos < bids.size(); ++pos) {
+    BOOST_CHECK(cancel_and_verify(order_book, &bids[pos], simple::os_cancelled));
+  }
+  const MemoryUsage cancelled = order_book.memory_usage();
+  BOOST_CHECK_EQUAL(empty.tracker_bytes, cancelled.tracker_bytes);
+  BOOST_CHECK_EQUAL(empty.container_bytes, cancelled.container_bytes);
+}
+
 } // namespace
@@ -0,0 +1,130 @@
+// Copyright (c) 2017 Object Computing, Inc.
+// All rights reserved.
+// See the file license.txt for licensing information.
+
+#define BOOST_TEST_NO_MAIN LiquibookTest
+#include <boost/test/unit_test.hpp>
+
+#include "ut_utils.h"
+#include <book/order_book.h>
+#include <book/intrusive_ptr.h>
+#include <simple/simple_order.h>
+
+namespace liquibook {
+
+using book::OrderBook;
+using book::IntrusivePtr;
+using book::RefCounted;
+using simple::SimpleOrder;
+
+class CountedOrder final : public SimpleOrder, public RefCounted<CountedOrder>
+{
+public:
+  CountedOrder(bool is_buy, Price price, Quantity qty)
+  : SimpleOrder(is_buy, price, qty)
+  {
+  }
+};
+
+typedef IntrusivePtr<CountedOrder> CountedOrderPtr;
+
+class IntrusivePtrOrderBook : public OrderBook<CountedOrderPtr>
+{
+  virtual void perform_callback(OrderBook<CountedOrderPtr>::TypedCallback& cb)
+  {
+    switch(cb.type) {
+      case TypedCallback::cb_order_accept:
+        cb.order->accept();
+        break;
+      case TypedCallback::cb_order_fill: {
+        Cost fill_cost = cb.price * cb.quantity;
+        cb.order->fill(cb.quantity, fill_cost, 0);
+        cb.matched_order->fill(cb.quantity, fill_cost, 0);
+        break;
+      }
+      case TypedCallback::cb_order_cancel:
+        cb.order->cancel();
+        break;
+      case TypedCallback::cb_order_replace:
+        cb.order->replace(cb.delta, cb.price);
+        break;
+      default:
+        // Nothing
+        break;
+    }
+  }
+};
+
+typedef FillCheck<CountedOrderPtr> CountedFillCheck;
+
+BOOST_AUTO_TEST_CASE(TestIntrusivePointerBuild)
+{
+  IntrusivePtrOrderBook order_book;
+  CountedOrderPtr ask1(new CountedOrder(false, 1252, 100));
+  CountedOrderPtr ask0(new CountedOrder(false, 1251, 100));
+  CountedOrderPtr bid1(new CountedOrder(true,  1251, 100));
+  CountedOrderPtr bid0(new CountedOrder(true,  1250, 100));
+
+  // No match
+  BOOST_CHECK(add_and_verify(order_book, bid0, false));
+  BOOST_CHECK(add_and_verify(order_book, ask0, false));
+  BOOST_CHECK(add_and_verify(order_book, ask1, false));
+
+  // The book holds one share of each resting order
+  BOOST_CHECK_EQUAL(2u, bid0->use_count());
+  BOOST_CHECK_EQUAL(2u, ask0->use_count());
+
+  // Match - complete
+  {
+    CountedFillCheck fc1(bid1, 100, 125100);
+    CountedFillCheck fc2(ask0, 100, 125100);
+    BOOST_CHECK(add_and_verify(order_book, bid1, true, true));
+  }
+
+  // Verify sizes
+  BOOST_CHECK_EQUAL(1, order_book.bids().size());
+  BOOST_CHECK_EQUAL(1, order_book.asks().size());
+
+  // Filled orders are released by the book and its callbacks
+  BOOST_CHECK_EQUAL(1u, bid1->use_count());
+  BOOST_CHECK_EQUAL(1u, ask0->use_count());
+}
+
+BOOST_AUTO_TEST_CASE(TestIntrusiveCancelReplace)
+{
+  IntrusivePtrOrderBook order_book;
+  CountedOrderPtr ask0(new CountedOrder(false, 1251, 100));
+  CountedOrderPtr bid0(new CountedOrder(true,  1250, 100));
+
+  BOOST_CHECK(add_and_verify(order_book, bid0, false));
+  BOOST_CHECK(add_and_verify(order_book, ask0, false));
+
+  // Move the bid to a new price
+  BOOST_CHECK(replace_and_verify(order_book, bid0, 0, 1249));
+  BOOST_CHECK_EQUAL(1, order_book.bids().size());
+  BOOST_CHECK_EQUAL(2u, bid0->use_count());
+
+  // Cancel bid
+  BOOST_CHECK(cancel_and_verify(order_book, bid0, simple::os_cancelled));
+  BOOST_CHECK_EQUAL(0, order_book.bids().size());
+  BOOST_CHECK_EQUAL(1u, bid0->use_count());
+}
+
+BOOST_AUTO_TEST_CASE(TestIntrusivePtrOwnership)
+{
+  CountedOrderPtr order = book::make_intrusive<CountedOrder>(true, 1250, 100);
+  BOOST_CHECK_EQUAL(1u, order->use_count());
+  {
+    CountedOrderPtr copy(order);
+    BOOST_CHECK(copy == order);
+    BOOST_CHECK_EQUAL(2u, order->use_count());
+    CountedOrderPtr moved(std::move(copy));
+    BOOST_CHECK(copy == nullptr);
+    BOOST_CHECK_EQUAL(2u, order->use_count());
+  }
+  BOOST_CHECK_EQUAL(1u, order->use_count());
+  order.reset();
+  BOOST_CHECK(!order);
+}
+
+} // namespace
@@ -0,0 +1,153 @@
+// Copyright (c) 2017 Object Computing, Inc.
+// All rights reserved.
+// See the file license.txt for licensing information.
+
+#define BOOST_TEST_NO_MAIN LiquibookTest
+#include <boost/test/unit_test.hpp>
+
+#include "ut_utils.h"
+#include <book/order_book.h>
+#include <book/order_slab.h>
+#include <simple/simple_order.h>
+
+namespace liquibook {
+
+using book::OrderBook;
+using book::OrderSlab;
+using book::SlabPtr;
+using simple::SimpleOrder;
+
+typedef OrderSlab<SimpleOrder> SimpleOrderSlab;
+typedef SlabPtr<SimpleOrder> SlabOrderPtr;
+
+class SlabOrderBook : public OrderBook<SlabOrderPtr>
+{
+  virtual void perform_callback(OrderBook<SlabOrderPtr>::TypedCallback& cb)
+  {
+    switch(cb.type) {
+      case TypedCallback::cb_order_accept:
+        cb.order->accept();
+        break;
+      case TypedCallback::cb_order_fill: {
+        Cost fill_cost = cb.price * cb.quantity;
+        cb.order->fill(cb.quantity, fill_cost, 0);
+        cb.matched_order->fill(cb.quantity, fill_cost, 0);
+        break;
+      }
+      case TypedCallback::cb_order_cancel:
+        cb.order->cancel();
+        break;
+      case TypedCallback::cb_order_replace:
+        cb.order->replace(cb.delta, cb.price);
+        break;
+      default:
+        // Nothing
+        break;
+    }
+  }
+};
+
+typedef FillCheck<SlabOrderPtr> SlabFillCheck;
+
+BOOST_AUTO_TEST_CASE(TestSlabHandles)
+{
+  SimpleOrderSlab slab;
+  SimpleOrderSlab::Binding binding(slab);
+  BOOST_CHECK_EQUAL(&slab, SimpleOrderSlab::current());
+  size_t live = slab.size();
+
+  SlabOrderPtr null_order;
+  BOOST_CHECK(null_order == nullptr);
+  BOOST_CHECK(!null_order);
+  BOOST_CHECK_EQUAL(4u, sizeof(SlabOrderPtr));
+
+  SlabOrderPtr order0 = slab.create(true, 1250, 100);
+  SlabOrderPtr order1 = slab.create(false, 1251, 200);
+  BOOST_CHECK(order0 != order1);
+  BOOST_CHECK(order0.index() != 0);
+  BOOST_CHECK_EQUAL(live + 2, slab.size());
+  BOOST_CHECK_EQUAL(1250, order0->price());
+  BOOST_CHECK_EQUAL(200, order1->order_qty());
+  BOOST_CHECK_EQUAL(order0.get(), slab.get(order0.index()));
+
+  // A freed slot is reused, at the same address
+  SimpleOrder * address = order0.get();
+  uint32_t index = order0.index();
+  slab.destroy(order0);
+  SlabOrderPtr order2 = slab.create(false, 1249, 300);
+  BOOST_CHECK_EQUAL(index, order2.index());
+  BOOST_CHECK_EQUAL(address, order2.get());
+  BOOST_CHECK(!order2->is_buy());
+
+  // Growing the slab does not move existing records
+  SimpleOrder * address1 = order1.get();
+  slab.reserve(slab.capacity() + SimpleOrderSlab::CHUNK_SIZE);
+  BOOST_CHECK_EQUAL(address1, order1.get());
+
+  slab.destroy(order1);
+  slab.destroy(order2);
+  BOOST_CHECK_EQUAL(live, slab.size());
+  BOOST_CHECK_THROW(slab.destroy(SlabOrderPtr()), std::runtime_error);
+  // Nor can a record be destroyed twice
+  BOOST_CHECK_THROW(slab.destroy(order1), std::runtime_error);
+  BOOST_CHECK_THROW(slab.destroy(SlabOrderPtr(index + 10)), std::runtime_error);
+}
+
+BOOST_AUTO_TEST_CASE(TestSlabBinding)
+{
+  BOOST_CHECK(SimpleOrderSlab::current() == nullptr);
+  SimpleOrderSlab outer_slab;
+  SimpleOrderSlab::Binding outer_binding(outer_slab);
+  SlabOrderPtr outer_order = outer_slab.create(true, 1250, 100);
+  {
+    // Handles resolve against the innermost binding...
+    SimpleOrderSlab inner_slab;
+    SimpleOrderSlab::Binding inner_binding(inner_slab);
+    SlabOrderPtr inner_order = inner_slab.create(false, 1251, 200);
+    BOOST_CHECK_EQUAL(outer_order.index(), inner_order.index());
+    BOOST_CHECK_EQUAL(&inner_slab, SimpleOrderSlab::current());
+    BOOST_CHECK_EQUAL(1251, inner_order->price());
+    inner_slab.destroy(inner_order);
+  }
+  // ...and the outer slab comes back when it goes away
+  BOOST_CHECK_EQUAL(&outer_slab, SimpleOrderSlab::current());
+  BOOST_CHECK_EQUAL(1250, outer_order->price());
+  outer_slab.destroy(outer_order);
+}
+
+BOOST_AUTO_TEST_CASE(TestSlabPointerBuild)
+{
+  SimpleOrderSlab slab;
+  SimpleOrderSlab::Binding binding(slab);
+  SlabOrderBook order_book;
+  SlabOrderPtr ask1 = slab.create(false, 1252, 100);
+  SlabOrderPtr ask0 = slab.create(false, 1251, 100);
+  SlabOrderPtr bid1 = slab.create(true,  1251, 100);
+  SlabOrderPtr bid0 = slab.create(true,  1250, 100);
+
+  // No match
+  BOOST_CHECK(add_and_verify(order_book, bid0, false));
+  BOOST_CHECK(add_and_verify(order_book, ask0, false));
+  BOOST_CHECK(add_and_verify(order_book, ask1, false));
+
+  // Match - complete
+  {
+    SlabFillCheck fc1(bid1, 100, 125100);
+    SlabFillCheck fc2(ask0, 100, 125100);
+    BOOST_CHECK(add_and_verify(order_book, bid1, true, true));
+  }
+
+  // Cancel bid
+  BOOST_CHECK(cancel_and_verify(order_book, bid0, simple::os_cancelled));
+
+  // Verify sizes
+  BOOST_CHECK_EQUAL(0, order_book.bids().size());
+  BOOST_CHECK_EQUAL(1, order_book.asks().size());
+
+  slab.destroy(bid0);
+  slab.destroy(bid1);
+  slab.destroy(ask0);
+  slab.destroy(ask1);
+}
+
+} // namespace
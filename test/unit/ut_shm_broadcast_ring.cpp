@@ -0,0 +1,105 @@
+// Copyright (c) 2017 Object Computing, Inc.
+// All rights reserved.
+// See the file license.txt for licensing information.
+
+#ifndef _WIN32
+
+#define BOOST_TEST_NO_MAIN LiquibookTest
+#include <boost/test/unit_test.hpp>
+
+#include <book/shm_broadcast_ring.h>
+#include <cstring>
+#include <memory>
+#include <vector>
+
+namespace liquibook {
+
+typedef book::ShmBroadcastRing Ring;
+
+namespace {
+std::string ring_name()
+{
+  return "/liquibook_ut_ring_" + std::to_string(getpid());
+}
+
+// A record of size bytes whose contents depend on its number
+std::vector<unsigned char> record(size_t number, size_t size)
+{
+  std::vector<unsigned char> bytes(size);
+  for (size_t index = 0; index < size; ++index) {
+    bytes[index] = (unsigned char)(number + index);
+  }
+  return bytes;
+}
+}
+
+BOOST_AUTO_TEST_CASE(TestShmBroadcastRing)
+{
+  std::string name = ring_name();
+  BOOST_CHECK_THROW(Ring::create(name, 5000), std::runtime_error);
+  std::unique_ptr<Ring> writer(Ring::create(name, Ring::MIN_CAPACITY));
+  BOOST_CHECK_EQUAL(1024u, writer->max_record());
+  BOOST_CHECK_THROW(writer->write("x", 0), std::runtime_error);
+
+  // Two readers in a read only mapping, and one in the writer's
+  std::unique_ptr<Ring> mapping(Ring::open(name));
+  BOOST_CHECK_THROW(mapping->write("x", 1), std::runtime_error);
+  Ring::Reader fast(*mapping);
+  Ring::Reader slow(*mapping);
+  Ring::Reader local(*writer);
+  std::vector<unsigned char> buffer(writer->max_record());
+  BOOST_CHECK_EQUAL(0u, fast.receive(&buffer[0]));
+
+  // Records of odd sizes, several times round the ring, each read by
+  // every reader that keeps up
+  size_t number = 0;
+  for (; number < 200; ++number) {
+    std::vector<unsigned char> sent = record(number, 1 + number * 7 % 200);
+    writer->write(&sent[0], sent.size());
+    BOOST_REQUIRE_EQUAL(sent.size(), fast.receive(&buffer[0]));
+    BOOST_CHECK(memcmp(&sent[0], &buffer[0], sent.size()) == 0);
+    BOOST_REQUIRE_EQUAL(sent.size(), local.receive(&buffer[0]));
+    BOOST_CHECK(memcmp(&sent[0], &buffer[0], sent.size()) == 0);
+    BOOST_CHECK_EQUAL(0u, fast.receive(&buffer[0]));
+  }
+  BOOST_CHECK(writer->tail() > 4 * writer->capacity());
+  BOOST_CHECK_EQUAL(0u, fast.overruns());
+
+  // The reader that fell a ring behind skips to the new records
+  BOOST_CHECK_EQUAL(0u, slow.receive(&buffer[0]));
+  BOOST_CHECK_EQUAL(1u, slow.overruns());
+  std::vector<unsigned char> sent = record(number, 100);
+  writer->write(&sent[0], sent.size());
+  BOOST_REQUIRE_EQUAL(100u, slow.receive(&buffer[0]));
+  BOOST_CHECK(memcmp(&sent[0], &buffer[0], sent.size()) == 0);
+
+  // A reader a little behind misses nothing
+  std::vector<unsigned char> first = record(1, 300);
+  std::vector<unsigned char> second = record(2, 500);
+  writer->write(&first[0], first.size());
+  writer->write(&second[0], second.size());
+  BOOST_CHECK_EQUAL(100u, fast.receive(&buffer[0]));
+  BOOST_CHECK_EQUAL(300u, fast.receive(&buffer[0]));
+  BOOST_CHECK_EQUAL(500u, fast.receive(&buffer[0]));
+  BOOST_CHECK(memcmp(&second[0], &buffer[0], second.size()) == 0);
+  BOOST_CHECK_EQUAL(0u, fast.overruns());
+
+  // Replacing the ring leaves existing mappings intact; new readers get
+  // the new ring
+  std::unique_ptr<Ring> replacement(
+    Ring::create(name, 2 * Ring::MIN_CAPACITY));
+  BOOST_CHECK_EQUAL(size_t(Ring::MIN_CAPACITY), mapping->capacity());
+  writer->write(&first[0], first.size());
+  BOOST_CHECK_EQUAL(300u, fast.receive(&buffer[0]));
+  BOOST_CHECK(memcmp(&first[0], &buffer[0], first.size()) == 0);
+  std::unique_ptr<Ring> new_mapping(Ring::open(name));
+  BOOST_CHECK_EQUAL(2 * size_t(Ring::MIN_CAPACITY), new_mapping->capacity());
+  BOOST_CHECK_EQUAL(0u, new_mapping->tail());
+
+  Ring::remove(name);
+  BOOST_CHECK_THROW(Ring::open(name), std::runtime_error);
+}
+
+} // namespace
+
+#endif // _WIN32
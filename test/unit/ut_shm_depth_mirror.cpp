@@ -0,0 +1,95 @@
+// Copyright (c) 2017 Object Computing, Inc.
+// All rights reserved.
+// See the file license.txt for licensing information.
+
+#ifndef _WIN32
+
+#define BOOST_TEST_NO_MAIN LiquibookTest
+#include <boost/test/unit_test.hpp>
+
+#include <book/shm_depth_mirror.h>
+#include <simple/simple_order_book.h>
+#include "ut_utils.h"
+#include <memory>
+#include <sys/wait.h>
+
+namespace liquibook {
+
+using simple::SimpleOrder;
+
+typedef simple::SimpleOrderBook<5> SimpleOrderBook;
+typedef book::ShmDepthMirror<5> DepthMirror;
+
+namespace {
+std::string mirror_name()
+{
+  return "/liquibook_ut_" + std::to_string(getpid());
+}
+}
+
+BOOST_AUTO_TEST_CASE(TestShmDepthMirror)
+{
+  std::string name = mirror_name();
+  std::unique_ptr<DepthMirror> writer(DepthMirror::create(name, 4));
+  BOOST_CHECK_EQUAL(4u, writer->max_books());
+
+  SimpleOrderBook ibm;
+  SimpleOrderBook msft;
+  ibm.set_depth_slot(writer->add_book("IBM"));
+  msft.set_depth_slot(writer->add_book("MSFT"));
+  BOOST_CHECK_THROW(writer->add_book(std::string(40, 'X')), std::runtime_error);
+
+  SimpleOrder bid0(true, 1250, 100);
+  SimpleOrder bid1(true, 1240, 300);
+  SimpleOrder ask0(false, 3100, 200);
+  BOOST_CHECK(add_and_verify(ibm, &bid0, false));
+  BOOST_CHECK(add_and_verify(ibm, &bid1, false));
+  BOOST_CHECK(add_and_verify(msft, &ask0, false));
+
+  // A second, read only mapping sees the same levels
+  std::unique_ptr<DepthMirror> reader(DepthMirror::open(name));
+  BOOST_CHECK_EQUAL(2u, reader->book_count());
+  BOOST_CHECK_EQUAL("MSFT", reader->symbol(1));
+  BOOST_CHECK_EQUAL(2u, reader->find("GOOG"));
+  BOOST_CHECK_THROW(reader->add_book("GOOG"), std::runtime_error);
+
+  DepthMirror::Snapshot levels;
+  reader->slot(reader->find("IBM")).read(levels);
+  BOOST_CHECK_EQUAL(1250u, levels.bids[0].price);
+  BOOST_CHECK_EQUAL(1240u, levels.bids[1].price);
+  BOOST_CHECK_EQUAL(300u, levels.bids[1].qty);
+  BOOST_CHECK_EQUAL(0u, levels.asks[0].price);
+  reader->slot(reader->find("MSFT")).read(levels);
+  BOOST_CHECK_EQUAL(3100u, levels.asks[0].price);
+
+  // Changes show through the reader's mapping
+  BOOST_CHECK(cancel_and_verify(ibm, &bid0, simple::os_cancelled));
+  reader->slot(0).read(levels);
+  BOOST_CHECK_EQUAL(1240u, levels.bids[0].price);
+
+  // And in another process
+  pid_t child = fork();
+  if (child == 0) {
+    int status = 1;
+    try {
+      std::unique_ptr<DepthMirror> other(DepthMirror::open(name));
+      DepthMirror::Snapshot child_levels;
+      other->slot(other->find("IBM")).read(child_levels);
+      status = child_levels.bids[0].price == 1240 ? 0 : 2;
+    } catch (...) {
+    }
+    _exit(status);
+  }
+  int status = -1;
+  BOOST_REQUIRE(child > 0);
+  waitpid(child, &status, 0);
+  BOOST_CHECK(WIFEXITED(status));
+  BOOST_CHECK_EQUAL(0, WEXITSTATUS(status));
+
+  DepthMirror::remove(name);
+  BOOST_CHECK_THROW(DepthMirror::open(name), std::runtime_error);
+}
+
+} // namespace
+
+#endif // _WIN32
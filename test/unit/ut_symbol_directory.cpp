@@ -0,0 +1,152 @@
+// Copyright (c) 2017 Object Computing, Inc.
+// All rights reserved.
+// See the file license.txt for licensing information.
+
+#define BOOST_TEST_NO_MAIN LiquibookTest
+#include <boost/test/unit_test.hpp>
+
+#include <book/symbol_directory.h>
+#include <book/symbol_set.h>
+#include <book/order_index.h>
+#include <map>
+#include <string>
+
+namespace liquibook {
+
+using book::SymbolDirectory;
+using book::SymbolId;
+using book::SymbolSet;
+using book::OrderIndex;
+using book::INVALID_SYMBOL_ID;
+
+BOOST_AUTO_TEST_CASE(TestSymbolDirectory)
+{
+  SymbolDirectory<std::string> directory;
+  BOOST_CHECK(directory.empty());
+  BOOST_CHECK_EQUAL(INVALID_SYMBOL_ID, directory.find("AAPL"));
+
+  // Ids are dense, in the order symbols are added
+  BOOST_CHECK_EQUAL(0u, directory.add("AAPL", "apple"));
+  BOOST_CHECK_EQUAL(1u, directory.add("MSFT", "microsoft"));
+  BOOST_CHECK_EQUAL(2u, directory.add("IBM", "ibm"));
+  BOOST_CHECK_EQUAL(3u, directory.size());
+
+  // A symbol gets only one book
+  BOOST_CHECK_EQUAL(INVALID_SYMBOL_ID, directory.add("MSFT", "again"));
+  BOOST_CHECK_EQUAL(3u, directory.size());
+
+  SymbolId msft = directory.find("MSFT");
+  BOOST_CHECK_EQUAL(1u, msft);
+  BOOST_CHECK(directory.contains(msft));
+  BOOST_CHECK(!directory.contains(3));
+  BOOST_CHECK_EQUAL("microsoft", directory.book(msft));
+  BOOST_CHECK_EQUAL("MSFT", directory.symbol(msft));
+
+  directory.book(msft) = "changed";
+  BOOST_CHECK_EQUAL("changed", directory.book(directory.find("MSFT")));
+}
+
+BOOST_AUTO_TEST_CASE(TestSymbolSet)
+{
+  SymbolSet symbols;
+  BOOST_CHECK(symbols.empty());
+  BOOST_CHECK(!symbols.contains(0));
+  BOOST_CHECK(!symbols.contains(1000));
+
+  // Ids either side of a word boundary, and far beyond the first
+  BOOST_CHECK(symbols.insert(0));
+  BOOST_CHECK(symbols.insert(63));
+  BOOST_CHECK(symbols.insert(64));
+  BOOST_CHECK(symbols.insert(1000));
+  BOOST_CHECK(!symbols.insert(63));
+  BOOST_CHECK_EQUAL(4u, symbols.size());
+  BOOST_CHECK(symbols.contains(0));
+  BOOST_CHECK(symbols.contains(63));
+  BOOST_CHECK(symbols.contains(64));
+  BOOST_CHECK(symbols.contains(1000));
+  BOOST_CHECK(!symbols.contains(1));
+  BOOST_CHECK(!symbols.contains(65));
+  BOOST_CHECK(!symbols.contains(999));
+
+  BOOST_CHECK(symbols.erase(63));
+  BOOST_CHECK(!symbols.erase(63));
+  BOOST_CHECK(!symbols.erase(5000));
+  BOOST_CHECK(!symbols.contains(63));
+  BOOST_CHECK_EQUAL(3u, symbols.size());
+
+  // A union counts the symbols in both once
+  SymbolSet others;
+  others.insert(1);
+  others.insert(64);
+  others.insert(2000);
+  symbols.insert(others);
+  BOOST_CHECK_EQUAL(5u, symbols.size());
+  BOOST_CHECK(symbols.contains(1));
+  BOOST_CHECK(symbols.contains(2000));
+
+  symbols.clear();
+  BOOST_CHECK(symbols.empty());
+  BOOST_CHECK(!symbols.contains(64));
+  BOOST_CHECK_THROW(symbols.insert(INVALID_SYMBOL_ID), std::runtime_error);
+}
+
+BOOST_AUTO_TEST_CASE(TestOrderIndex)
+{
+  OrderIndex<int> index;
+  BOOST_CHECK(index.empty());
+  BOOST_CHECK(index.find(1) == nullptr);
+  BOOST_CHECK(!index.erase(1));
+  BOOST_CHECK_THROW(index.insert(0, 0), std::runtime_error);
+
+  BOOST_CHECK(index.insert(7, 70));
+  BOOST_CHECK(!index.insert(7, 71));
+  BOOST_CHECK_EQUAL(70, *index.find(7));
+  *index.find(7) = 72;
+  BOOST_CHECK_EQUAL(72, *index.find(7));
+  BOOST_CHECK(index.erase(7));
+  BOOST_CHECK(index.find(7) == nullptr);
+  BOOST_CHECK(index.empty());
+
+  // Reserving up front avoids growing
+  index.reserve(1000);
+  size_t capacity = index.capacity();
+  for (int id = 1; id <= 1000; ++id) {
+    index.insert(id, id * 10);
+  }
+  BOOST_CHECK_EQUAL(capacity, index.capacity());
+  BOOST_CHECK_EQUAL(1000u, index.size());
+}
+
+BOOST_AUTO_TEST_CASE(TestOrderIndexChurn)
+{
+  // Compare against std::map through inserts, growth and erases
+  OrderIndex<uint64_t> index;
+  std::map<uint64_t, uint64_t> expected;
+  uint64_t seed = 12345;
+  for (int step = 0; step < 20000; ++step) {
+    seed = seed * 6364136223846793005ull + 1442695040888963407ull;
+    uint64_t id = (seed >> 33) % 3000 + 1;
+    if ((seed >> 20) % 3 == 0) {
+      BOOST_CHECK_EQUAL(expected.erase(id) == 1, index.erase(id));
+    } else {
+      BOOST_CHECK_EQUAL(expected.insert(std::make_pair(id, step)).second,
+                        index.insert(id, step));
+    }
+  }
+  BOOST_CHECK_EQUAL(expected.size(), index.size());
+  for (uint64_t id = 1; id <= 3000; ++id) {
+    const uint64_t * value = index.find(id);
+    std::map<uint64_t, uint64_t>::const_iterator entry = expected.find(id);
+    if (entry == expected.end()) {
+      BOOST_CHECK(value == nullptr);
+    } else {
+      BOOST_REQUIRE(value != nullptr);
+      BOOST_CHECK_EQUAL(entry->second, *value);
+    }
+  }
+  index.clear();
+  BOOST_CHECK(index.empty());
+  BOOST_CHECK(index.find(1) == nullptr);
+}
+
+} // namespace
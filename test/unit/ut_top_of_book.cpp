@@ -0,0 +1,139 @@
+// Copyright (c) 2017 Object Computing, Inc.
+// All rights reserved.
+// See the file license.txt for licensing information.
+
+#define BOOST_TEST_NO_MAIN LiquibookTest
+#include <boost/test/unit_test.hpp>
+
+#include <book/top_of_book.h>
+#include <simple/simple_order_book.h>
+#include "ut_utils.h"
+#include <atomic>
+#include <thread>
+#include <vector>
+
+namespace liquibook {
+
+using book::SeqlockTopOfBook;
+using simple::SimpleOrder;
+
+typedef simple::SimpleOrderBook<5> SimpleOrderBook;
+
+BOOST_AUTO_TEST_CASE(TestTopOfBookSlots)
+{
+  SimpleOrderBook order_book;
+  SimpleOrderBook::BboSlot bbo_slot;
+  SimpleOrderBook::DepthSlot depth_slot;
+  order_book.set_bbo_slot(&bbo_slot);
+  order_book.set_depth_slot(&depth_slot);
+
+  SimpleOrder bid0(true, 1250, 100);
+  SimpleOrder bid1(true, 1240, 300);
+  SimpleOrder ask0(false, 1260, 200);
+  SimpleOrder ask1(false, 1261, 100);
+
+  SimpleOrderBook::BboSlot::Snapshot bbo;
+  bbo_slot.read(bbo);
+  BOOST_CHECK_EQUAL(0u, bbo.bids[0].price);
+  BOOST_CHECK_EQUAL(0u, bbo.asks[0].qty);
+
+  BOOST_CHECK(add_and_verify(order_book, &bid0, false));
+  BOOST_CHECK(add_and_verify(order_book, &ask0, false));
+  BOOST_REQUIRE(bbo_slot.try_read(bbo));
+  BOOST_CHECK_EQUAL(1250u, bbo.bids[0].price);
+  BOOST_CHECK_EQUAL(100u, bbo.bids[0].qty);
+  BOOST_CHECK_EQUAL(1u, bbo.bids[0].order_count);
+  BOOST_CHECK_EQUAL(1260u, bbo.asks[0].price);
+  BOOST_CHECK_EQUAL(200u, bbo.asks[0].qty);
+  BOOST_CHECK_EQUAL(order_book.depth().last_change(), bbo.change_id);
+
+  // A change below the top reaches the depth slot only
+  uint64_t bbo_sequence = bbo_slot.sequence();
+  BOOST_CHECK(add_and_verify(order_book, &bid1, false));
+  BOOST_CHECK(add_and_verify(order_book, &ask1, false));
+  BOOST_CHECK_EQUAL(bbo_sequence, bbo_slot.sequence());
+  SimpleOrderBook::DepthSlot::Snapshot levels;
+  depth_slot.read(levels);
+  BOOST_CHECK_EQUAL(1250u, levels.bids[0].price);
+  BOOST_CHECK_EQUAL(1240u, levels.bids[1].price);
+  BOOST_CHECK_EQUAL(300u, levels.bids[1].qty);
+  BOOST_CHECK_EQUAL(1261u, levels.asks[1].price);
+  BOOST_CHECK_EQUAL(0u, levels.asks[2].price);
+
+  // Trading at the top reaches both
+  SimpleOrder sell(false, 1250, 100);
+  BOOST_CHECK(add_and_verify(order_book, &sell, true, true));
+  BOOST_CHECK(bbo_sequence != bbo_slot.sequence());
+  bbo_slot.read(bbo);
+  BOOST_CHECK_EQUAL(1240u, bbo.bids[0].price);
+  depth_slot.read(levels);
+  BOOST_CHECK_EQUAL(1240u, levels.bids[0].price);
+  BOOST_CHECK_EQUAL(0u, levels.bids[1].price);
+
+  // Detached slots keep their last levels
+  order_book.set_bbo_slot(nullptr);
+  bbo_sequence = bbo_slot.sequence();
+  BOOST_CHECK(cancel_and_verify(order_book, &bid1, simple::os_cancelled));
+  BOOST_CHECK_EQUAL(bbo_sequence, bbo_slot.sequence());
+}
+
+BOOST_AUTO_TEST_CASE(TestSeqlockTopOfBookThreads)
+{
+  typedef SeqlockTopOfBook<3> Slot;
+  Slot slot;
+  std::atomic<bool> done(false);
+  std::atomic<int> torn(0);
+  std::atomic<long> reads(0);
+
+  // Every snapshot the writer publishes is derived from its change id,
+  // so a reader can tell a torn copy from a whole one
+  std::vector<std::thread> readers;
+  for (int count = 0; count < 2; ++count) {
+    readers.push_back(std::thread([&]() {
+      long whole = 0;
+      Slot::Snapshot snapshot;
+      while (!done.load()) {
+        // Skip the empty levels published on construction
+        if (!slot.try_read(snapshot) || snapshot.change_id == 0) {
+          continue;
+        }
+        ++whole;
+        book::Price id = snapshot.change_id;
+        for (int level = 0; level < 3; ++level) {
+          if (snapshot.bids[level].price != id - level ||
+              snapshot.bids[level].qty != id * 10 ||
+              snapshot.asks[level].price != id + level + 1 ||
+              snapshot.asks[level].order_count != uint32_t(id)) {
+            ++torn;
+          }
+        }
+      }
+      reads += whole;
+    }));
+  }
+
+  Slot::Snapshot snapshot;
+  for (uint32_t id = 100; id < 200000; ++id) {
+    snapshot.change_id = id;
+    for (int level = 0; level < 3; ++level) {
+      snapshot.bids[level].price = id - level;
+      snapshot.bids[level].qty = uint64_t(id) * 10;
+      snapshot.asks[level].price = id + level + 1;
+      snapshot.asks[level].order_count = id;
+    }
+    slot.publish(snapshot);
+    if (id % 1024 == 0) {
+      std::this_thread::yield();
+    }
+  }
+  done = true;
+  for (size_t pos = 0; pos < readers.size(); ++pos) {
+    readers[pos].join();
+  }
+  BOOST_CHECK_EQUAL(0, torn.load());
+  BOOST_CHECK(reads.load() > 0);
+  slot.read(snapshot);
+  BOOST_CHECK_EQUAL(199999u, snapshot.change_id);
+}
+
+} // namespace
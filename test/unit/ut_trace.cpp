@@ -0,0 +1,132 @@
+// Copyright (c) 2017 Object Computing, Inc.
+// All rights reserved.
+// See the file license.txt for licensing information.
+
+#define BOOST_TEST_NO_MAIN LiquibookTest
+#include <boost/test/unit_test.hpp>
+
+#include "ut_utils.h"
+#include <book/trace_dump.h>
+#include <simple/simple_order.h>
+#include <sstream>
+
+namespace liquibook {
+
+using book::TraceRing;
+using book::TraceEvent;
+using book::TraceDump;
+using simple::SimpleOrder;
+
+// The ring itself is available in every build
+BOOST_AUTO_TEST_CASE(TestTraceRingWraps)
+{
+  TraceRing<4> ring;
+  std::vector<TraceEvent> events;
+  ring.snapshot(events);
+  BOOST_CHECK(events.empty());
+
+  for (book::Price price = 1; price <= 6; ++price) {
+    ring.record(TraceRing<4>::te_fill, price, 100, 0);
+  }
+  BOOST_CHECK_EQUAL(6u, ring.recorded());
+  BOOST_CHECK_EQUAL(4u, ring.size());
+  ring.snapshot(events);
+  BOOST_REQUIRE_EQUAL(4u, events.size());
+  // Oldest surviving event first
+  BOOST_CHECK_EQUAL(3u, events.front().price);
+  BOOST_CHECK_EQUAL(6u, events.back().price);
+  BOOST_CHECK(events.front().ticks <= events.back().ticks);
+
+  ring.clear();
+  BOOST_CHECK_EQUAL(0u, ring.size());
+}
+
+// A book only keeps a ring when the whole test program is built with it.
+#ifdef LIQUIBOOK_ENABLE_TRACE
+
+namespace {
+  size_t count_events(const TraceDump::Events & events, uint16_t type)
+  {
+    size_t count = 0;
+    for (size_t pos = 0; pos < events.size(); ++pos) {
+      if (events[pos].type == type) {
+        ++count;
+      }
+    }
+    return count;
+  }
+}
+
+BOOST_AUTO_TEST_CASE(TestTraceAonDecisions)
+{
+  SimpleOrderBook order_book;
+  SimpleOrder ask0(false, 1251, 100);
+  SimpleOrder ask1(false, 1251, 300, 0, oc_all_or_none);
+  SimpleOrder bid0(true,  1251, 200, 0, oc_all_or_none);
+
+  BOOST_CHECK(add_and_verify(order_book, &ask0, false));
+  BOOST_CHECK(add_and_verify(order_book, &ask1, false, false, oc_all_or_none));
+  order_book.trace().clear();
+
+  // The regular ask is too small to fill the AON bid and the AON ask is
+  // too big, so both are deferred and the bid rests.
+  BOOST_CHECK(add_and_verify(order_book, &bid0, false, false, oc_all_or_none));
+
+  TraceDump::Events events;
+  order_book.trace().snapshot(events);
+  BOOST_REQUIRE(!events.empty());
+  BOOST_CHECK_EQUAL(TraceRing<>::te_add_begin, events.front().type);
+  BOOST_CHECK_EQUAL(TraceRing<>::te_add_end, events.back().type);
+  // The bid rests whole
+  BOOST_CHECK_EQUAL(200u, events.back().quantity);
+  // Once for the bid, once when the deferred AON ask is rechecked
+  BOOST_CHECK_EQUAL(2u, count_events(events, TraceRing<>::te_match_aon_begin));
+  BOOST_CHECK_EQUAL(1u, count_events(events, TraceRing<>::te_check_deferred_aon));
+  BOOST_CHECK_EQUAL(1u, count_events(events, TraceRing<>::te_aon_regular_defer));
+  BOOST_CHECK_EQUAL(1u, count_events(events, TraceRing<>::te_aon_defer_current));
+  BOOST_CHECK_EQUAL(0u, count_events(events, TraceRing<>::te_fill));
+
+  std::ostringstream timeline;
+  TraceDump::timeline(timeline, events, 1.0);
+  BOOST_CHECK(timeline.str().find("aon_defer_current") != std::string::npos);
+
+  std::ostringstream chrome;
+  TraceDump::chrome_trace(chrome, events, 1.0, "TEST \"A\"\\B");
+  BOOST_CHECK(chrome.str().find("\"ph\":\"B\"") != std::string::npos);
+  BOOST_CHECK(chrome.str().find("\"TEST \\\"A\\\"\\\\B\"") != std::string::npos);
+
+  std::stringstream saved;
+  TraceDump::save(saved, events);
+  TraceDump::Events loaded;
+  BOOST_REQUIRE(TraceDump::load(saved, loaded));
+  BOOST_REQUIRE_EQUAL(events.size(), loaded.size());
+  BOOST_CHECK_EQUAL(events.back().ticks, loaded.back().ticks);
+
+  // A regular order that defers nothing leaves no deferred check events
+  SimpleOrder bid1(true, 1240, 100);
+  order_book.trace().clear();
+  BOOST_CHECK(add_and_verify(order_book, &bid1, false));
+  order_book.trace().snapshot(events);
+  BOOST_CHECK_EQUAL(0u, count_events(events, TraceRing<>::te_check_deferred_begin));
+  BOOST_CHECK_EQUAL(0u, count_events(events, TraceRing<>::te_check_deferred_end));
+  BOOST_CHECK_EQUAL(100u, events.back().quantity);
+}
+
+#else // LIQUIBOOK_ENABLE_TRACE
+
+BOOST_AUTO_TEST_CASE(TestTraceCompiledOut)
+{
+  // The trace points vanish, arguments and all, so they cannot name a ring
+  LIQUIBOOK_TRACE(no_such_event, 0, 0, 0);
+  LIQUIBOOK_TRACE_ONLY(BOOST_ERROR("trace code compiled in");)
+
+  SimpleOrderBook order_book;
+  SimpleOrder ask0(false, 1251, 100, 0, oc_all_or_none);
+  SimpleOrder bid0(true,  1251, 100, 0, oc_all_or_none);
+  BOOST_CHECK(add_and_verify(order_book, &ask0, false, false, oc_all_or_none));
+  BOOST_CHECK(add_and_verify(order_book, &bid0, true, true, oc_all_or_none));
+}
+
+#endif // LIQUIBOOK_ENABLE_TRACE
+
+} // namespace